@@ -0,0 +1,313 @@
+#include "alloctrack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+
+// The stack walk skips a known number of calls, so they must stay calls
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+// A call site of the table, claimed by setting its key
+struct SiteSlot
+{
+    std::atomic<uint64_t> key;
+    const void* callers[ALLOCATION_DEPTH];
+    std::atomic<long long> count;
+    std::atomic<long long> bytes;
+};
+
+static std::atomic<bool> tracking(false);
+static std::atomic<long long> allocationTotal(0);
+static std::atomic<long long> bytesAllocated(0);
+static SiteSlot sites[ALLOCATION_SITES];
+
+// Set while this thread is counting, so allocations made by the stack walk
+// itself are not counted again
+static thread_local bool counting = false;
+
+// Return addresses of the code calling the allocator, skip calls up
+NOINLINE static int captureCallers(const void** callers, int skip) {
+#ifdef _WIN32
+    return CaptureStackBackTrace(skip + 1, ALLOCATION_DEPTH, (void**)callers, NULL);
+#elif defined(__linux__)
+    void* frames[ALLOCATION_DEPTH + 8];
+    int count = backtrace(frames, ALLOCATION_DEPTH + skip + 1) - skip - 1;
+    count = count < 0 ? 0 : count;
+    for (int i = 0; i < count; i++) {
+        callers[i] = frames[i + skip + 1];
+    }
+    return count;
+#else
+    (void)skip;
+    callers[0] = __builtin_return_address(0);
+    return 1;
+#endif
+}
+
+static uint64_t siteKey(const void* const* callers) {
+    uint64_t key = 14695981039346656037ull;
+    for (int i = 0; i < ALLOCATION_DEPTH; i++) {
+        key = (key ^ (uint64_t)(uintptr_t)callers[i]) * 1099511628211ull;
+    }
+    return key == 0 ? 1 : key;
+}
+
+void setAllocationTracking(bool enabled) {
+#if defined(__linux__)
+    // The first stack walk loads the unwinder, which allocates
+    if (enabled) {
+        void* frames[1];
+        backtrace(frames, 1);
+    }
+#endif
+    tracking.store(enabled, std::memory_order_relaxed);
+}
+
+bool isTrackingAllocations() {
+    return tracking.load(std::memory_order_relaxed);
+}
+
+NOINLINE void countAllocation(size_t bytes, int skip) {
+    if (!isTrackingAllocations() || counting) {
+        return;
+    }
+    counting = true;
+    allocationTotal.fetch_add(1, std::memory_order_relaxed);
+    bytesAllocated.fetch_add((long long)bytes, std::memory_order_relaxed);
+
+    const void* callers[ALLOCATION_DEPTH] = {};
+    captureCallers(callers, skip + 1);
+    uint64_t key = siteKey(callers);
+
+    // Open addressing, a full table only loses the names
+    for (int probe = 0; probe < ALLOCATION_SITES; probe++) {
+        SiteSlot& slot = sites[(key + probe) % ALLOCATION_SITES];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == 0) {
+            if (!slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                if (current != key) {
+                    continue;
+                }
+            }
+            else {
+                for (int i = 0; i < ALLOCATION_DEPTH; i++) {
+                    slot.callers[i] = callers[i];
+                }
+            }
+        }
+        else if (current != key) {
+            continue;
+        }
+        slot.count.fetch_add(1, std::memory_order_relaxed);
+        slot.bytes.fetch_add((long long)bytes, std::memory_order_relaxed);
+        break;
+    }
+    counting = false;
+}
+
+long long allocationCount() {
+    return allocationTotal.load(std::memory_order_relaxed);
+}
+
+long long allocatedBytes() {
+    return bytesAllocated.load(std::memory_order_relaxed);
+}
+
+int getAllocationSites(AllocationSite* out, int capacity) {
+    int count = 0;
+    for (int s = 0; s < ALLOCATION_SITES; s++) {
+        const SiteSlot& slot = sites[s];
+        long long calls = slot.count.load(std::memory_order_relaxed);
+        if (slot.key.load(std::memory_order_acquire) == 0 || calls == 0) {
+            continue;
+        }
+
+        // Insertion keeps the busiest first
+        AllocationSite site;
+        for (int i = 0; i < ALLOCATION_DEPTH; i++) {
+            site.callers[i] = slot.callers[i];
+        }
+        site.count = calls;
+        site.bytes = slot.bytes.load(std::memory_order_relaxed);
+        int at = count < capacity ? count : capacity;
+        while (at > 0 && out[at - 1].count < site.count) {
+            if (at < capacity) {
+                out[at] = out[at - 1];
+            }
+            at--;
+        }
+        if (at < capacity) {
+            out[at] = site;
+            count += count < capacity ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+void clearAllocationSites() {
+    for (int s = 0; s < ALLOCATION_SITES; s++) {
+        sites[s].count.store(0, std::memory_order_relaxed);
+        sites[s].bytes.store(0, std::memory_order_relaxed);
+        sites[s].key.store(0, std::memory_order_release);
+    }
+}
+
+// Prints one return address as well as the platform can name it
+static void printCaller(const void* caller) {
+#if defined(__linux__)
+    Dl_info info;
+    if (dladdr(caller, &info) != 0) {
+        if (info.dli_sname != NULL) {
+            int status = -1;
+            char* name = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+            printf("      %s+0x%lx\n", status == 0 ? name : info.dli_sname,
+                (unsigned long)((const char*)caller - (const char*)info.dli_saddr));
+            free(name);
+        }
+        else {
+            printf("      %s+0x%lx\n", info.dli_fname, (unsigned long)((const char*)caller - (const char*)info.dli_fbase));
+        }
+        return;
+    }
+#endif
+    printf("      %p\n", caller);
+}
+
+void printAllocationSites(int limit) {
+    // Naming the callers allocates, which is not counted
+    bool wasTracking = isTrackingAllocations();
+    tracking.store(false, std::memory_order_relaxed);
+
+    AllocationSite found[ALLOCATION_SITES];
+    int count = getAllocationSites(found, ALLOCATION_SITES);
+    for (int s = 0; s < count && s < limit; s++) {
+        printf("    %lld allocations, %lld bytes from\n", found[s].count, found[s].bytes);
+        for (int i = 0; i < ALLOCATION_DEPTH && found[s].callers[i] != NULL; i++) {
+            printCaller(found[s].callers[i]);
+        }
+    }
+    if (count > limit) {
+        printf("    and %d more call sites\n", count - limit);
+    }
+
+    tracking.store(wasTracking, std::memory_order_relaxed);
+}
+
+AllocationWatch::AllocationWatch(int warmupFrames) {
+    //Initialize
+    this->warmupFrames = warmupFrames;
+    frame = 0;
+    start = 0;
+    frames = 0;
+    framesAllocating = 0;
+    allocations = 0;
+}
+
+void AllocationWatch::beginFrame() {
+    if (frame >= warmupFrames) {
+        clearAllocationSites();
+    }
+    start = allocationCount();
+}
+
+long long AllocationWatch::endFrame() {
+    long long made = allocationCount() - start;
+    frame++;
+    if (frame <= warmupFrames) {
+        return made;
+    }
+
+    frames++;
+    if (made > 0) {
+        // The first few are enough to find where they come from
+        if (framesAllocating < 5) {
+            printf("Frame %lld made %lld heap allocations:\n", frame, made);
+            printAllocationSites(6);
+        }
+        framesAllocating++;
+        allocations += made;
+    }
+    return made;
+}
+
+long long AllocationWatch::getFrames() const {
+    return frames;
+}
+
+long long AllocationWatch::getFramesAllocating() const {
+    return framesAllocating;
+}
+
+long long AllocationWatch::getAllocations() const {
+    return allocations;
+}
+
+void AllocationWatch::printReport(const char* name) const {
+    printf("%s: %lld of %lld frames after %d frames of warm-up allocated, %lld allocations\n", name, framesAllocating, frames,
+        warmupFrames, allocations);
+}
+
+// Every allocation through new passes here; with tracking off it costs a
+// relaxed load
+void* operator new(size_t size) {
+    countAllocation(size, 1);
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    countAllocation(size, 1);
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    countAllocation(size, 1);
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    countAllocation(size, 1);
+    return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    free(memory);
+}
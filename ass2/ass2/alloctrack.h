@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation tracking
+// Replaces the global operator new and delete so heap allocations can be
+// counted, together with the code that made them. Off until switched on, and
+// then one atomic add and a short stack walk per allocation. Call sites are
+// kept in a fixed table so tracking itself never allocates. Only programs
+// that count their allocations link it, never the simulation library.
+
+// Call sites kept, allocations from later new sites are counted but not named
+const int ALLOCATION_SITES = 256;
+
+// Return addresses kept for each call site, innermost first
+const int ALLOCATION_DEPTH = 4;
+
+struct AllocationSite
+{
+    const void* callers[ALLOCATION_DEPTH];
+    long long count;
+    long long bytes;
+};
+
+void setAllocationTracking(bool enabled);
+bool isTrackingAllocations();
+
+// Counts an allocation, for allocators other than new such as SDL's
+// skip is the number of calls between the allocating code and this one
+void countAllocation(size_t bytes, int skip);
+
+// Allocations counted while tracking, and their bytes
+long long allocationCount();
+long long allocatedBytes();
+
+// Copies the call sites seen since the last clear, busiest first
+int getAllocationSites(AllocationSite* sites, int capacity);
+void clearAllocationSites();
+
+// Prints up to limit call sites, with the function of each return address
+// where symbols are available and otherwise its offset inside the executable
+void printAllocationSites(int limit);
+
+//Allocation watch class
+//Counts the heap allocations of every frame and reports the frames that still
+//allocate once warm-up is over
+class AllocationWatch
+{
+public:
+    //Initializes variables, frames before warmupFrames are not reported
+    explicit AllocationWatch(int warmupFrames);
+
+    //Starts counting a frame
+    void beginFrame();
+
+    //Ends the frame and returns its allocations, printing their call sites
+    //when it is past warm-up
+    long long endFrame();
+
+    //Frames past warm-up, how many of them allocated, and how often
+    long long getFrames() const;
+    long long getFramesAllocating() const;
+    long long getAllocations() const;
+
+    //Prints the totals
+    void printReport(const char* name) const;
+
+private:
+    int warmupFrames;
+    long long frame;
+    long long start;
+    long long frames;
+    long long framesAllocating;
+    long long allocations;
+};
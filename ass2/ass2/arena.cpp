@@ -0,0 +1,67 @@
+#include "arena.h"
+#include <new>
+
+static size_t alignUp(size_t bytes) {
+    return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+FrameArena::FrameArena(size_t capacity) {
+    //Initialize
+    this->capacity = alignUp(capacity > 0 ? capacity : ARENA_ALIGNMENT);
+    block = (unsigned char*)::operator new(this->capacity);
+    used = 0;
+    peak = 0;
+    overflows = 0;
+}
+
+FrameArena::~FrameArena() {
+    reset();
+    ::operator delete(block);
+}
+
+void* FrameArena::allocate(size_t bytes) {
+    bytes = alignUp(bytes > 0 ? bytes : 1);
+    size_t start = used;
+    used += bytes;
+    if (used <= capacity) {
+        return block + start;
+    }
+
+    // Counted in used all the same, so reset knows how big the frame was
+    void* memory = ::operator new(bytes);
+    overflow.push_back(memory);
+    return memory;
+}
+
+void FrameArena::reset() {
+    peak = used > peak ? used : peak;
+    if (!overflow.empty()) {
+        for (size_t i = 0; i < overflow.size(); i++) {
+            ::operator delete(overflow[i]);
+        }
+        overflow.clear();
+        overflows++;
+
+        // Room for the largest frame so far and then some
+        ::operator delete(block);
+        capacity = alignUp(peak + peak / 2);
+        block = (unsigned char*)::operator new(capacity);
+    }
+    used = 0;
+}
+
+size_t FrameArena::getCapacity() const {
+    return capacity;
+}
+
+size_t FrameArena::getUsed() const {
+    return used;
+}
+
+size_t FrameArena::getPeak() const {
+    return peak > used ? peak : used;
+}
+
+long long FrameArena::getOverflows() const {
+    return overflows;
+}
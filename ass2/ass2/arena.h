@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// Alignment of every arena allocation, enough for any built-in type
+const size_t ARENA_ALIGNMENT = 16;
+
+//Frame arena class
+//Hands out memory for data that lives for one frame by moving a pointer
+//through one block, and takes all of it back at once on reset. A frame that
+//needs more than the block gets the rest from the heap, and the next reset
+//grows the block to the frame's peak so later frames fit again.
+class FrameArena
+{
+public:
+    //Reserves a block of capacity bytes
+    explicit FrameArena(size_t capacity);
+
+    //Deallocates the block and any overflow
+    ~FrameArena();
+
+    //Bytes valid until the next reset
+    void* allocate(size_t bytes);
+
+    //Room for count values of a type with a trivial constructor
+    template <typename T>
+    T* allocate(int count) {
+        return (T*)allocate(sizeof(T) * (size_t)count);
+    }
+
+    //Takes back everything handed out since the last reset
+    void reset();
+
+    //Block size, bytes handed out this frame and the most any frame took
+    size_t getCapacity() const;
+    size_t getUsed() const;
+    size_t getPeak() const;
+
+    //Frames that did not fit in the block
+    long long getOverflows() const;
+
+private:
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    unsigned char* block;
+    size_t capacity;
+    size_t used;
+    size_t peak;
+
+    // Allocations past the end of the block, freed on reset
+    std::vector<void*> overflow;
+    long long overflows;
+};
@@ -0,0 +1,257 @@
+#include "assetpack.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char PACK_MAGIC[4] = { 'S', 'P', 'A', 'K' };
+
+// FNV-1a
+static uint64_t checksumBytes(const void* bytes, size_t size) {
+    const unsigned char* p = (const unsigned char*)bytes;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+AssetPack::AssetPack() {
+    //Initialize
+    base = NULL;
+    size = 0;
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+}
+
+AssetPack::~AssetPack() {
+    close();
+}
+
+bool AssetPack::open(const char* path) {
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Unable to open asset pack %s!\n", path);
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = (size_t)fileSize.QuadPart;
+    mapping = size > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    if (mapping != NULL) {
+        base = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Unable to open asset pack %s!\n", path);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = (size_t)info.st_size;
+        void* view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            base = (const unsigned char*)view;
+            // Most of the pack is read once, front to back, right away
+            madvise(view, size, MADV_WILLNEED);
+        }
+    }
+    // The mapping keeps the file alive
+    ::close(fd);
+#endif
+
+    if (base == NULL) {
+        printf("Unable to map asset pack %s!\n", path);
+        close();
+        return false;
+    }
+    if (!validate(path)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AssetPack::close() {
+#ifdef _WIN32
+    if (base != NULL) {
+        UnmapViewOfFile(base);
+    }
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (base != NULL) {
+        munmap((void*)base, size);
+    }
+#endif
+    base = NULL;
+    size = 0;
+}
+
+bool AssetPack::validate(const char* path) const {
+    if (size < sizeof(PackHeader)) {
+        printf("Asset pack %s is too short!\n", path);
+        return false;
+    }
+    const PackHeader* header = (const PackHeader*)base;
+    if (memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+        printf("%s is not an asset pack!\n", path);
+        return false;
+    }
+    if (header->version != PACK_VERSION) {
+        printf("Asset pack %s has version %u, expected %u!\n", path, header->version, PACK_VERSION);
+        return false;
+    }
+    if (header->fileSize != size) {
+        printf("Asset pack %s is %llu bytes, expected %llu!\n", path, (unsigned long long)size, (unsigned long long)header->fileSize);
+        return false;
+    }
+
+    uint64_t indexSize = (uint64_t)header->entryCount * sizeof(PackEntry);
+    if (indexSize > size - sizeof(PackHeader)) {
+        printf("Asset pack %s has a truncated index!\n", path);
+        return false;
+    }
+    const PackEntry* entries = (const PackEntry*)(base + sizeof(PackHeader));
+    if (checksumBytes(entries, (size_t)indexSize) != header->indexChecksum) {
+        printf("Asset pack %s has a corrupt index!\n", path);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        const PackEntry& entry = entries[i];
+        if (memchr(entry.name, '\0', PACK_NAME_LENGTH) == NULL || entry.offset % PACK_ALIGNMENT != 0 ||
+            entry.offset > size || entry.size > size - entry.offset) {
+            printf("Asset pack %s has an entry out of bounds!\n", path);
+            return false;
+        }
+        if (entry.type == PACK_IMAGE && (entry.pitch < entry.width * 4 || (uint64_t)entry.pitch * entry.height > entry.size)) {
+            printf("Asset pack %s has a malformed image %s!\n", path, entry.name);
+            return false;
+        }
+    }
+    return true;
+}
+
+const PackEntry* AssetPack::find(const char* name, uint32_t type) const {
+    if (base == NULL) {
+        return NULL;
+    }
+    const PackHeader* header = (const PackHeader*)base;
+    const PackEntry* entries = (const PackEntry*)(base + sizeof(PackHeader));
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        if (entries[i].type == type && strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+const void* AssetPack::findBlob(const char* name, size_t blobSize) const {
+    const PackEntry* entry = find(name, PACK_BLOB);
+    if (entry == NULL || entry->size != blobSize) {
+        return NULL;
+    }
+    return data(*entry);
+}
+
+const void* AssetPack::data(const PackEntry& entry) const {
+    return base + entry.offset;
+}
+
+void AssetPackWriter::add(const PackEntry& entry, const void* bytes) {
+    entries.push_back(entry);
+    const unsigned char* first = (const unsigned char*)bytes;
+    contents.push_back(std::vector<unsigned char>(first, first + entry.size));
+}
+
+void AssetPackWriter::addImage(const char* name, uint32_t format, int width, int height, int pitch, const void* pixels) {
+    PackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, name, PACK_NAME_LENGTH - 1);
+    entry.type = PACK_IMAGE;
+    entry.format = format;
+    entry.width = (uint32_t)width;
+    entry.height = (uint32_t)height;
+    entry.pitch = (uint32_t)pitch;
+    entry.size = (uint64_t)pitch * height;
+    add(entry, pixels);
+}
+
+void AssetPackWriter::addBlob(const char* name, const void* bytes, size_t size) {
+    PackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, name, PACK_NAME_LENGTH - 1);
+    entry.type = PACK_BLOB;
+    entry.size = size;
+    add(entry, bytes);
+}
+
+bool AssetPackWriter::write(const char* path) const {
+    // Lay the data out after the index
+    std::vector<PackEntry> index = entries;
+    uint64_t offset = alignUp(sizeof(PackHeader) + index.size() * sizeof(PackEntry));
+    for (size_t i = 0; i < index.size(); i++) {
+        index[i].offset = offset;
+        offset = alignUp(offset + index[i].size);
+    }
+
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.entryCount = (uint32_t)index.size();
+    header.fileSize = offset;
+    header.indexChecksum = checksumBytes(index.data(), index.size() * sizeof(PackEntry));
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Unable to create asset pack %s!\n", path);
+        return false;
+    }
+
+    static const unsigned char zeros[PACK_ALIGNMENT] = {};
+    uint64_t written = 0;
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    written += sizeof(header);
+    if (!index.empty()) {
+        success = success && fwrite(index.data(), sizeof(PackEntry), index.size(), file) == index.size();
+        written += index.size() * sizeof(PackEntry);
+    }
+    for (size_t i = 0; i < index.size() && success; i++) {
+        success = fwrite(zeros, 1, (size_t)(index[i].offset - written), file) == index[i].offset - written;
+        success = success && fwrite(contents[i].data(), 1, contents[i].size(), file) == contents[i].size();
+        written = index[i].offset + index[i].size;
+    }
+    success = success && fwrite(zeros, 1, (size_t)(offset - written), file) == offset - written;
+
+    if (fclose(file) != 0 || !success) {
+        printf("Unable to write asset pack %s!\n", path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Asset packs
+//
+// One file holding assets ready for upload: images already decoded to the
+// pixel format the textures use, and binary blobs such as font metrics. The
+// game maps the file and uploads textures straight from the mapping.
+//
+// Layout, native byte order (packs are built and read on little endian
+// machines):
+//   PackHeader
+//   PackEntry[entryCount]
+//   entry data, each entry starting on a PACK_ALIGNMENT boundary
+// The header holds a checksum of the entry table, and opening a pack checks
+// it along with the version, the file size and every entry's bounds.
+
+const uint32_t PACK_VERSION = 1;
+const int PACK_NAME_LENGTH = 32;
+const int PACK_ALIGNMENT = 64;
+
+enum PackEntryType
+{
+    PACK_IMAGE = 1,
+    PACK_BLOB = 2
+};
+
+struct PackHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t fileSize;
+    uint64_t indexChecksum;
+};
+
+struct PackEntry
+{
+    char name[PACK_NAME_LENGTH];
+    uint32_t type;
+
+    // Images only: SDL pixel format, size and bytes per row
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t reserved;
+
+    uint64_t offset;
+    uint64_t size;
+};
+
+//Asset pack class
+//Maps a pack read-only and finds its entries
+class AssetPack
+{
+public:
+    //Initializes variables
+    AssetPack();
+
+    //Unmaps the pack
+    ~AssetPack();
+
+    //Maps the file and validates it
+    bool open(const char* path);
+
+    //Unmaps the file
+    void close();
+
+    //Entry with the given name and type, NULL if there is none
+    const PackEntry* find(const char* name, uint32_t type) const;
+
+    //Blob of exactly size bytes, NULL if missing or of another size
+    const void* findBlob(const char* name, size_t size) const;
+
+    //Start of an entry's data inside the mapping
+    const void* data(const PackEntry& entry) const;
+
+private:
+    bool validate(const char* path) const;
+
+    const unsigned char* base;
+    size_t size;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+};
+
+//Asset pack writer class
+//Collects entries in memory and writes a whole pack at once
+class AssetPackWriter
+{
+public:
+    //Adds an image of height rows of pitch bytes
+    void addImage(const char* name, uint32_t format, int width, int height, int pitch, const void* pixels);
+
+    //Adds raw bytes
+    void addBlob(const char* name, const void* bytes, size_t size);
+
+    //Writes the pack, replacing any existing file
+    bool write(const char* path) const;
+
+private:
+    void add(const PackEntry& entry, const void* bytes);
+
+    std::vector<PackEntry> entries;
+    std::vector<std::vector<unsigned char> > contents;
+};
@@ -0,0 +1,1020 @@
+// Microbenchmarks for the simulation hot paths and benchmarks of whole match
+// scenarios
+//
+// Usage: bench [--csv FILE] [--baseline FILE] [--tolerance PCT] [name ...]
+// Runs every benchmark whose name starts with one of the given prefixes, or all of them.
+// --csv saves the results as name,unit,rate lines; --baseline compares them
+// against a file saved that way and exits with 1 when any result is more than
+// PCT percent (10) slower. The scenarios are a kickoff of 2 a side, a scrum
+// of 11 a side in front of a goal and a whole match of 11 a side.
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "alloctrack.h"
+#include "arena.h"
+#include "benchreport.h"
+#include "capture.h"
+#include "lockfree.h"
+#include "narrowphase.h"
+#include "planner.h"
+#include "policies.h"
+#include "recording.h"
+#include "simthread.h"
+#include "snapshot.h"
+#include "vecenv.h"
+
+// Bodies and pairs for the collision benchmarks
+const int BENCH_BODIES = 4096;
+const int BENCH_PAIRS = 1 << 16;
+
+// Values passed between threads by the hand-off check
+const int HANDOFF_VALUES = 100000;
+const int HANDOFF_WIDTH = 64;
+
+// Simulation thread check: step rate, how long it runs and the longest
+// pretend frame the reader takes
+const int SIM_RATE = 60;
+const double SIM_SECONDS = 2.0;
+const int SIM_MAX_FRAME_MS = 50;
+
+// Snapshot codec: frames recorded of each match, the age of the baseline
+// a receiver about 100 ms away has acknowledged, and room for one snapshot
+const int SNAPSHOT_FRAMES = 2000;
+const int SNAPSHOT_LAG = 6;
+const int SNAPSHOT_BYTES = 512;
+
+// Vectorized environment: matches stepped at once, the longest episode and
+// the steps the check compares
+const int ENV_MATCHES = 1024;
+const int ENV_EPISODE_FRAMES = 3600;
+const int ENV_CHECK_MATCHES = 37;
+const int ENV_CHECK_STEPS = 1000;
+
+// Frames of the fast-forward check
+const int SWEEP_CHECK_FRAMES = 60 * 90;
+
+// Steps written and read back by the recording check
+const int RECORDING_CHECK_FRAMES = 2000;
+
+// Scenarios: frames each plays before starting over, and steps in a batch
+const int KICKOFF_FRAMES = 180;
+const int SCRUM_FRAMES = 120;
+const int STRESS_FRAMES = 60 * 90;
+const int SCENARIO_STEPS = 200;
+
+// Times every pair of the scrum is tested in a collision batch
+const int COLLIDE_REPEATS = 16;
+
+// Allocation check: frames of warm-up, frames that must not allocate, the
+// planner's budget in them and the steps the simulation thread runs first
+const int ALLOC_WARMUP_FRAMES = 120;
+const int ALLOC_CHECK_FRAMES = 600;
+const double ALLOC_PLAN_MS = 0.05;
+const int ALLOC_SIM_STEPS = 10;
+
+// Capture check: frame size, frames of each output and frames offered to a
+// capture with a single buffer
+const int CAPTURE_WIDTH = 64;
+const int CAPTURE_HEIGHT = 48;
+const int CAPTURE_FRAMES = 10;
+const int CAPTURE_BURST = 200;
+
+// Frame arena of the allocation check, which its scratch outgrows in warm-up
+const size_t ALLOC_ARENA_BYTES = 1024;
+const int ALLOC_SCRATCH_GROWTH = 64;
+
+// Layout of the old TextureWrapper, which isColliding took by value
+struct LegacyWrapper
+{
+    void* texture;
+    int width;
+    int height;
+    int x;
+    int y;
+    int vx;
+    int vy;
+};
+
+// The collision test the game used before the narrowphase
+bool legacyIsColliding(LegacyWrapper obj1, LegacyWrapper obj2) {
+    int dx = obj1.x - obj2.x;
+    int dy = obj1.y - obj2.y;
+    int distance = sqrt(dx * dx + dy * dy);
+    return distance < obj1.width / 2 + obj2.width / 2;
+}
+
+// Random players scattered over the pitch and random pairs of them
+struct CollisionData
+{
+    CollisionData() {
+        std::mt19937 generator(12345);
+        std::uniform_int_distribution<int> pitchX(140, 1140);
+        std::uniform_int_distribution<int> pitchY(105, 855);
+        std::uniform_int_distribution<int> body(0, BENCH_BODIES - 1);
+
+        x.resize(BENCH_BODIES);
+        y.resize(BENCH_BODIES);
+        radius.assign(BENCH_BODIES, 45);
+        wrappers.resize(BENCH_BODIES);
+        for (int i = 0; i < BENCH_BODIES; i++) {
+            x[i] = pitchX(generator);
+            y[i] = pitchY(generator);
+            LegacyWrapper wrapper = { NULL, 90, 90, x[i], y[i], 0, 0 };
+            wrappers[i] = wrapper;
+        }
+
+        pairs.resize(BENCH_PAIRS);
+        for (int p = 0; p < BENCH_PAIRS; p++) {
+            int a = body(generator);
+            int b = body(generator);
+            CandidatePair pair = { a < b ? a : b, a < b ? b : a };
+            pairs[p] = pair;
+        }
+        contacts.resize(BENCH_PAIRS);
+    }
+
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> radius;
+    std::vector<LegacyWrapper> wrappers;
+    std::vector<CandidatePair> pairs;
+    std::vector<Contact> contacts;
+};
+
+static CollisionData& collisionData() {
+    static CollisionData data;
+    return data;
+}
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile long long sink;
+
+static long long legacyBatch() {
+    CollisionData& d = collisionData();
+    long long hits = 0;
+    for (int p = 0; p < BENCH_PAIRS; p++) {
+        hits += legacyIsColliding(d.wrappers[d.pairs[p].a], d.wrappers[d.pairs[p].b]);
+    }
+    sink = hits;
+    return BENCH_PAIRS;
+}
+
+static long long scalarBatch() {
+    CollisionData& d = collisionData();
+    sink = findContactsScalar(d.x.data(), d.y.data(), d.radius.data(), d.pairs.data(), BENCH_PAIRS, d.contacts.data());
+    return BENCH_PAIRS;
+}
+
+static long long simdBatch() {
+    CollisionData& d = collisionData();
+    sink = findContacts(d.x.data(), d.y.data(), d.radius.data(), d.pairs.data(), BENCH_PAIRS, d.contacts.data());
+    return BENCH_PAIRS;
+}
+
+// Checks the fast kernel finds exactly what the old test and the scalar kernel find
+static bool checkNarrowphase() {
+    CollisionData& d = collisionData();
+    std::vector<Contact> expected(BENCH_PAIRS);
+    int expectedCount = findContactsScalar(d.x.data(), d.y.data(), d.radius.data(), d.pairs.data(), BENCH_PAIRS, expected.data());
+    int count = findContacts(d.x.data(), d.y.data(), d.radius.data(), d.pairs.data(), BENCH_PAIRS, d.contacts.data());
+
+    int legacyCount = 0;
+    for (int p = 0; p < BENCH_PAIRS; p++) {
+        legacyCount += legacyIsColliding(d.wrappers[d.pairs[p].a], d.wrappers[d.pairs[p].b]);
+    }
+
+    if (count != expectedCount || count != legacyCount) {
+        printf("narrowphase mismatch: %s found %d contacts, scalar %d, legacy %d\n", narrowphaseKernel(), count, expectedCount, legacyCount);
+        return false;
+    }
+    for (int c = 0; c < count; c++) {
+        const Contact& a = d.contacts[c];
+        const Contact& b = expected[c];
+        if (a.a != b.a || a.b != b.b || a.nx != b.nx || a.ny != b.ny || a.depth != b.depth) {
+            printf("narrowphase mismatch at contact %d\n", c);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Snapshots of a match with random keys against the computer
+struct SnapshotData
+{
+    explicit SnapshotData(int teamSize) : snapshots(SNAPSHOT_FRAMES), buffer(SNAPSHOT_FRAMES * SNAPSHOT_BYTES), sizes(SNAPSHOT_FRAMES) {
+        std::mt19937 generator(teamSize);
+        std::uniform_int_distribution<int> buttons(0, 31);
+        MatchState match;
+        initMatch(match, CONTROL_HUMAN, CONTROL_AI, teamSize, 4242);
+        Inputs inputs = { { { 0 }, { 0 } } };
+        for (int f = 0; f < SNAPSHOT_FRAMES; f++) {
+            if (f % 10 == 0) {
+                inputs.player[0].buttons = (unsigned char)buttons(generator);
+            }
+            step(match, inputs);
+            takeSnapshot(match, f, snapshots[f]);
+        }
+
+        // Encoded against the snapshot SNAPSHOT_LAG frames before, for decoding
+        for (int f = 0; f < SNAPSHOT_FRAMES; f++) {
+            const Snapshot* baseline = f >= SNAPSHOT_LAG ? &snapshots[f - SNAPSHOT_LAG] : NULL;
+            sizes[f] = encodeSnapshot(snapshots[f], baseline, &buffer[f * SNAPSHOT_BYTES], SNAPSHOT_BYTES);
+        }
+    }
+
+    std::vector<Snapshot> snapshots;
+    std::vector<unsigned char> buffer;
+    std::vector<int> sizes;
+    Snapshot decoded;
+};
+
+static SnapshotData& snapshotData() {
+    static SnapshotData data(11);
+    return data;
+}
+
+// Encodes every snapshot against the one SNAPSHOT_LAG frames before it
+static long long snapshotEncodeBatch() {
+    SnapshotData& d = snapshotData();
+    long long bytes = 0;
+    for (int f = 0; f < SNAPSHOT_FRAMES; f++) {
+        const Snapshot* baseline = f >= SNAPSHOT_LAG ? &d.snapshots[f - SNAPSHOT_LAG] : NULL;
+        d.sizes[f] = encodeSnapshot(d.snapshots[f], baseline, &d.buffer[f * SNAPSHOT_BYTES], SNAPSHOT_BYTES);
+        bytes += d.sizes[f];
+    }
+    sink = bytes;
+    return SNAPSHOT_FRAMES;
+}
+
+static long long snapshotDecodeBatch() {
+    SnapshotData& d = snapshotData();
+    long long valid = 0;
+    for (int f = 0; f < SNAPSHOT_FRAMES; f++) {
+        const Snapshot* baseline = f >= SNAPSHOT_LAG ? &d.snapshots[f - SNAPSHOT_LAG] : NULL;
+        valid += decodeSnapshot(&d.buffer[f * SNAPSHOT_BYTES], d.sizes[f], baseline, d.decoded);
+    }
+    sink = valid;
+    return SNAPSHOT_FRAMES;
+}
+
+// Lockstep matches against the computer with buffers for one step, the keys
+// change every few steps
+struct EnvData
+{
+    EnvData() : env(vecEnvCreate(ENV_MATCHES, DEFAULT_TEAM_SIZE, CONTROL_HUMAN, CONTROL_AI, 99, ENV_EPISODE_FRAMES, 0)),
+        observations(ENV_MATCHES * vecEnvObservationSize(env)), rewards(2 * ENV_MATCHES), dones(ENV_MATCHES),
+        actions(2 * ENV_MATCHES * 16) {
+        std::mt19937 generator(99);
+        std::uniform_int_distribution<int> buttons(0, 31);
+        for (size_t i = 0; i < actions.size(); i++) {
+            actions[i] = (unsigned char)buttons(generator);
+        }
+        vecEnvReset(env, observations.data());
+        steps = 0;
+    }
+
+    ~EnvData() {
+        vecEnvDestroy(env);
+    }
+
+    VecEnv* env;
+    std::vector<float> observations;
+    std::vector<float> rewards;
+    std::vector<unsigned char> dones;
+    std::vector<unsigned char> actions;
+    int steps;
+};
+
+static EnvData& envData() {
+    static EnvData data;
+    return data;
+}
+
+static long long envStepBatch() {
+    EnvData& d = envData();
+    const unsigned char* actions = &d.actions[2 * ENV_MATCHES * (d.steps++ / 8 % 16)];
+    vecEnvStep(d.env, actions, d.observations.data(), d.rewards.data(), d.dones.data());
+    sink = d.dones[0];
+    return ENV_MATCHES;
+}
+
+// Every player of a computer match crowded around the ball in front of the
+// left goal, in rings of eight
+static void setupScrum(MatchState& match) {
+    initMatch(match, CONTROL_AI, CONTROL_AI, 11, 22);
+    Bodies& bodies = match.bodies;
+    int ballX = LEFT + 100;
+    int ballY = (GTOP + GBOTTOM) / 2;
+    bodies.x[match.ball] = ballX;
+    bodies.y[match.ball] = ballY;
+    for (int i = 0; i < match.playerCount; i++) {
+        int ring = 1 + i / 8;
+        double angle = (i % 8) * 0.785398 + ring * 0.392699;
+        int x = ballX + (int)(ring * 70 * cos(angle));
+        int y = ballY + (int)(ring * 70 * sin(angle));
+        bodies.x[i] = std::min(std::max(x, bodies.minX[i]), bodies.maxX[i]);
+        bodies.y[i] = std::min(std::max(y, bodies.minY[i]), bodies.maxY[i]);
+    }
+}
+
+// A match played from a fixed start, which starts over after a number of frames
+struct Scenario
+{
+    Scenario(int frames) : frames(frames) {
+    }
+
+    MatchState start;
+    MatchState match;
+    int frames;
+};
+
+struct ScenarioData
+{
+    ScenarioData() : kickoff(KICKOFF_FRAMES), scrum(SCRUM_FRAMES), stress(STRESS_FRAMES) {
+        initMatch(kickoff.start, CONTROL_AI, CONTROL_AI, DEFAULT_TEAM_SIZE, 21);
+        setupScrum(scrum.start);
+        initMatch(stress.start, CONTROL_AI, CONTROL_AI, 11, 23);
+        kickoff.match = kickoff.start;
+        scrum.match = scrum.start;
+        stress.match = stress.start;
+    }
+
+    Scenario kickoff;
+    Scenario scrum;
+    Scenario stress;
+};
+
+static ScenarioData& scenarioData() {
+    static ScenarioData data;
+    return data;
+}
+
+// Starting over copies into storage the match already has
+static void stepScenario(Scenario& scenario) {
+    Inputs inputs = { { { 0 }, { 0 } } };
+    if (scenario.match.frame >= scenario.frames) {
+        scenario.match = scenario.start;
+    }
+    step(scenario.match, inputs);
+}
+
+static long long runScenario(Scenario& scenario) {
+    for (int s = 0; s < SCENARIO_STEPS; s++) {
+        stepScenario(scenario);
+    }
+    sink = scenario.match.score1;
+    return SCENARIO_STEPS;
+}
+
+static long long kickoffBatch() {
+    return runScenario(scenarioData().kickoff);
+}
+
+static long long scrumBatch() {
+    return runScenario(scenarioData().scrum);
+}
+
+static long long stressBatch() {
+    return runScenario(scenarioData().stress);
+}
+
+// The simulation's own collision test on every pair of bodies in the scrum
+static long long collideBatch() {
+    const Bodies& bodies = scenarioData().scrum.start.bodies;
+    long long hits = 0;
+    long long pairs = 0;
+    for (int r = 0; r < COLLIDE_REPEATS; r++) {
+        for (int a = 0; a < bodies.count; a++) {
+            for (int b = a + 1; b < bodies.count; b++) {
+                hits += isColliding(bodies, a, b);
+                pairs++;
+            }
+        }
+    }
+    sink = hits;
+    return pairs;
+}
+
+// Encodes and decodes one snapshot, adding its size to bytes
+static bool roundTrip(const Snapshot& current, const Snapshot* baseline, long long& bytes) {
+    unsigned char buffer[SNAPSHOT_BYTES];
+    int size = encodeSnapshot(current, baseline, buffer, sizeof(buffer));
+    int frame, baselineFrame;
+    if (size == 0 || !snapshotFrames(buffer, size, frame, baselineFrame) || frame != current.frame) {
+        return false;
+    }
+    // Baselines too old or of another match are not used
+    bool usable = baseline != NULL && current.frame - baseline->frame >= 1 && current.frame - baseline->frame <= MAX_BASELINE_AGE
+        && baseline->x.size() == current.x.size();
+    if (baselineFrame != (usable ? baseline->frame : -1)) {
+        return false;
+    }
+
+    Snapshot decoded;
+    bytes += size;
+    return decodeSnapshot(buffer, size, usable ? baseline : NULL, decoded) && sameSnapshot(decoded, current)
+        && !decodeSnapshot(buffer, size - 1, usable ? baseline : NULL, decoded);
+}
+
+// Checks snapshots decode to exactly what was encoded against every kind of
+// baseline, and reports their size
+static bool checkSnapshots() {
+    bool valid = true;
+    const int teamSizes[] = { 2, 11 };
+    for (int t = 0; t < 2; t++) {
+        SnapshotData data(teamSizes[t]);
+        const std::vector<Snapshot>& snapshots = data.snapshots;
+        long long keyframe = 0;
+        long long previous = 0;
+        long long lagged = 0;
+        long long stale = 0;
+        for (int f = 0; f < SNAPSHOT_FRAMES; f++) {
+            valid = valid && roundTrip(snapshots[f], NULL, keyframe);
+            if (f >= SNAPSHOT_LAG) {
+                valid = valid && roundTrip(snapshots[f], &snapshots[f - 1], previous)
+                    && roundTrip(snapshots[f], &snapshots[f - SNAPSHOT_LAG], lagged);
+            }
+            if (f > MAX_BASELINE_AGE) {
+                valid = valid && roundTrip(snapshots[f], &snapshots[f - MAX_BASELINE_AGE - 1], stale);
+            }
+        }
+        int counted = SNAPSHOT_FRAMES - SNAPSHOT_LAG;
+        int bodies = (int)snapshots[0].x.size();
+        printf("snapshot/bytes team %-6d %5d raw, %.1f whole, %.1f against the last frame, %.1f against %d frames back\n",
+            teamSizes[t], (int)sizeof(int) * (5 + 4 * bodies), (double)keyframe / SNAPSHOT_FRAMES,
+            (double)previous / counted, (double)lagged / counted, SNAPSHOT_LAG);
+    }
+
+    // Values far from the baseline, and the largest differences there are
+    const int values[] = { INT_MIN, INT_MAX, -1, 0, 1, 4095, -4096, 70000 };
+    Snapshot low;
+    Snapshot high;
+    low.frame = 10;
+    high.frame = 11;
+    for (int i = 0; i < 8; i++) {
+        low.x.push_back(values[i]);
+        low.y.push_back(values[7 - i]);
+        low.vx.push_back(~values[i]);
+        low.vy.push_back(values[i] / 2);
+        high.x.push_back(values[7 - i]);
+        high.y.push_back(values[i]);
+        high.vx.push_back(values[(i + 3) % 8]);
+        high.vy.push_back(values[(i + 5) % 8]);
+    }
+    low.score1 = INT_MAX;
+    high.score1 = INT_MIN;
+    long long bytes = 0;
+    valid = valid && roundTrip(low, NULL, bytes) && roundTrip(high, &low, bytes);
+
+    if (!valid) {
+        printf("snapshot codec did not give back what it encoded\n");
+    }
+    return valid;
+}
+
+// Checks a recording reads back with the header, inputs and final checksum
+// it was written with
+static bool checkRecording() {
+    const char* path = "bench-recording.rep";
+    MatchState match;
+    initMatch(match, CONTROL_HUMAN, CONTROL_AI, 4, 17);
+    ReplayHeader header = replayHeaderFor(match);
+    std::vector<Inputs> played;
+    ReplayWriter writer;
+    bool valid = writer.open(path, header);
+    std::mt19937 random(9);
+    for (int f = 0; f < RECORDING_CHECK_FRAMES && valid; f++) {
+        // Runs of held buttons, single steps and every button combination
+        Inputs inputs;
+        if (f % 40 < 20 && f > 0) {
+            inputs = played.back();
+        }
+        else {
+            inputs.player[0].buttons = (unsigned char)random();
+            inputs.player[1].buttons = (unsigned char)random();
+        }
+        played.push_back(inputs);
+        writer.record(inputs);
+        step(match, inputs);
+    }
+    writer.close(match);
+
+    ReplayReader reader;
+    valid = valid && reader.load(path);
+    if (valid) {
+        const ReplayHeader& read = reader.header();
+        valid = read.seed == header.seed && read.teamSize == header.teamSize && read.control[0] == header.control[0]
+            && read.control[1] == header.control[1];
+        MatchState replayed;
+        initMatch(replayed, read.control[0], read.control[1], read.teamSize, read.seed);
+        Inputs inputs;
+        size_t count = 0;
+        while (valid && reader.next(inputs)) {
+            valid = count < played.size() && inputs.player[0].buttons == played[count].player[0].buttons
+                && inputs.player[1].buttons == played[count].player[1].buttons;
+            step(replayed, inputs);
+            count++;
+        }
+        valid = valid && count == played.size() && reader.hasChecksum() && reader.checksum() == checksumState(match)
+            && checksumState(replayed) == checksumState(match);
+    }
+    remove(path);
+
+    if (!valid) {
+        printf("recording did not read back as it was written\n");
+    }
+    return valid;
+}
+
+// Checks the vectorized environment plays every match exactly as stepping it
+// alone would, on one thread and on several, and ends episodes when it says
+static bool checkVecEnv() {
+    const int teamSize = 3;
+    const int episode = 50;
+    const uint64_t seed = 5;
+    VecEnv* single = vecEnvCreate(ENV_CHECK_MATCHES, teamSize, CONTROL_HUMAN, CONTROL_AI, seed, episode, 1);
+    VecEnv* threaded = vecEnvCreate(ENV_CHECK_MATCHES, teamSize, CONTROL_HUMAN, CONTROL_AI, seed, episode, 4);
+    int size = vecEnvObservationSize(single);
+    std::vector<float> observations(ENV_CHECK_MATCHES * size);
+    std::vector<float> threadedObservations(observations.size());
+    std::vector<float> rewards(2 * ENV_CHECK_MATCHES);
+    std::vector<float> threadedRewards(rewards.size());
+    std::vector<unsigned char> dones(ENV_CHECK_MATCHES);
+    std::vector<unsigned char> threadedDones(dones.size());
+    std::vector<unsigned char> actions(2 * ENV_CHECK_MATCHES);
+
+    // The first match stepped alone alongside, until the environment is reset
+    MatchState match;
+    initMatch(match, CONTROL_HUMAN, CONTROL_AI, teamSize, mixSeed(seed));
+    bool alone = true;
+    int frames = 0;
+
+    bool valid = vecEnvCount(single) == ENV_CHECK_MATCHES && size == 4 * (2 * teamSize + 1) + 2;
+    std::mt19937 generator(5);
+    std::uniform_int_distribution<int> buttons(0, 31);
+    for (int s = 0; s < ENV_CHECK_STEPS && valid; s++) {
+        if (s == ENV_CHECK_STEPS / 2) {
+            vecEnvReset(single, observations.data());
+            vecEnvReset(threaded, threadedObservations.data());
+            valid = observations == threadedObservations;
+            alone = false;
+        }
+        for (size_t i = 0; i < actions.size(); i++) {
+            actions[i] = (unsigned char)buttons(generator);
+        }
+        vecEnvStep(single, actions.data(), observations.data(), rewards.data(), dones.data());
+        vecEnvStep(threaded, actions.data(), threadedObservations.data(), threadedRewards.data(), threadedDones.data());
+        valid = valid && observations == threadedObservations && rewards == threadedRewards && dones == threadedDones;
+
+        // Episodes end on a goal or at the limit, with a reward only for a goal
+        for (int i = 0; i < ENV_CHECK_MATCHES && valid; i++) {
+            float reward = rewards[2 * i];
+            valid = rewards[2 * i + 1] == -reward && (dones[i] == VECENV_GOAL) == (reward != 0)
+                && (dones[i] == 0 || dones[i] == VECENV_GOAL || dones[i] == VECENV_TIME_LIMIT);
+        }
+        if (!alone) {
+            continue;
+        }
+
+        Inputs inputs;
+        inputs.player[0].buttons = actions[0];
+        inputs.player[1].buttons = actions[1];
+        step(match, inputs);
+        frames++;
+        unsigned char done = 0;
+        if (match.win1 || match.win2) {
+            done = VECENV_GOAL;
+        }
+        else if (frames == episode) {
+            reset(match);
+            done = VECENV_TIME_LIMIT;
+        }
+        frames = done != 0 ? 0 : frames;
+        valid = valid && dones[0] == done && observations[size - 2] == match.selected[0];
+        for (int b = 0; b < match.bodies.count && valid; b++) {
+            valid = observations[4 * b] == (match.bodies.x[b] - LEFT) * (1.0f / (RIGHT - LEFT))
+                && observations[4 * b + 3] == match.bodies.vy[b] * (1.0f / PLAYER_SPEED);
+        }
+    }
+    vecEnvDestroy(single);
+    vecEnvDestroy(threaded);
+
+    if (!valid) {
+        printf("vectorized environment did not play the matches as they play alone\n");
+    }
+    return valid;
+}
+
+// A match of players standing at kickoff with the ball placed and moving,
+// long after the ball's last kick
+static void placeBall(MatchState& match, int x, int y, int vx, int vy) {
+    initMatch(match, CONTROL_HUMAN, CONTROL_HUMAN, DEFAULT_TEAM_SIZE, 3);
+    match.frame = 1;
+    match.bodies.x[match.ball] = x;
+    match.bodies.y[match.ball] = y;
+    match.bodies.vx[match.ball] = vx;
+    match.bodies.vy[match.ball] = vy;
+}
+
+// Checks long steps never let the ball through a player, a wall or the goal
+// line, and that fast-forwarding a match of players standing still gives
+// exactly what single frames give
+static bool checkSweep() {
+    MatchState match;
+    MatchState single;
+    Inputs inputs = { { { 0 }, { 0 } } };
+    bool valid = true;
+
+    // Straight at the outfield player of the left side, from the middle, and
+    // into the wall above; both come back as far as single frames take them
+    for (int shot = 0; shot < 2; shot++) {
+        if (shot == 0) {
+            placeBall(match, 640, 480, -BALL_MAX_SPEED, 0);
+        }
+        else {
+            placeBall(match, 640, 200, 0, -BALL_MAX_SPEED);
+        }
+        single = match;
+        stepFrames(match, inputs, MAX_STEP_FRAMES);
+        for (int f = 0; f < MAX_STEP_FRAMES; f++) {
+            step(single, inputs);
+        }
+        valid = valid && checksumState(match) == checksumState(single)
+            && (shot == 0 ? match.bodies.vx[match.ball] > 0 : match.bodies.vy[match.ball] > 0);
+    }
+
+    // Past the keeper into the goal, ending the step early
+    placeBall(match, 300, 480, -BALL_MAX_SPEED, 0);
+    match.bodies.y[keeperIndex(match, 0)] = match.bodies.maxY[keeperIndex(match, 0)];
+    int frames = stepFrames(match, inputs, MAX_STEP_FRAMES);
+    valid = valid && match.score2 == 1 && frames < MAX_STEP_FRAMES;
+
+    // From touching the keeper past him into the goal, kicked every frame
+    // of contact as single frames kick it
+    placeBall(match, 1060, 440, BALL_MAX_SPEED, 0);
+    single = match;
+    frames = stepFrames(match, inputs, MAX_STEP_FRAMES);
+    for (int f = 0; f < frames; f++) {
+        step(single, inputs);
+    }
+    valid = valid && checksumState(match) == checksumState(single) && match.score1 == 1 && frames < MAX_STEP_FRAMES;
+
+    // Nobody moves, so only the ball's path has to come out the same
+    initMatch(match, CONTROL_AI, CONTROL_AI, DEFAULT_TEAM_SIZE, 11);
+    match.policy[0] = standStill;
+    match.policy[1] = standStill;
+    single = match;
+    int steps = fastForward(match, inputs, SWEEP_CHECK_FRAMES, MAX_STEP_FRAMES);
+    for (int f = 0; f < SWEEP_CHECK_FRAMES; f++) {
+        step(single, inputs);
+    }
+    valid = valid && checksumState(match) == checksumState(single) && steps < SWEEP_CHECK_FRAMES / 2;
+
+    if (!valid) {
+        printf("ball passed through something or fast-forward left its path\n");
+    }
+    return valid;
+}
+
+// Checks a frame's worth of everything the game and the server do besides
+// drawing allocates nothing once warmed up: stepping every scenario, planning,
+// fast-forwarding, coding snapshots, timing frames, taking frame scratch from
+// an arena and reading the snapshots of a match stepped on the simulation thread
+static bool checkSteadyState() {
+    ScenarioData& scenarios = scenarioData();
+    MatchState planned;
+    initMatch(planned, CONTROL_PLANNED, CONTROL_AI, DEFAULT_TEAM_SIZE, 41);
+    PlannerOptions options;
+    options.budgetMs = ALLOC_PLAN_MS;
+    options.threads = 1;
+    MonteCarloPlanner planner(0, options);
+    MatchState skipped;
+    initMatch(skipped, CONTROL_AI, CONTROL_AI, DEFAULT_TEAM_SIZE, 43);
+    Inputs inputs = { { { 0 }, { 0 } } };
+
+    Snapshot previous;
+    Snapshot current;
+    Snapshot decoded;
+    unsigned char buffer[SNAPSHOT_BYTES];
+    FrameTimes times;
+    int buckets[16];
+    FrameArena arena(ALLOC_ARENA_BYTES);
+
+    MatchState threaded;
+    initMatch(threaded, CONTROL_AI, CONTROL_AI, 11, 47);
+    SimThread simulation(threaded, SIM_RATE, 5, NULL);
+    simulation.start();
+    while (simulation.getSteps() < ALLOC_SIM_STEPS) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    AllocationWatch watch(ALLOC_WARMUP_FRAMES);
+    setAllocationTracking(true);
+    for (int f = 0; f < ALLOC_WARMUP_FRAMES + ALLOC_CHECK_FRAMES; f++) {
+        watch.beginFrame();
+        int64_t start = profileNow();
+        arena.reset();
+        int* scratch = arena.allocate<int>(std::min(f, ALLOC_WARMUP_FRAMES / 2) * ALLOC_SCRATCH_GROWTH + 1);
+        scratch[0] = f;
+        sink = scratch[0];
+        stepScenario(scenarios.kickoff);
+        stepScenario(scenarios.scrum);
+        stepScenario(scenarios.stress);
+
+        inputs.player[0] = planner.plan(planned, inputs.player[1]);
+        planner.waitForSearch();
+        step(planned, inputs);
+        fastForward(skipped, inputs, MAX_STEP_FRAMES, MAX_STEP_FRAMES);
+
+        takeSnapshot(scenarios.stress.match, f, current);
+        const Snapshot* baseline = f > 0 ? &previous : NULL;
+        int size = encodeSnapshot(current, baseline, buffer, sizeof(buffer));
+        sink = decodeSnapshot(buffer, size, baseline, decoded);
+        std::swap(previous, current);
+
+        sink = simulation.latest().frame;
+        double p50, p99, max;
+        times.add((profileNow() - start) / 1e6);
+        times.summary(p50, p99, max);
+        times.histogram(buckets, 16, 0.1);
+        watch.endFrame();
+    }
+    setAllocationTracking(false);
+    simulation.stop();
+
+    watch.printReport("alloc/steady-state");
+    printf("%-24s outgrown %lld times, now %zu bytes\n", "alloc/frame-arena", arena.getOverflows(), arena.getCapacity());
+    if (watch.getFramesAllocating() > 0 || arena.getOverflows() == 0) {
+        printf("steady state frames allocated on the heap\n");
+        return false;
+    }
+    return true;
+}
+
+// Frame filled with one colour, a different one for every frame number
+static void fillFrame(uint32_t* pixels, int frame) {
+    uint32_t colour = frame == 0 ? 0xFFFFFFFFu : 0xFF000000u | (uint32_t)(frame * 0x102030);
+    for (int i = 0; i < CAPTURE_WIDTH * CAPTURE_HEIGHT; i++) {
+        pixels[i] = colour;
+    }
+}
+
+static long fileSize(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static void printCaptureStats(const char* name, const CaptureStats& stats) {
+    double p50, p99, max;
+    stats.writeMs.summary(p50, p99, max);
+    printf("%-24s %lld written, %lld dropped, %d queued at most, write p99 %.3f ms, %.1f MB/s\n", name, stats.written,
+        stats.dropped, stats.maxQueued, p99, stats.writeSeconds > 0 ? stats.bytes / stats.writeSeconds / 1e6 : 0.0);
+}
+
+// Checks captures write every frame they take in both formats, at the sizes
+// the formats call for, and that a capture out of buffers drops frames rather
+// than waiting
+static bool checkCapture() {
+    const char* videoPath = "bench-capture.y4m";
+    const char* framePattern = "bench-capture-%d.png";
+    bool valid = true;
+
+    // Every frame gets through when drawing waits for the writer
+    CaptureOptions options;
+    options.policy = CAPTURE_WAIT;
+    options.queueFrames = 2;
+    FrameCapture video;
+    valid = video.open(videoPath, CAPTURE_WIDTH, CAPTURE_HEIGHT, options);
+    for (int f = 0; f < CAPTURE_FRAMES && valid; f++) {
+        uint32_t* pixels = video.acquire();
+        valid = pixels != NULL;
+        if (valid) {
+            fillFrame(pixels, f);
+            video.submit();
+        }
+    }
+    valid = video.close() && valid && video.getStats().written == CAPTURE_FRAMES;
+
+    // A white first frame is full luma and no colour
+    char header[64];
+    int headerLength = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", CAPTURE_WIDTH, CAPTURE_HEIGHT);
+    int frameBytes = CAPTURE_WIDTH * CAPTURE_HEIGHT * 3 / 2;
+    valid = valid && fileSize(videoPath) == headerLength + CAPTURE_FRAMES * (6 + frameBytes);
+    FILE* file = fopen(videoPath, "rb");
+    if (file != NULL) {
+        std::vector<unsigned char> start(headerLength + 6 + frameBytes);
+        valid = valid && fread(start.data(), 1, start.size(), file) == start.size()
+            && memcmp(start.data(), header, headerLength) == 0 && start[headerLength + 6] == 255 && start.back() == 128;
+        fclose(file);
+    }
+    printCaptureStats("capture/y4m", video.getStats());
+    remove(videoPath);
+
+    options.format = CAPTURE_PNG;
+    FrameCapture frames;
+    valid = frames.open(framePattern, CAPTURE_WIDTH, CAPTURE_HEIGHT, options) && valid;
+    for (int f = 0; f < 2 && valid; f++) {
+        fillFrame(frames.acquire(), f);
+        frames.submit();
+    }
+    valid = frames.close() && valid;
+    printCaptureStats("capture/png", frames.getStats());
+    long rows = CAPTURE_HEIGHT * (1 + 3 * CAPTURE_WIDTH);
+    long pngBytes = 8 + 25 + 12 + 2 + (rows + 65534) / 65535 * 5 + rows + 4 + 12;
+    for (int f = 0; f < 2; f++) {
+        char name[64];
+        snprintf(name, sizeof(name), framePattern, f);
+        valid = valid && fileSize(name) == pngBytes;
+        remove(name);
+    }
+
+    // One buffer and no waiting: whatever is not dropped is written
+    options.format = CAPTURE_Y4M;
+    options.policy = CAPTURE_DROP;
+    options.queueFrames = 1;
+    FrameCapture burst;
+    valid = burst.open(videoPath, CAPTURE_WIDTH, CAPTURE_HEIGHT, options) && valid;
+    for (int f = 0; f < CAPTURE_BURST; f++) {
+        uint32_t* pixels = burst.acquire();
+        if (pixels != NULL) {
+            fillFrame(pixels, f);
+            burst.submit();
+        }
+    }
+    valid = burst.close() && valid;
+    const CaptureStats& stats = burst.getStats();
+    printCaptureStats("capture/dropping", stats);
+    valid = valid && stats.submitted + stats.dropped == CAPTURE_BURST && stats.written == stats.submitted && stats.maxQueued == 1
+        && fileSize(videoPath) == headerLength + stats.written * (6 + frameBytes);
+    remove(videoPath);
+
+    if (!valid) {
+        printf("frame capture lost frames or wrote them wrong\n");
+    }
+    return valid;
+}
+
+// Checks that values handed between two threads arrive whole and in order
+static bool checkHandoff() {
+    // Every published value is a run of equal numbers, a torn read mixes two
+    TripleBuffer<std::vector<int> > buffer;
+    SpscQueue<int> queue(256);
+    std::thread writer([&buffer, &queue]() {
+        for (int v = 1; v <= HANDOFF_VALUES; v++) {
+            buffer.writeSlot().assign(HANDOFF_WIDTH, v);
+            buffer.publish();
+            while (!queue.push(v)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    bool valid = true;
+    int last = 0;
+    int expected = 1;
+    while (expected <= HANDOFF_VALUES) {
+        int value;
+        if (queue.pop(value)) {
+            valid = valid && value == expected;
+            expected++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+        if (buffer.update()) {
+            const std::vector<int>& slot = buffer.readSlot();
+            for (int i = 0; i < HANDOFF_WIDTH; i++) {
+                valid = valid && slot[i] == slot[0];
+            }
+            valid = valid && slot[0] > last;
+            last = slot[0];
+        }
+    }
+    writer.join();
+
+    if (!valid) {
+        printf("lock-free hand-off returned torn or out of order values\n");
+    }
+    return valid;
+}
+
+// Steps a computer match on the simulation thread while the reader takes
+// random long frames; every step has to run when it is due regardless
+static bool checkSimThread() {
+    MatchState match;
+    initMatch(match, CONTROL_AI, CONTROL_AI, 11, 7);
+    SimThread simulation(match, SIM_RATE, 5, NULL);
+
+    std::mt19937 generator(12345);
+    std::uniform_int_distribution<int> frameMs(0, SIM_MAX_FRAME_MS);
+    bool valid = true;
+    int lastFrame = -1;
+    int64_t start = profileNow();
+    simulation.start();
+    while (profileNow() - start < (int64_t)(SIM_SECONDS * 1e9)) {
+        const MatchSnapshot& shown = simulation.latest();
+        valid = valid && shown.frame >= lastFrame && (int)shown.x.size() == match.bodies.count;
+        lastFrame = shown.frame;
+        std::this_thread::sleep_for(std::chrono::milliseconds(frameMs(generator)));
+    }
+    simulation.stop();
+
+    // The first step is due one interval after starting
+    long long due = (profileNow() - start) / simulation.stepInterval();
+    double p50, p99, max;
+    simulation.getLateness().summary(p50, p99, max);
+    printf("%-24s %lld of %lld steps due, late p50 %.3f  p99 %.3f  max %.3f ms\n", "simthread/stalled-reader",
+        simulation.getSteps(), due, p50, p99, max);
+
+    if (!valid) {
+        printf("simulation thread published a bad snapshot\n");
+    }
+    if (simulation.getSteps() < due - 1 || simulation.getDroppedSteps() > 0) {
+        printf("simulation thread fell behind, %lld steps dropped\n", simulation.getDroppedSteps());
+        valid = false;
+    }
+    return valid;
+}
+
+// A benchmark times all of its batches, or with a scope only the time spent in
+// the profiler scopes of that name
+struct Benchmark
+{
+    const char* name;
+    const char* unit;
+    BatchFunction batch;
+    const char* scope;
+};
+
+static const Benchmark BENCHMARKS[] = {
+    { "collide/legacy", "pairs", legacyBatch, NULL },
+    { "collide/scalar", "pairs", scalarBatch, NULL },
+    { "collide/simd", "pairs", simdBatch, NULL },
+    { "sim/isColliding", "pairs", collideBatch, NULL },
+    { "sim/updateVelocity", "steps", scrumBatch, "velocity" },
+    { "sim/updatePosition", "steps", scrumBatch, "position" },
+    { "sim/collisions", "steps", scrumBatch, "collisions" },
+    { "scenario/kickoff", "steps", kickoffBatch, NULL },
+    { "scenario/scrum", "steps", scrumBatch, NULL },
+    { "scenario/stress", "steps", stressBatch, NULL },
+    { "snapshot/encode", "snapshots", snapshotEncodeBatch, NULL },
+    { "snapshot/decode", "snapshots", snapshotDecodeBatch, NULL },
+    { "vecenv/step", "env steps", envStepBatch, NULL },
+};
+static const int BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+static void usage() {
+    printf("Usage: bench [--csv FILE] [--baseline FILE] [--tolerance PCT] [name ...]\n");
+}
+
+int main(int argc, char* args[]) {
+    BenchOptions options;
+    if (!parseBenchOptions(argc, args, options)) {
+        usage();
+        return 1;
+    }
+    if (!checkNarrowphase() || !checkHandoff() || !checkSnapshots() || !checkRecording() || !checkVecEnv() || !checkSweep()
+        || !checkSteadyState() || !checkCapture()) {
+        return -1;
+    }
+
+    printf("narrowphase kernel: %s\n", narrowphaseKernel());
+    BenchReport report;
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        const Benchmark& benchmark = BENCHMARKS[i];
+        if (!benchSelected(options, benchmark.name)) {
+            continue;
+        }
+        if (benchmark.scope == NULL) {
+            report.add(benchmark.name, benchmark.unit, measureRate(benchmark.batch));
+            continue;
+        }
+        double rate = measureScopeRate(benchmark.batch, benchmark.scope);
+        if (rate > 0) {
+            report.add(benchmark.name, benchmark.unit, rate);
+        }
+        else {
+            printf("%-28s no %s scopes, built without ENABLE_PROFILER\n", benchmark.name, benchmark.scope);
+        }
+    }
+
+    // Takes real time rather than repeating work, so it only runs when asked for
+    if (!options.prefixes.empty() && benchSelected(options, "simthread/stalled-reader") && !checkSimThread()) {
+        return -1;
+    }
+
+    return report.finish(options) ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "benchreport.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "profiler.h"
+
+double measureRate(BatchFunction batch) {
+    // Warm up caches first
+    batch();
+
+    long long operations = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    do {
+        operations += batch();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < BENCH_MIN_SECONDS);
+    return operations / seconds;
+}
+
+double measureScopeRate(BatchFunction batch, const char* scope) {
+    bool wasProfiling = isProfiling();
+    setProfiling(true);
+    batch();
+
+    // Events are collected after every batch, before the ring buffer wraps
+    std::vector<ProfileEvent> events;
+    events.reserve(PROFILE_CAPACITY);
+    long long operations = 0;
+    int64_t inside = 0;
+    int64_t start = profileNow();
+    do {
+        int64_t batchStart = profileNow();
+        operations += batch();
+        collectEvents(events);
+        for (size_t e = 0; e < events.size(); e++) {
+            if (events[e].start >= batchStart && strcmp(events[e].name, scope) == 0) {
+                inside += events[e].duration;
+            }
+        }
+    } while (profileNow() - start < (int64_t)(BENCH_MIN_SECONDS * 1e9));
+
+    setProfiling(wasProfiling);
+    return inside > 0 ? operations / (inside / 1e9) : 0;
+}
+
+bool parseBenchOptions(int argc, char* args[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        bool flag = strcmp(args[i], "--csv") == 0 || strcmp(args[i], "--baseline") == 0 || strcmp(args[i], "--tolerance") == 0;
+        if (!flag) {
+            // Anything else that looks like an option is a mistake, not a name
+            if (args[i][0] == '-') {
+                return false;
+            }
+            options.prefixes.push_back(args[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (strcmp(args[i], "--csv") == 0) {
+            options.csvPath = args[i + 1];
+        }
+        else if (strcmp(args[i], "--baseline") == 0) {
+            options.baselinePath = args[i + 1];
+        }
+        else {
+            options.tolerance = atof(args[i + 1]);
+        }
+        i++;
+    }
+    return true;
+}
+
+bool benchSelected(const BenchOptions& options, const char* name) {
+    if (options.prefixes.empty()) {
+        return true;
+    }
+    for (size_t i = 0; i < options.prefixes.size(); i++) {
+        if (strncmp(name, options.prefixes[i], strlen(options.prefixes[i])) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BenchReport::add(const char* name, const char* unit, double rate) {
+    printf("%-28s %14.0f %s/s\n", name, rate, unit);
+    BenchResult result;
+    result.name = name;
+    result.unit = unit;
+    result.rate = rate;
+    results.push_back(result);
+}
+
+const std::vector<BenchResult>& BenchReport::getResults() const {
+    return results;
+}
+
+bool BenchReport::writeCsv(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Unable to create %s!\n", path);
+        return false;
+    }
+    fprintf(file, "name,unit,rate\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(file, "%s,%s,%.1f\n", results[i].name.c_str(), results[i].unit.c_str(), results[i].rate);
+    }
+    fclose(file);
+    return true;
+}
+
+bool BenchReport::compare(const char* path, double tolerance) const {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Unable to open baseline %s!\n", path);
+        return false;
+    }
+    std::vector<BenchResult> baseline;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char name[128];
+        char unit[64];
+        double rate;
+        if (sscanf(line, "%127[^,],%63[^,],%lf", name, unit, &rate) == 3 && rate > 0) {
+            BenchResult result;
+            result.name = name;
+            result.unit = unit;
+            result.rate = rate;
+            baseline.push_back(result);
+        }
+    }
+    fclose(file);
+
+    printf("\nAgainst %s, regressions beyond %.1f%% marked\n", path, tolerance);
+    int regressions = 0;
+    int compared = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        for (size_t b = 0; b < baseline.size(); b++) {
+            if (baseline[b].name != results[i].name || baseline[b].unit != results[i].unit) {
+                continue;
+            }
+            double change = 100.0 * (results[i].rate / baseline[b].rate - 1.0);
+            bool regressed = change < -tolerance;
+            printf("%-28s %14.0f -> %14.0f %+7.1f%%%s\n", results[i].name.c_str(), baseline[b].rate, results[i].rate,
+                change, regressed ? "  REGRESSION" : "");
+            regressions += regressed ? 1 : 0;
+            compared++;
+            break;
+        }
+    }
+    printf("%d of %d results compared, %d regressed\n", compared, (int)results.size(), regressions);
+    return regressions == 0;
+}
+
+bool BenchReport::finish(const BenchOptions& options) const {
+    bool success = true;
+    if (options.csvPath != NULL) {
+        success = writeCsv(options.csvPath);
+    }
+    if (options.baselinePath != NULL) {
+        success = compare(options.baselinePath, options.tolerance) && success;
+    }
+    return success;
+}
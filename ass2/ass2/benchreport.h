@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Benchmark runs shared by the benchmark tools
+// Every result is a rate, operations a second, so higher is always better.
+// Results can be saved as CSV and a later run compared against them.
+
+// Each benchmark runs for at least this long
+const double BENCH_MIN_SECONDS = 0.25;
+
+// Slowdown, in percent, that counts as a regression unless told otherwise
+const double BENCH_DEFAULT_TOLERANCE = 10.0;
+
+// Runs one batch of work that counts as the returned number of operations
+typedef long long (*BatchFunction)();
+
+// Repeats a batch until enough time has passed and returns operations per second
+double measureRate(BatchFunction batch);
+
+// Like measureRate, but only counts the time spent inside profiler scopes
+// with the given name, so one phase of the work is timed on its own
+// Returns 0 when no such scope was recorded, as without ENABLE_PROFILER
+double measureScopeRate(BatchFunction batch, const char* scope);
+
+struct BenchResult
+{
+    std::string name;
+    std::string unit;
+    double rate;
+};
+
+// Command line shared by the benchmark tools
+//   --csv FILE        saves the results
+//   --baseline FILE   compares against results saved before
+//   --tolerance PCT   slowdown allowed before a result counts as a regression
+// Any other argument is a prefix of the benchmarks to run, all of them without any
+struct BenchOptions
+{
+    BenchOptions() : csvPath(NULL), baselinePath(NULL), tolerance(BENCH_DEFAULT_TOLERANCE) {
+    }
+
+    const char* csvPath;
+    const char* baselinePath;
+    double tolerance;
+    std::vector<const char*> prefixes;
+};
+
+// Returns false on an unknown flag or a flag without its value
+bool parseBenchOptions(int argc, char* args[], BenchOptions& options);
+
+// Whether a benchmark was asked for
+bool benchSelected(const BenchOptions& options, const char* name);
+
+//Bench report class
+//Prints results as they come in, then saves and compares them
+class BenchReport
+{
+public:
+    //Prints and keeps a result
+    void add(const char* name, const char* unit, double rate);
+
+    const std::vector<BenchResult>& getResults() const;
+
+    //Saves the results as CSV lines of name,unit,rate
+    bool writeCsv(const char* path) const;
+
+    //Prints the change of every result also in a CSV saved by writeCsv
+    //False if the file cannot be read or a result got slower by more than
+    //tolerance percent
+    bool compare(const char* path, double tolerance) const;
+
+    //Saves and compares as the options ask, false if either failed
+    bool finish(const BenchOptions& options) const;
+
+private:
+    std::vector<BenchResult> results;
+};
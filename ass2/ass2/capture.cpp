@@ -0,0 +1,388 @@
+#include "capture.h"
+#include <string.h>
+#include <chrono>
+
+// Longest wait before a sleeping thread looks again, in case a wake-up was missed
+const int CAPTURE_POLL_MILLISECONDS = 5;
+
+// Largest stored deflate block
+const int PNG_BLOCK_BYTES = 65535;
+
+CaptureOptions::CaptureOptions() {
+    //Initialize
+    format = CAPTURE_Y4M;
+    policy = CAPTURE_DROP;
+    queueFrames = 8;
+    fps = 60;
+}
+
+CaptureStats::CaptureStats() {
+    //Initialize
+    submitted = 0;
+    written = 0;
+    dropped = 0;
+    bytes = 0;
+    maxQueued = 0;
+    waitMs = 0;
+    writeSeconds = 0;
+    seconds = 0;
+}
+
+CaptureFormat captureFormatFor(const char* path) {
+    size_t length = strlen(path);
+    return length >= 4 && strcmp(path + length - 4, ".y4m") == 0 ? CAPTURE_Y4M : CAPTURE_PNG;
+}
+
+// CRC-32 of PNG chunks, table built on first use
+struct CrcTable
+{
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) != 0 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+
+    uint32_t entries[256];
+};
+
+static uint32_t crc32(uint32_t crc, const unsigned char* bytes, size_t count) {
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < count; i++) {
+        crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static unsigned char* putBigEndian(unsigned char* out, uint32_t value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+    return out + 4;
+}
+
+// Writes a chunk whose data already follows its 8 byte head in chunk
+static bool writeChunk(FILE* file, unsigned char* chunk, const char* type, uint32_t length) {
+    putBigEndian(chunk, length);
+    memcpy(chunk + 4, type, 4);
+    unsigned char crc[4];
+    putBigEndian(crc, crc32(0, chunk + 4, length + 4));
+    return fwrite(chunk, 1, length + 8, file) == length + 8 && fwrite(crc, 1, 4, file) == 4;
+}
+
+// Bytes of the RGB rows of a frame with their filter bytes, and of the
+// deflate stream that stores them
+static size_t pngRawBytes(int width, int height) {
+    return (size_t)height * (1 + 3 * (size_t)width);
+}
+
+static size_t pngStreamBytes(int width, int height) {
+    size_t raw = pngRawBytes(width, height);
+    size_t blocks = (raw + PNG_BLOCK_BYTES - 1) / PNG_BLOCK_BYTES;
+    return 2 + blocks * 5 + raw + 4;
+}
+
+FrameCapture::FrameCapture() : filled(CAPTURE_MAX_QUEUE), spare(CAPTURE_MAX_QUEUE), waiting(0), stopping(false) {
+    //Initialize
+    width = 0;
+    height = 0;
+    video = NULL;
+    pending = -1;
+    failed = false;
+    opened = 0;
+}
+
+FrameCapture::~FrameCapture() {
+    close();
+}
+
+bool FrameCapture::open(const char* outputPath, int frameWidth, int frameHeight, const CaptureOptions& captureOptions) {
+    close();
+    options = captureOptions;
+    options.queueFrames = options.queueFrames < 1 ? 1 : (options.queueFrames > CAPTURE_MAX_QUEUE ? CAPTURE_MAX_QUEUE : options.queueFrames);
+    options.fps = options.fps < 1 ? 1 : options.fps;
+    if (frameWidth < 2 || frameHeight < 2 || (options.format == CAPTURE_Y4M && (frameWidth % 2 != 0 || frameHeight % 2 != 0))) {
+        printf("Unable to capture %d by %d frames!\n", frameWidth, frameHeight);
+        return false;
+    }
+    if (options.format == CAPTURE_PNG && strchr(outputPath, '%') == NULL) {
+        printf("PNG capture path %s needs a frame number pattern such as %%05d!\n", outputPath);
+        return false;
+    }
+
+    if (options.format == CAPTURE_Y4M) {
+        video = fopen(outputPath, "wb");
+        if (video == NULL || fprintf(video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", frameWidth, frameHeight, options.fps) < 0) {
+            printf("Unable to create %s!\n", outputPath);
+            if (video != NULL) {
+                fclose(video);
+                video = NULL;
+            }
+            return false;
+        }
+    }
+
+    path = outputPath;
+    width = frameWidth;
+    height = frameHeight;
+    size_t pixels = (size_t)width * height;
+    buffers.assign(pixels * options.queueFrames, 0);
+    frameNumbers.assign(options.queueFrames, 0);
+    size_t y4mBytes = pixels + pixels / 2;
+    size_t pngBytes = 8 + pngStreamBytes(width, height);
+    encoded.assign(y4mBytes > pngBytes ? y4mBytes : pngBytes, 0);
+
+    int unused;
+    while (filled.pop(unused) || spare.pop(unused)) {
+    }
+    for (int i = 0; i < options.queueFrames; i++) {
+        spare.push(i);
+    }
+    pending = -1;
+    waiting.store(0);
+    stopping.store(false);
+    failed = false;
+    stats = CaptureStats();
+    opened = profileNow();
+    writer = std::thread(&FrameCapture::run, this);
+    return true;
+}
+
+uint32_t* FrameCapture::acquire() {
+    if (!isOpen()) {
+        return NULL;
+    }
+    if (pending < 0) {
+        int buffer;
+        if (!spare.pop(buffer)) {
+            if (options.policy == CAPTURE_DROP) {
+                stats.dropped++;
+                return NULL;
+            }
+            int64_t start = profileNow();
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!spare.pop(buffer)) {
+                bufferFree.wait_for(lock, std::chrono::milliseconds(CAPTURE_POLL_MILLISECONDS));
+            }
+            stats.waitMs += (profileNow() - start) / 1e6;
+        }
+        pending = buffer;
+    }
+    return &buffers[(size_t)pending * width * height];
+}
+
+void FrameCapture::submit() {
+    if (pending < 0) {
+        return;
+    }
+    // There are only as many buffers as the queue holds, so there is room
+    frameNumbers[pending] = stats.submitted++;
+    filled.push(pending);
+    pending = -1;
+    int queuedFrames = waiting.fetch_add(1) + 1;
+    stats.maxQueued = queuedFrames > stats.maxQueued ? queuedFrames : stats.maxQueued;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    frameReady.notify_one();
+}
+
+bool FrameCapture::close() {
+    if (!isOpen()) {
+        return !failed;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping.store(true);
+    }
+    frameReady.notify_one();
+    writer.join();
+
+    if (video != NULL) {
+        failed = fclose(video) != 0 || failed;
+        video = NULL;
+    }
+    stats.seconds = (profileNow() - opened) / 1e9;
+    path.clear();
+    if (failed) {
+        printf("Capture failed to write every frame!\n");
+    }
+    return !failed;
+}
+
+bool FrameCapture::isOpen() const {
+    return writer.joinable();
+}
+
+int FrameCapture::queued() const {
+    return waiting.load();
+}
+
+const CaptureStats& FrameCapture::getStats() const {
+    return stats;
+}
+
+void FrameCapture::run() {
+    for (;;) {
+        // Frames submitted before stopping are still written
+        int buffer;
+        if (!filled.pop(buffer)) {
+            bool stop = stopping.load();
+            if (!filled.pop(buffer)) {
+                if (stop) {
+                    return;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                frameReady.wait_for(lock, std::chrono::milliseconds(CAPTURE_POLL_MILLISECONDS),
+                    [this] { return waiting.load() > 0 || stopping.load(); });
+                continue;
+            }
+        }
+
+        int64_t start = profileNow();
+        bool written = writeFrame(&buffers[(size_t)buffer * width * height], frameNumbers[buffer]);
+        double milliseconds = (profileNow() - start) / 1e6;
+        stats.writeSeconds += milliseconds / 1000;
+        stats.writeMs.add(milliseconds);
+        if (written) {
+            stats.written++;
+        }
+        else {
+            failed = true;
+        }
+
+        spare.push(buffer);
+        waiting.fetch_sub(1);
+        bufferFree.notify_one();
+    }
+}
+
+bool FrameCapture::writeFrame(const uint32_t* pixels, long long index) {
+    return options.format == CAPTURE_Y4M ? writeY4m(pixels) : writePng(pixels, index);
+}
+
+bool FrameCapture::writeY4m(const uint32_t* pixels) {
+    // Luma for every pixel, then chroma from the average of each 2x2 block
+    size_t count = (size_t)width * height;
+    unsigned char* luma = encoded.data();
+    unsigned char* blue = luma + count;
+    unsigned char* red = blue + count / 4;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t p = pixels[i];
+        int r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF;
+        luma[i] = (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+    }
+    for (int y = 0; y < height; y += 2) {
+        const uint32_t* top = pixels + (size_t)y * width;
+        const uint32_t* bottom = top + width;
+        for (int x = 0; x < width; x += 2) {
+            uint32_t quad[4] = { top[x], top[x + 1], bottom[x], bottom[x + 1] };
+            int r = 0, g = 0, b = 0;
+            for (int q = 0; q < 4; q++) {
+                r += (quad[q] >> 16) & 0xFF;
+                g += (quad[q] >> 8) & 0xFF;
+                b += quad[q] & 0xFF;
+            }
+            // Sums of four, so the shift is two more; the offset keeps them positive
+            size_t at = (size_t)(y / 2) * (width / 2) + x / 2;
+            int cb = (-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10;
+            int cr = (128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10;
+            blue[at] = (unsigned char)(cb > 255 ? 255 : cb);
+            red[at] = (unsigned char)(cr > 255 ? 255 : cr);
+        }
+    }
+
+    size_t bytes = count + count / 2;
+    if (fwrite("FRAME\n", 1, 6, video) != 6 || fwrite(encoded.data(), 1, bytes, video) != bytes) {
+        return false;
+    }
+    stats.bytes += 6 + (long long)bytes;
+    return true;
+}
+
+bool FrameCapture::writePng(const uint32_t* pixels, long long index) {
+    char name[1024];
+    snprintf(name, sizeof(name), path.c_str(), (int)index);
+    FILE* file = fopen(name, "wb");
+    if (file == NULL) {
+        printf("Unable to create %s!\n", name);
+        return false;
+    }
+
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    unsigned char header[8 + 13];
+    unsigned char* out = putBigEndian(header + 8, (uint32_t)width);
+    out = putBigEndian(out, (uint32_t)height);
+    out[0] = 8;
+    out[1] = 2;
+    out[2] = 0;
+    out[3] = 0;
+    out[4] = 0;
+    bool success = fwrite(SIGNATURE, 1, 8, file) == 8 && writeChunk(file, header, "IHDR", 13);
+
+    // Rows without filtering in stored deflate blocks, so the writer never
+    // waits on compression
+    size_t raw = pngRawBytes(width, height);
+    unsigned char* chunk = encoded.data();
+    out = chunk + 8;
+    *out++ = 0x78;
+    *out++ = 0x01;
+    size_t blockLeft = 0;
+    size_t rawLeft = raw;
+    uint32_t adlerA = 1, adlerB = 0;
+    int unreduced = 0;
+    for (int y = 0; y < height; y++) {
+        const uint32_t* row = pixels + (size_t)y * width;
+        for (int x = -1; x < width; x++) {
+            unsigned char rgb[3];
+            int channels = 0;
+            if (x < 0) {
+                rgb[channels++] = 0;
+            }
+            else {
+                rgb[channels++] = (unsigned char)(row[x] >> 16);
+                rgb[channels++] = (unsigned char)(row[x] >> 8);
+                rgb[channels++] = (unsigned char)row[x];
+            }
+            for (int c = 0; c < channels; c++) {
+                if (blockLeft == 0) {
+                    blockLeft = rawLeft < (size_t)PNG_BLOCK_BYTES ? rawLeft : (size_t)PNG_BLOCK_BYTES;
+                    rawLeft -= blockLeft;
+                    *out++ = rawLeft == 0 ? 1 : 0;
+                    *out++ = (unsigned char)blockLeft;
+                    *out++ = (unsigned char)(blockLeft >> 8);
+                    *out++ = (unsigned char)~blockLeft;
+                    *out++ = (unsigned char)(~blockLeft >> 8);
+                }
+                *out++ = rgb[c];
+                blockLeft--;
+                adlerA += rgb[c];
+                adlerB += adlerA;
+
+                // The sums cannot overflow within this many bytes
+                if (++unreduced == 5552) {
+                    adlerA %= 65521;
+                    adlerB %= 65521;
+                    unreduced = 0;
+                }
+            }
+        }
+    }
+    adlerA %= 65521;
+    adlerB %= 65521;
+    out = putBigEndian(out, (adlerB << 16) | adlerA);
+
+    uint32_t length = (uint32_t)(out - chunk - 8);
+    unsigned char end[8];
+    success = success && writeChunk(file, chunk, "IDAT", length) && writeChunk(file, end, "IEND", 0);
+    success = fclose(file) == 0 && success;
+    if (success) {
+        stats.bytes += 8 + 25 + 12 + length + 12;
+    }
+    return success;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lockfree.h"
+#include "profiler.h"
+
+// Frame buffers a capture can have
+const int CAPTURE_MAX_QUEUE = 64;
+
+// Frame capture
+//
+// Streams drawn frames to a Y4M video or a sequence of PNG files. The drawing
+// thread fills one of a fixed set of frame buffers and hands it to a writer
+// thread, which converts and writes it and hands the buffer back. When the
+// writer falls behind and every buffer is waiting, the frame is dropped, so
+// capturing never holds up drawing; an offline export can choose to wait for
+// a buffer instead. Buffers are allocated once, when the capture opens.
+
+enum CaptureFormat
+{
+    // One YUV 4:2:0 video at the given rate, full range BT.601
+    CAPTURE_Y4M,
+    // One uncompressed RGB PNG a frame, the path a printf pattern such as
+    // shots/%05d.png taking the frame number
+    CAPTURE_PNG
+};
+
+enum CapturePolicy
+{
+    CAPTURE_DROP,
+    CAPTURE_WAIT
+};
+
+struct CaptureOptions
+{
+    //Initializes variables
+    CaptureOptions();
+
+    CaptureFormat format;
+    CapturePolicy policy;
+
+    // Frame buffers, the most frames waiting for the writer at once, at
+    // most CAPTURE_MAX_QUEUE
+    int queueFrames;
+
+    // Frames a second of the video
+    int fps;
+};
+
+struct CaptureStats
+{
+    //Initializes variables
+    CaptureStats();
+
+    // Frames handed to the writer, written, and dropped because every buffer
+    // was still waiting
+    long long submitted;
+    long long written;
+    long long dropped;
+    long long bytes;
+
+    // Most frames waiting for the writer at once, and how long drawing
+    // waited for a buffer under CAPTURE_WAIT
+    int maxQueued;
+    double waitMs;
+
+    // Time the writer spent converting and writing, in all and for each of
+    // the recent frames, and from opening to closing
+    double writeSeconds;
+    FrameTimes writeMs;
+    double seconds;
+};
+
+// Format the path asks for, Y4M when it ends in .y4m
+CaptureFormat captureFormatFor(const char* path);
+
+//Frame capture class
+//Hands frames from the drawing thread to a writer thread; acquire and submit
+//are called from one thread only
+class FrameCapture
+{
+public:
+    //Initializes variables
+    FrameCapture();
+
+    //Finishes writing if still open
+    ~FrameCapture();
+
+    //Creates the output, allocates the buffers and starts the writer
+    //Frames are width by height, both even for Y4M
+    bool open(const char* path, int width, int height, const CaptureOptions& options);
+
+    //Buffer for the next frame, width * height ARGB8888 pixels in rows of
+    //width; NULL when the frame is dropped
+    uint32_t* acquire();
+
+    //Hands the acquired buffer to the writer
+    void submit();
+
+    //Writes every submitted frame, stops the writer and closes the output
+    //False if anything failed to write
+    bool close();
+
+    bool isOpen() const;
+
+    //Frames waiting for the writer
+    int queued() const;
+
+    //Only read after close
+    const CaptureStats& getStats() const;
+
+private:
+    FrameCapture(const FrameCapture&);
+    FrameCapture& operator=(const FrameCapture&);
+
+    void run();
+
+    //Converts and writes one frame, false on failure
+    bool writeFrame(const uint32_t* pixels, long long index);
+    bool writeY4m(const uint32_t* pixels);
+    bool writePng(const uint32_t* pixels, long long index);
+
+    std::string path;
+    int width;
+    int height;
+    CaptureOptions options;
+    FILE* video;
+
+    // Pixels of every buffer one after another, and the conversion space
+    std::vector<uint32_t> buffers;
+    std::vector<unsigned char> encoded;
+
+    // Number of the frame in each buffer, counting submitted frames
+    std::vector<long long> frameNumbers;
+
+    // Buffer indices: filled ones on the way to the writer, written ones
+    // on the way back
+    SpscQueue<int> filled;
+    SpscQueue<int> spare;
+    int pending;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable frameReady;
+    std::condition_variable bufferFree;
+    std::atomic<int> waiting;
+    std::atomic<bool> stopping;
+    bool failed;
+    int64_t opened;
+
+    CaptureStats stats;
+};
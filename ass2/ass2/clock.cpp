@@ -0,0 +1,95 @@
+#include "clock.h"
+
+FramePacer::FramePacer(int framesPerSecond) {
+    //Initialize
+    frequency = SDL_GetPerformanceFrequency();
+    interval = framesPerSecond > 0 ? frequency / framesPerSecond : 0;
+    next = SDL_GetPerformanceCounter() + interval;
+}
+
+void FramePacer::wait() {
+    if (interval == 0) {
+        return;
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now < next) {
+        // Sleep most of the way, SDL_Delay can overshoot by a millisecond or more
+        Uint64 remainingMs = (next - now) * 1000 / frequency;
+        if (remainingMs > 2) {
+            SDL_Delay((Uint32)(remainingMs - 2));
+        }
+
+        // Then spin for the rest
+        while (SDL_GetPerformanceCounter() < next) {
+        }
+        next += interval;
+    }
+    else {
+        // Running late: restart the schedule instead of rushing to catch up
+        next = now + interval;
+    }
+}
+
+// Time kept free before a refresh on top of the longest recent frame, for
+// SDL_Delay overshoot and the odd slower frame
+const double LATCH_MARGIN_SECONDS = 0.002;
+
+LateLatch::LateLatch(int refreshRate) {
+    //Initialize
+    frequency = SDL_GetPerformanceFrequency();
+    period = refreshRate > 0 ? frequency / refreshRate : 0;
+    sampled = refreshed = SDL_GetPerformanceCounter();
+    slept = 0;
+    for (int i = 0; i < LATCH_HISTORY; i++) {
+        // Until frames are measured assume they need the whole period
+        work[i] = period;
+    }
+    next = 0;
+}
+
+void LateLatch::wait() {
+    Uint64 now = SDL_GetPerformanceCounter();
+    slept = 0;
+    if (period == 0) {
+        sampled = now;
+        return;
+    }
+
+    Uint64 longest = 0;
+    for (int i = 0; i < LATCH_HISTORY; i++) {
+        if (work[i] > longest) {
+            longest = work[i];
+        }
+    }
+    Uint64 needed = longest + (Uint64)(LATCH_MARGIN_SECONDS * frequency);
+
+    // Read input when just enough of the period is left for the frame's work
+    if (needed < period) {
+        Uint64 due = refreshed + period - needed;
+        if (now < due) {
+            // Sleep most of the way, then spin for the rest like the frame pacer
+            Uint64 remainingMs = (due - now) * 1000 / frequency;
+            if (remainingMs > 2) {
+                SDL_Delay((Uint32)(remainingMs - 2));
+            }
+            while (SDL_GetPerformanceCounter() < due) {
+            }
+            slept = SDL_GetPerformanceCounter() - now;
+        }
+    }
+    sampled = SDL_GetPerformanceCounter();
+}
+
+void LateLatch::presenting() {
+    work[next] = SDL_GetPerformanceCounter() - sampled;
+    next = (next + 1) % LATCH_HISTORY;
+}
+
+void LateLatch::presented() {
+    refreshed = SDL_GetPerformanceCounter();
+}
+
+double LateLatch::lastWaitMs() const {
+    return slept * 1000.0 / frequency;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <SDL.h>
+
+//Frame pacer class
+//Caps how often frames are drawn, independently of the simulation rate
+class FramePacer
+{
+public:
+    //Initializes variables, 0 frames per second means no cap
+    explicit FramePacer(int framesPerSecond);
+
+    //Sleeps until the next frame is due
+    void wait();
+
+private:
+    Uint64 frequency;
+    Uint64 interval;
+    Uint64 next;
+};
+
+// Frames whose work times predict how long the next frame takes
+const int LATCH_HISTORY = 32;
+
+//Late latch class
+//With vsync, present returns just after a refresh and the next one is a whole
+//refresh period away. Sleeping through the part of that period the frame does
+//not need before reading input shows the input a refresh sooner.
+class LateLatch
+{
+public:
+    //Initializes variables for a display refreshing refreshRate times a second,
+    //0 never sleeps
+    explicit LateLatch(int refreshRate);
+
+    //Sleeps until input has to be read for the frame to make the next refresh
+    void wait();
+
+    //Marks the frame's work, from reading input until present is called, as done
+    void presenting();
+
+    //Marks present as returned, which happens at a refresh
+    void presented();
+
+    //Milliseconds the last wait slept
+    double lastWaitMs() const;
+
+private:
+    Uint64 frequency;
+    Uint64 period;
+
+    Uint64 sampled;
+    Uint64 refreshed;
+    Uint64 slept;
+
+    // Work times of the last frames, the longest is what the next one is allowed
+    Uint64 work[LATCH_HISTORY];
+    int next;
+};
@@ -0,0 +1,121 @@
+#include "grid.h"
+
+UniformGrid::UniformGrid() {
+    //Initialize
+    left = 0;
+    top = 0;
+    cellSize = 1;
+    columns = 0;
+    rows = 0;
+}
+
+void UniformGrid::setup(int areaLeft, int areaTop, int areaRight, int areaBottom, int size) {
+    left = areaLeft;
+    top = areaTop;
+    cellSize = size > 0 ? size : 1;
+    columns = (areaRight - areaLeft + cellSize - 1) / cellSize;
+    rows = (areaBottom - areaTop + cellSize - 1) / cellSize;
+    if (columns < 1) {
+        columns = 1;
+    }
+    if (rows < 1) {
+        rows = 1;
+    }
+    cellStart.assign(columns * rows + 1, 0);
+}
+
+int UniformGrid::cellOf(int x, int y) const {
+    // Bodies pushed past the edge go in the border cells
+    int column = (x - left) / cellSize;
+    int row = (y - top) / cellSize;
+    if (x < left || column < 0) {
+        column = 0;
+    }
+    else if (column >= columns) {
+        column = columns - 1;
+    }
+    if (y < top || row < 0) {
+        row = 0;
+    }
+    else if (row >= rows) {
+        row = rows - 1;
+    }
+    return row * columns + column;
+}
+
+void UniformGrid::build(const int* x, const int* y, int count) {
+    int cells = columns * rows;
+    bodyCell.resize(count);
+    cellBodies.resize(count);
+    for (int c = 0; c <= cells; c++) {
+        cellStart[c] = 0;
+    }
+
+    // Count bodies per cell
+    for (int i = 0; i < count; i++) {
+        int cell = cellOf(x[i], y[i]);
+        bodyCell[i] = cell;
+        cellStart[cell + 1]++;
+    }
+
+    // Turn counts into offsets
+    for (int c = 0; c < cells; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    // Fill cells in body order; cellStart[c] ends up at the end of cell c
+    for (int i = 0; i < count; i++) {
+        cellBodies[cellStart[bodyCell[i]]++] = i;
+    }
+
+    // Shift back so cellStart[c] is the start of cell c again
+    for (int c = cells; c > 0; c--) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+}
+
+void UniformGrid::findPairs(std::vector<CandidatePair>& pairs) const {
+    pairs.clear();
+
+    // Each cell is paired with itself and the four neighbours ahead of it,
+    // so every neighbouring pair of cells is visited once
+    static const int OFFSETS[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            int cell = row * columns + column;
+            int begin = cellStart[cell];
+            int end = cellStart[cell + 1];
+            if (begin == end) {
+                continue;
+            }
+
+            // Pairs within the cell
+            for (int i = begin; i < end; i++) {
+                for (int j = i + 1; j < end; j++) {
+                    CandidatePair pair = { cellBodies[i], cellBodies[j] };
+                    pairs.push_back(pair);
+                }
+            }
+
+            // Pairs with neighbouring cells
+            for (int n = 0; n < 4; n++) {
+                int otherColumn = column + OFFSETS[n][0];
+                int otherRow = row + OFFSETS[n][1];
+                if (otherColumn < 0 || otherColumn >= columns || otherRow >= rows) {
+                    continue;
+                }
+                int other = otherRow * columns + otherColumn;
+                for (int i = begin; i < end; i++) {
+                    for (int j = cellStart[other]; j < cellStart[other + 1]; j++) {
+                        int a = cellBodies[i];
+                        int b = cellBodies[j];
+                        CandidatePair pair = { a < b ? a : b, a < b ? b : a };
+                        pairs.push_back(pair);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+// Two bodies that may be touching, a < b
+struct CandidatePair
+{
+    int a;
+    int b;
+};
+
+// Uniform grid broadphase
+// Bodies are binned by centre into square cells at least as wide as the largest
+// body, so two bodies can only touch when they share a cell or sit in
+// neighbouring cells. Rebuilding is a counting sort, linear in the body count.
+class UniformGrid
+{
+public:
+    //Initializes variables
+    UniformGrid();
+
+    //Covers the given area with cells of the given size
+    void setup(int left, int top, int right, int bottom, int cellSize);
+
+    //Bins bodies [0, count) by position
+    void build(const int* x, const int* y, int count);
+
+    //Replaces pairs with every pair of bodies in the same or neighbouring cells
+    void findPairs(std::vector<CandidatePair>& pairs) const;
+
+private:
+    int cellOf(int x, int y) const;
+
+    int left;
+    int top;
+    int cellSize;
+    int columns;
+    int rows;
+
+    // Bodies sorted by cell, cell c holds cellBodies[cellStart[c] .. cellStart[c + 1])
+    std::vector<int> cellStart;
+    std::vector<int> cellBodies;
+    std::vector<int> bodyCell;
+};
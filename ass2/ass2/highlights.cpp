@@ -0,0 +1,204 @@
+// Renders a recorded match to a video or a sequence of frames, with no display
+//
+// Usage: highlights [--from F] [--to T] [--queue N] [--lossless] FILE OUTPUT
+// Plays the recording and draws the frames from F to T (the whole match by
+// default) the way the game draws them, on the software renderer into a
+// surface in memory, so no window or video driver is needed. OUTPUT ending
+// in .y4m gets a 60 fps YUV 4:2:0 video; anything else is a printf pattern for
+// PNG files such as shots/%05d.png. Frames go to a writer thread through N
+// buffers (8 by default); when all of them wait for the writer the frame is
+// dropped, unless --lossless makes drawing wait. Runs from the directory
+// holding assets/ and loads the loose files.
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "arena.h"
+#include "capture.h"
+#include "media.h"
+#include "recording.h"
+#include "sim.h"
+#include "simthread.h"
+
+SDL_Surface* target = NULL;
+SDL_Renderer* renderer = NULL;
+SDL_Texture* background = NULL;
+FrameArena frameArena(FRAME_ARENA_BYTES);
+SpriteAtlas spriteAtlas;
+SpriteBatch spriteBatch;
+Font font;
+GameSprites sprites;
+MatchView view(SCREEN_WIDTH, SCREEN_HEIGHT);
+MatchSnapshot shown;
+std::vector<int> previousX;
+std::vector<int> previousY;
+
+static bool init() {
+    // Only the renderer is needed, the video subsystem is not
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
+        return false;
+    }
+    if (TTF_Init() == -1) {
+        printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+        return false;
+    }
+
+    // Frames are drawn straight into the pixels the capture copies
+    target = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (target == NULL) {
+        printf("Surface could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    renderer = SDL_CreateSoftwareRenderer(target);
+    if (renderer == NULL) {
+        printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+
+    // The surface keeps the last frame, so only what moved is drawn again
+    if (!loadLooseMedia(renderer, background, spriteAtlas, font, sprites)
+        || !view.create(renderer, background, &spriteAtlas, &spriteBatch, &font, sprites, true)) {
+        return false;
+    }
+    spriteBatch.setArena(&frameArena);
+    return true;
+}
+
+static void close() {
+    view.free();
+    spriteAtlas.free();
+    SDL_DestroyTexture(background);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(target);
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+}
+
+// Copies the drawn frame into a capture buffer, unless the capture drops it
+static void captureFrame(FrameCapture& capture) {
+    uint32_t* pixels = capture.acquire();
+    if (pixels == NULL) {
+        return;
+    }
+    SDL_LockSurface(target);
+    const unsigned char* row = (const unsigned char*)target->pixels;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        memcpy(pixels + y * SCREEN_WIDTH, row + y * target->pitch, SCREEN_WIDTH * sizeof(uint32_t));
+    }
+    SDL_UnlockSurface(target);
+    capture.submit();
+}
+
+static void usage() {
+    printf("Usage: highlights [--from F] [--to T] [--queue N] [--lossless] FILE OUTPUT\n");
+}
+
+int main(int argc, char* args[]) {
+    int from = 0;
+    int to = -1;
+    const char* path = NULL;
+    const char* output = NULL;
+    CaptureOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--from") == 0 && i + 1 < argc) {
+            from = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--to") == 0 && i + 1 < argc) {
+            to = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--queue") == 0 && i + 1 < argc) {
+            options.queueFrames = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--lossless") == 0) {
+            options.policy = CAPTURE_WAIT;
+        }
+        else if (args[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else if (path == NULL) {
+            path = args[i];
+        }
+        else {
+            output = args[i];
+        }
+    }
+    if (path == NULL || output == NULL || from < 0 || options.queueFrames < 1 || options.queueFrames > CAPTURE_MAX_QUEUE) {
+        usage();
+        return 1;
+    }
+    options.format = captureFormatFor(output);
+
+    ReplayReader reader;
+    if (!reader.load(path)) {
+        return 1;
+    }
+    const ReplayHeader& header = reader.header();
+    if (header.teamSize < 1 || header.control[0] > CONTROL_PLANNED || header.control[1] > CONTROL_PLANNED) {
+        printf("Recording %s has an invalid match setup!\n", path);
+        return 1;
+    }
+
+    if (!init()) {
+        close();
+        return -1;
+    }
+    FrameCapture capture;
+    if (!capture.open(output, SCREEN_WIDTH, SCREEN_HEIGHT, options)) {
+        close();
+        return -1;
+    }
+
+    // Frames before the highlight are only simulated
+    MatchState match;
+    initMatch(match, header.control[0], header.control[1], header.teamSize, header.seed);
+    Inputs inputs;
+    double drawSeconds = 0;
+    long long drawn = 0;
+    while (reader.next(inputs)) {
+        previousX = match.bodies.x;
+        previousY = match.bodies.y;
+        step(match, inputs);
+        if (to >= 0 && match.frame > to) {
+            break;
+        }
+        if (match.frame < from) {
+            continue;
+        }
+        // Each step shown once, where it ends
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        frameArena.reset();
+        snapshotMatch(shown, match, previousX, previousY);
+        view.render(shown, 1.0f, NULL);
+        SDL_RenderPresent(renderer);
+        captureFrame(capture);
+        drawSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        drawn++;
+    }
+
+    bool written = capture.close();
+    close();
+
+    const CaptureStats& stats = capture.getStats();
+    double p50, p99, max;
+    stats.writeMs.summary(p50, p99, max);
+    printf("%lld frames drawn at %.0f frames/s\n", drawn, drawSeconds > 0 ? drawn / drawSeconds : 0.0);
+    printf("%lld written, %lld dropped, %d of %d buffers waiting at most, %.1f ms waiting for buffers\n", stats.written,
+        stats.dropped, stats.maxQueued, options.queueFrames, stats.waitMs);
+    printf("Writer: %.1f MB at %.1f MB/s, %.0f frames/s, write p50 %.2f p99 %.2f max %.2f ms, %.3f s in all\n", stats.bytes / 1e6,
+        stats.writeSeconds > 0 ? stats.bytes / stats.writeSeconds / 1e6 : 0.0,
+        stats.writeSeconds > 0 ? stats.written / stats.writeSeconds : 0.0, p50, p99, max, stats.seconds);
+    if (!written) {
+        printf("Failed to write %s!\n", output);
+        return 1;
+    }
+    return 0;
+}
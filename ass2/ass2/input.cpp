@@ -0,0 +1,95 @@
+#include "input.h"
+#include "profiler.h"
+
+// Profiler clock time of an SDL event timestamp
+// Event timestamps count whole milliseconds since SDL started, so the result
+// is within a millisecond of when SDL queued the event
+static int64_t eventTime(Uint32 timestamp) {
+    int64_t now = profileNow();
+    Uint32 age = SDL_GetTicks() - timestamp;
+    return now - (int64_t)age * 1000000;
+}
+
+// Button a key stands for on one side, 0 if none
+static unsigned char buttonFor(const KeyBindings& keys, SDL_Scancode key) {
+    if (key == keys.up) {
+        return INPUT_UP;
+    }
+    if (key == keys.left) {
+        return INPUT_LEFT;
+    }
+    if (key == keys.down) {
+        return INPUT_DOWN;
+    }
+    if (key == keys.right) {
+        return INPUT_RIGHT;
+    }
+    if (key == keys.switchPlayer) {
+        return INPUT_SWITCH;
+    }
+    return 0;
+}
+
+InputLatch::InputLatch() {
+    //Initialize
+    for (int side = 0; side < 2; side++) {
+        keys[side] = DEFAULT_BINDINGS[side];
+        held[side] = 0;
+        pressed[side] = 0;
+    }
+    changed = -1;
+}
+
+void InputLatch::bind(int side, const KeyBindings& sideKeys) {
+    keys[side] = sideKeys;
+    held[side] = 0;
+    pressed[side] = 0;
+}
+
+bool InputLatch::handleEvent(const SDL_Event& e) {
+    if (e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) {
+        return false;
+    }
+
+    bool used = false;
+    for (int side = 0; side < 2; side++) {
+        unsigned char button = buttonFor(keys[side], e.key.keysym.scancode);
+        if (button == 0) {
+            continue;
+        }
+        used = true;
+
+        // Held auto-repeat events change nothing
+        if (e.key.repeat != 0) {
+            continue;
+        }
+        if (e.type == SDL_KEYDOWN) {
+            held[side] |= button;
+            pressed[side] |= button;
+        }
+        else {
+            held[side] &= ~button;
+        }
+        if (changed < 0) {
+            changed = eventTime(e.key.timestamp);
+        }
+    }
+    return used;
+}
+
+InputSnapshot InputLatch::sample() {
+    InputSnapshot snapshot;
+    snapshot.sampled = profileNow();
+    snapshot.changed = changed;
+
+    for (int side = 0; side < 2; side++) {
+        // Switch only acts on the press, the rest while held; a tap shorter
+        // than a frame still counts as held for one step
+        unsigned char moves = held[side] & ~INPUT_SWITCH;
+        snapshot.held.player[side].buttons = moves;
+        snapshot.first.player[side].buttons = moves | pressed[side];
+        pressed[side] = 0;
+    }
+    changed = -1;
+    return snapshot;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdint.h>
+#include "simthread.h"
+
+// Keys that drive one side
+struct KeyBindings
+{
+    SDL_Scancode up;
+    SDL_Scancode left;
+    SDL_Scancode down;
+    SDL_Scancode right;
+
+    // Switches between the outfield player and the goal keeper
+    SDL_Scancode switchPlayer;
+};
+
+// WASD and left shift for side 0, the arrows and right shift for side 1
+const KeyBindings DEFAULT_BINDINGS[2] = {
+    { SDL_SCANCODE_W, SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_LSHIFT },
+    { SDL_SCANCODE_UP, SDL_SCANCODE_LEFT, SDL_SCANCODE_DOWN, SDL_SCANCODE_RIGHT, SDL_SCANCODE_RSHIFT }
+};
+
+//Input latch class
+//Turns key events into per-frame snapshots of both sides' buttons, so game
+//keys are read in one place and a frame can sample them right before stepping
+class InputLatch
+{
+public:
+    //Initializes variables with the default bindings
+    InputLatch();
+
+    //Changes the keys of one side
+    void bind(int side, const KeyBindings& keys);
+
+    //Takes a key event, returns false for keys the game does not use
+    bool handleEvent(const SDL_Event& e);
+
+    //Takes the snapshot of everything since the last one
+    //Poll the event queue right before, so it holds the latest keys
+    InputSnapshot sample();
+
+private:
+    KeyBindings keys[2];
+
+    // Buttons down now, and buttons pressed since the last sample
+    unsigned char held[2];
+    unsigned char pressed[2];
+
+    int64_t changed;
+};
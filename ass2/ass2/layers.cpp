@@ -0,0 +1,128 @@
+#include "layers.h"
+#include <cstdio>
+
+DirtyRegion::DirtyRegion(int width, int height) {
+    //Initialize
+    bounds = { 0, 0, width, height };
+    full = false;
+    rects.reserve(DIRTY_RECTS_RESERVED);
+}
+
+void DirtyRegion::add(const SDL_Rect& rect) {
+    if (full) {
+        return;
+    }
+    SDL_Rect merged;
+    if (!SDL_IntersectRect(&rect, &bounds, &merged)) {
+        return;
+    }
+
+    // Grow the new rectangle over every one it touches until none are left,
+    // so the rectangles never overlap and no pixel is restored twice
+    for (size_t i = 0; i < rects.size();) {
+        if (SDL_HasIntersection(&rects[i], &merged)) {
+            SDL_UnionRect(&rects[i], &merged, &merged);
+            rects[i] = rects.back();
+            rects.pop_back();
+            i = 0;
+        }
+        else {
+            i++;
+        }
+    }
+    rects.push_back(merged);
+
+    // Past half the screen one big copy is cheaper than many small ones
+    if (area() * 2 > bounds.w * bounds.h) {
+        addAll();
+    }
+}
+
+void DirtyRegion::addAll() {
+    full = true;
+    rects.assign(1, bounds);
+}
+
+void DirtyRegion::clear() {
+    full = false;
+    rects.clear();
+}
+
+bool DirtyRegion::isFull() const {
+    return full;
+}
+
+bool DirtyRegion::intersects(const SDL_Rect& rect) const {
+    for (size_t i = 0; i < rects.size(); i++) {
+        if (SDL_HasIntersection(&rects[i], &rect)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<SDL_Rect>& DirtyRegion::getRects() const {
+    return rects;
+}
+
+int DirtyRegion::area() const {
+    int total = 0;
+    for (size_t i = 0; i < rects.size(); i++) {
+        total += rects[i].w * rects[i].h;
+    }
+    return total;
+}
+
+CachedLayer::CachedLayer() {
+    //Initialize
+    texture = NULL;
+    valid = false;
+}
+
+bool CachedLayer::create(SDL_Renderer* renderer, int width, int height) {
+    //Get rid of preexisting texture
+    free();
+
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (texture == NULL) {
+        printf("Unable to create layer texture, drawing without it! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void CachedLayer::free() {
+    //Free texture if it exists
+    if (texture != NULL)
+    {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+    }
+    valid = false;
+}
+
+bool CachedLayer::isCreated() const {
+    return texture != NULL;
+}
+
+bool CachedLayer::isValid() const {
+    return valid;
+}
+
+void CachedLayer::invalidate() {
+    valid = false;
+}
+
+void CachedLayer::beginRedraw(SDL_Renderer* renderer) {
+    SDL_SetRenderTarget(renderer, texture);
+    SDL_RenderClear(renderer);
+}
+
+void CachedLayer::endRedraw(SDL_Renderer* renderer) {
+    SDL_SetRenderTarget(renderer, NULL);
+    valid = true;
+}
+
+void CachedLayer::copy(SDL_Renderer* renderer, const SDL_Rect* rect) const {
+    SDL_RenderCopy(renderer, texture, rect, rect);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <SDL.h>
+#include <vector>
+
+// Rectangles a dirty region has room for before it allocates, enough for
+// every body of the largest match moving
+const int DIRTY_RECTS_RESERVED = 64;
+
+//Dirty region class
+//Collects the parts of the screen that changed since the last frame as a few
+//non-overlapping rectangles
+class DirtyRegion
+{
+public:
+    //Initializes variables for a screen of the given size
+    DirtyRegion(int width, int height);
+
+    //Marks a rectangle as changed, merging it with any it overlaps
+    void add(const SDL_Rect& rect);
+
+    //Marks the whole screen as changed
+    void addAll();
+
+    //Starts a new frame with nothing changed
+    void clear();
+
+    //Whether the whole screen changed
+    bool isFull() const;
+
+    //Whether a rectangle touches a changed part of the screen
+    bool intersects(const SDL_Rect& rect) const;
+
+    //The changed rectangles
+    const std::vector<SDL_Rect>& getRects() const;
+
+    //Pixels covered by the changed rectangles
+    int area() const;
+
+private:
+    SDL_Rect bounds;
+    std::vector<SDL_Rect> rects;
+    bool full;
+};
+
+//Cached layer class
+//A render target texture holding drawing that rarely changes, so it can be
+//copied to the screen instead of drawn again every frame
+class CachedLayer
+{
+public:
+    //Initializes variables
+    CachedLayer();
+
+    //Creates the texture, false if the renderer has no render targets
+    bool create(SDL_Renderer* renderer, int width, int height);
+
+    //Deallocates texture
+    void free();
+
+    //Whether there is a texture to cache into
+    bool isCreated() const;
+
+    //Whether the cached drawing is up to date
+    bool isValid() const;
+
+    //Marks the cached drawing as out of date
+    void invalidate();
+
+    //Sends drawing to the layer until endRedraw
+    void beginRedraw(SDL_Renderer* renderer);
+
+    //Sends drawing back to the screen and marks the layer up to date
+    void endRedraw(SDL_Renderer* renderer);
+
+    //Copies part of the layer to the same place on the screen, all of it for NULL
+    void copy(SDL_Renderer* renderer, const SDL_Rect* rect) const;
+
+private:
+    SDL_Texture* texture;
+    bool valid;
+};
@@ -0,0 +1,351 @@
+// Load generator for the dedicated server: many bot players on one thread
+//
+// Usage: loadbot [--server HOST:PORT] [--players N] [--sockets K] [--seconds S] [--rate HZ]
+// N (200) players share K (16) UDP sockets, join the lobby at HOST:PORT
+// (127.0.0.1:7777), send random buttons HZ (60) times a second and join again
+// whenever their match ends, for S seconds (10). Every state is decoded
+// against the snapshot it was based on. Once a second and at the end it
+// prints the players in a match, the states received and their size, the gaps
+// between a player's states and the round trip from an input leaving to the
+// first state that includes it, which takes up to a tick of the server longer
+// than the network alone.
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "matchserver.h"
+#include "profiler.h"
+#include "rng.h"
+#include "sim.h"
+#include "snapshot.h"
+
+// Hellos are repeated this often until a welcome arrives
+const int JOIN_INTERVAL_MS = 250;
+
+// A match that sends nothing for this long is given up on
+const int STATE_TIMEOUT_MS = 3000;
+
+// Send times kept for working out round trips
+const int SENT_HISTORY = 64;
+
+// Chance in a hundred that a bot changes its buttons on a step
+const int BOT_CHANGE_PERCENT = 10;
+
+enum BotPhase
+{
+    BOT_JOINING,
+    BOT_PLAYING
+};
+
+struct Bot
+{
+    int socket;
+    BotPhase phase;
+
+    // Where the match is played and which side is ours
+    NetAddress worker;
+    uint32_t match;
+    int side;
+
+    // Newest input sent and newest the server said it has, and when each of
+    // the recent ones left
+    uint32_t sequence;
+    uint32_t acked;
+    int64_t sent[SENT_HISTORY];
+
+    // Snapshots decoded, and the newest of them
+    SnapshotHistory received;
+    int decoded;
+
+    int64_t joinStarted;
+    int64_t lastJoin;
+    int64_t lastState;
+
+    Rng rng;
+    unsigned char held;
+};
+
+// Figures gathered between two reports
+struct BotReport
+{
+    long long states;
+    long long stateBytes;
+
+    // States whose baseline was gone or that did not decode
+    long long undecodable;
+    long long welcomes;
+    long long ended;
+    long long timedOut;
+    std::vector<float> roundTripMs;
+    std::vector<float> gapMs;
+    std::vector<float> joinMs;
+};
+
+// Adds what a report counted to a report covering longer
+static void addReport(BotReport& total, const BotReport& report) {
+    total.states += report.states;
+    total.stateBytes += report.stateBytes;
+    total.undecodable += report.undecodable;
+    total.welcomes += report.welcomes;
+    total.ended += report.ended;
+    total.timedOut += report.timedOut;
+    total.roundTripMs.insert(total.roundTripMs.end(), report.roundTripMs.begin(), report.roundTripMs.end());
+    total.gapMs.insert(total.gapMs.end(), report.gapMs.begin(), report.gapMs.end());
+    total.joinMs.insert(total.joinMs.end(), report.joinMs.begin(), report.joinMs.end());
+}
+
+static void printReport(const char* label, BotReport& report, int playing, int players, double seconds) {
+    double tripP50, tripP99, tripMax, gapP50, gapP99, gapMax, joinP50, joinP99, joinMax;
+    percentiles(report.roundTripMs, tripP50, tripP99, tripMax);
+    percentiles(report.gapMs, gapP50, gapP99, gapMax);
+    percentiles(report.joinMs, joinP50, joinP99, joinMax);
+    printf("%s: %d of %d players in a match, %.0f states a second, %lld joined (join p99 %.1f ms), %lld matches ended, %lld timed out\n",
+        label, playing, players, report.states / seconds, report.welcomes, joinP99, report.ended, report.timedOut);
+    printf("%s: round trip p50 %.2f  p99 %.2f  max %.2f ms, gap between states p50 %.2f  p99 %.2f  max %.2f ms\n",
+        label, tripP50, tripP99, tripMax, gapP50, gapP99, gapMax);
+    printf("%s: %.1f bytes of snapshot a state, %lld states not decoded\n",
+        label, report.states > 0 ? (double)report.stateBytes / report.states : 0.0, report.undecodable);
+}
+
+// Holds a direction for a while, then picks another and maybe switches player
+static unsigned char botButtons(Bot& bot) {
+    if (randomRange(bot.rng, 0, 99) < BOT_CHANGE_PERCENT) {
+        bot.held = (unsigned char)randomRange(bot.rng, 0, INPUT_UP | INPUT_DOWN | INPUT_LEFT | INPUT_RIGHT);
+        if (randomRange(bot.rng, 0, 3) == 0) {
+            return bot.held | INPUT_SWITCH;
+        }
+    }
+    return bot.held;
+}
+
+int main(int argc, char* args[]) {
+    const char* serverText = "127.0.0.1:7777";
+    int players = 200;
+    int socketCount = 16;
+    int seconds = 10;
+    int rate = 60;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(args[i], "--server") == 0) {
+            serverText = args[i + 1];
+        }
+        else if (strcmp(args[i], "--players") == 0) {
+            players = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--sockets") == 0) {
+            socketCount = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--seconds") == 0) {
+            seconds = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--rate") == 0) {
+            rate = atoi(args[i + 1]);
+        }
+    }
+    if (players < 1 || socketCount < 1 || rate < 1) {
+        printf("Usage: loadbot [--server HOST:PORT] [--players N] [--sockets K] [--seconds S] [--rate HZ]\n");
+        return -1;
+    }
+    NetAddress lobby;
+    if (!parseAddress(serverText, lobby)) {
+        return -1;
+    }
+
+    // Sockets, the step timer and the epoll set waiting on all of them
+    std::vector<UdpSocket> sockets(socketCount);
+    int epoll = epoll_create1(0);
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (epoll < 0 || timer < 0) {
+        printf("Unable to set up epoll and the timer!\n");
+        return -1;
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    for (int i = 0; i < socketCount; i++) {
+        if (!sockets[i].open(0)) {
+            return -1;
+        }
+        event.data.u32 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, (int)sockets[i].handle(), &event);
+    }
+    event.data.u32 = socketCount;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
+    itimerspec schedule;
+    schedule.it_value.tv_sec = 0;
+    schedule.it_value.tv_nsec = 1000000000 / rate;
+    schedule.it_interval = schedule.it_value;
+    timerfd_settime(timer, 0, &schedule, NULL);
+
+    std::vector<Bot> bots(players);
+    for (int i = 0; i < players; i++) {
+        Bot& bot = bots[i];
+        memset(bot.sent, 0, sizeof(bot.sent));
+        bot.socket = i % socketCount;
+        bot.phase = BOT_JOINING;
+        bot.match = 0;
+        bot.side = 0;
+        bot.sequence = 0;
+        bot.acked = 0;
+        bot.joinStarted = profileNow();
+        bot.lastJoin = 0;
+        bot.lastState = 0;
+        bot.decoded = -1;
+        seedRng(bot.rng, randomSeed(), i);
+        bot.held = 0;
+    }
+
+    std::vector<SendBatch*> batches;
+    for (int i = 0; i < socketCount; i++) {
+        batches.push_back(new SendBatch(256, SERVER_INPUT_SIZE));
+    }
+    ReceiveBatch received(64);
+    Snapshot scratch;
+    unsigned char packet[SERVER_INPUT_SIZE];
+
+    BotReport report = BotReport();
+    BotReport run = BotReport();
+    int64_t start = profileNow();
+    int64_t lastReport = start;
+    int64_t joinInterval = (int64_t)JOIN_INTERVAL_MS * 1000000;
+    int64_t stateTimeout = (int64_t)STATE_TIMEOUT_MS * 1000000;
+    epoll_event events[64];
+    while (profileNow() - start < (int64_t)seconds * 1000000000) {
+        int count = epoll_wait(epoll, events, 64, 100);
+        for (int e = 0; e < count; e++) {
+            int index = (int)events[e].data.u32;
+            if (index == socketCount) {
+                // Step: every bot sends its buttons, or says hello if it has no match
+                uint64_t expirations;
+                if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    continue;
+                }
+                int64_t now = profileNow();
+                for (int i = 0; i < players; i++) {
+                    Bot& bot = bots[i];
+                    if (bot.phase == BOT_PLAYING && now - bot.lastState > stateTimeout) {
+                        bot.phase = BOT_JOINING;
+                        bot.joinStarted = now;
+                        report.timedOut++;
+                    }
+                    if (bot.phase == BOT_JOINING) {
+                        if (now - bot.lastJoin >= joinInterval) {
+                            batches[bot.socket]->add(sockets[bot.socket].handle(), lobby, packet, writeServerJoin(packet, (uint32_t)i));
+                            bot.lastJoin = now;
+                        }
+                        continue;
+                    }
+                    bot.sequence++;
+                    bot.sent[bot.sequence % SENT_HISTORY] = now;
+                    writeServerInput(packet, bot.match, bot.side, bot.sequence, botButtons(bot), bot.decoded);
+                    batches[bot.socket]->add(sockets[bot.socket].handle(), bot.worker, packet, SERVER_INPUT_SIZE);
+                }
+                for (int s = 0; s < socketCount; s++) {
+                    batches[s]->flush(sockets[s].handle());
+                }
+                continue;
+            }
+
+            int packets;
+            while ((packets = received.receive(sockets[index].handle())) > 0) {
+                int64_t now = profileNow();
+                for (int p = 0; p < packets; p++) {
+                    const unsigned char* data = received.data(p);
+                    int size = received.size(p);
+                    ServerWelcome welcome;
+                    ServerState state;
+                    uint32_t token;
+                    if (readServerWelcome(data, size, welcome)) {
+                        if (welcome.token >= (uint32_t)players || bots[welcome.token].phase != BOT_JOINING) {
+                            continue;
+                        }
+                        Bot& bot = bots[welcome.token];
+                        bot.phase = BOT_PLAYING;
+                        bot.worker = received.from(p);
+                        bot.match = welcome.match;
+                        bot.side = welcome.side;
+                        bot.sequence = 0;
+                        bot.acked = 0;
+                        bot.lastState = now;
+                        bot.received.clear();
+                        bot.decoded = -1;
+                        report.welcomes++;
+                        report.joinMs.push_back((float)((now - bot.joinStarted) / 1e6));
+                    }
+                    else if (readServerState(data, size, state)) {
+                        if (state.token >= (uint32_t)players || bots[state.token].phase != BOT_PLAYING) {
+                            continue;
+                        }
+                        Bot& bot = bots[state.token];
+                        int frame, baselineFrame;
+                        const Snapshot* baseline = NULL;
+                        bool decodable = snapshotFrames(state.snapshot, state.snapshotSize, frame, baselineFrame);
+                        if (decodable && baselineFrame >= 0) {
+                            baseline = bot.received.find(baselineFrame);
+                            decodable = baseline != NULL;
+                        }
+                        if (!decodable || !decodeSnapshot(state.snapshot, state.snapshotSize, baseline, scratch)) {
+                            report.undecodable++;
+                            continue;
+                        }
+                        bot.received.add(frame) = scratch;
+                        if (frame > bot.decoded) {
+                            bot.decoded = frame;
+                        }
+                        report.states++;
+                        report.stateBytes += state.snapshotSize;
+                        report.gapMs.push_back((float)((now - bot.lastState) / 1e6));
+                        bot.lastState = now;
+                        if ((int32_t)(state.ack - bot.acked) > 0 && bot.sequence - state.ack < (uint32_t)SENT_HISTORY) {
+                            report.roundTripMs.push_back((float)((now - bot.sent[state.ack % SENT_HISTORY]) / 1e6));
+                            bot.acked = state.ack;
+                        }
+                    }
+                    else if (readServerEnd(data, size, token)) {
+                        if (token >= (uint32_t)players || bots[token].phase != BOT_PLAYING) {
+                            continue;
+                        }
+                        bots[token].phase = BOT_JOINING;
+                        bots[token].joinStarted = now;
+                        bots[token].lastJoin = 0;
+                        report.ended++;
+                    }
+                }
+            }
+        }
+
+        int64_t now = profileNow();
+        if (now - lastReport >= 1000000000LL) {
+            int playing = 0;
+            for (int i = 0; i < players; i++) {
+                playing += bots[i].phase == BOT_PLAYING ? 1 : 0;
+            }
+            char label[32];
+            snprintf(label, sizeof(label), "%4.0f s", (now - start) / 1e9);
+            printReport(label, report, playing, players, (now - lastReport) / 1e9);
+
+            addReport(run, report);
+            report = BotReport();
+            lastReport = now;
+        }
+    }
+
+    int playing = 0;
+    long long dropped = 0;
+    for (int i = 0; i < players; i++) {
+        playing += bots[i].phase == BOT_PLAYING ? 1 : 0;
+    }
+    for (int s = 0; s < socketCount; s++) {
+        dropped += batches[s]->getDropped();
+        delete batches[s];
+    }
+    addReport(run, report);
+    printReport("run", run, playing, players, (profileNow() - start) / 1e9);
+    printf("%lld packets dropped for want of socket buffer\n", dropped);
+    close(timer);
+    close(epoll);
+    return run.states > 0 ? 0 : -1;
+}
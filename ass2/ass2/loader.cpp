@@ -0,0 +1,217 @@
+#include "loader.h"
+#include <SDL_image.h>
+#include <cstdio>
+#include "profiler.h"
+
+AssetLoader::AssetLoader(int threads) : pool(threads) {
+    //Initialize
+    created = profileNow();
+}
+
+AssetLoader::~AssetLoader() {
+    pool.wait();
+    for (size_t i = 0; i < assets.size(); i++) {
+        if (assets[i].surface != NULL) {
+            SDL_FreeSurface(assets[i].surface);
+        }
+        if (assets[i].texture != NULL) {
+            SDL_DestroyTexture(assets[i].texture);
+        }
+    }
+}
+
+AssetHandle AssetLoader::loadImage(const char* path, bool upload) {
+    std::string file = path;
+    DecodeJob job = [file]() {
+        SDL_Surface* surface = IMG_Load(file.c_str());
+        if (surface == NULL) {
+            printf("Unable to load image %s! SDL_image Error: %s\n", file.c_str(), IMG_GetError());
+        }
+        return surface;
+    };
+    return submit(path, job, std::vector<AssetHandle>(), upload);
+}
+
+AssetHandle AssetLoader::submit(const char* name, DecodeJob job, const std::vector<AssetHandle>& dependencies, bool upload) {
+    AssetHandle handle;
+    bool ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Asset asset;
+        asset.name = name;
+        asset.job = job;
+        asset.upload = upload;
+        asset.state = ASSET_LOADING;
+        asset.surface = NULL;
+        asset.texture = NULL;
+        asset.waitingOn = 0;
+        asset.submitted = profileNow();
+        asset.started = asset.decoded = asset.uploaded = 0;
+
+        handle = (AssetHandle)assets.size();
+        bool failed = false;
+        for (size_t i = 0; i < dependencies.size(); i++) {
+            Asset& dependency = assets[dependencies[i]];
+            if (dependency.state == ASSET_LOADING) {
+                dependency.dependents.push_back(handle);
+                asset.waitingOn++;
+            }
+            else if (dependency.state == ASSET_FAILED) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            asset.state = ASSET_FAILED;
+        }
+        ready = !failed && asset.waitingOn == 0;
+        assets.push_back(asset);
+    }
+
+    if (ready) {
+        start(handle);
+    }
+    return handle;
+}
+
+void AssetLoader::start(AssetHandle handle) {
+    pool.submit([this, handle](int) {
+        decode(handle);
+    });
+}
+
+void AssetLoader::decode(AssetHandle handle) {
+    DecodeJob job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        assets[handle].started = profileNow();
+        job = assets[handle].job;
+    }
+
+    SDL_Surface* surface = job();
+
+    std::vector<AssetHandle> unblocked;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Asset& asset = assets[handle];
+        asset.decoded = profileNow();
+        asset.job = DecodeJob();
+        asset.surface = surface;
+        asset.state = surface != NULL ? ASSET_DECODED : ASSET_FAILED;
+        if (surface != NULL && asset.upload) {
+            uploads.push_back(handle);
+        }
+
+        // A failure fails everything built from this asset
+        std::vector<AssetHandle> dependents;
+        dependents.swap(asset.dependents);
+        while (!dependents.empty()) {
+            Asset& dependent = assets[dependents.back()];
+            AssetHandle current = dependents.back();
+            dependents.pop_back();
+            if (dependent.state != ASSET_LOADING) {
+                continue;
+            }
+            if (surface == NULL) {
+                dependent.state = ASSET_FAILED;
+                dependents.insert(dependents.end(), dependent.dependents.begin(), dependent.dependents.end());
+                dependent.dependents.clear();
+            }
+            else if (--dependent.waitingOn == 0) {
+                unblocked.push_back(current);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < unblocked.size(); i++) {
+        start(unblocked[i]);
+    }
+}
+
+int AssetLoader::pump(SDL_Renderer* renderer) {
+    std::vector<AssetHandle> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(uploads);
+    }
+
+    // Textures are created outside the lock, nothing else touches these
+    // assets until they are marked ready
+    for (size_t i = 0; i < ready.size(); i++) {
+        SDL_Surface* surface;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            surface = assets[ready[i]].surface;
+            assets[ready[i]].surface = NULL;
+        }
+
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (texture == NULL) {
+            printf("Unable to create texture! SDL Error: %s\n", SDL_GetError());
+        }
+        SDL_FreeSurface(surface);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Asset& asset = assets[ready[i]];
+        asset.texture = texture;
+        asset.uploaded = profileNow();
+        asset.state = texture != NULL ? ASSET_READY : ASSET_FAILED;
+    }
+    return (int)ready.size();
+}
+
+bool AssetLoader::wait(SDL_Renderer* renderer, AssetHandle handle) {
+    for (;;) {
+        pump(renderer);
+        AssetState current = state(handle);
+        if (current == ASSET_READY) {
+            return true;
+        }
+        if (current == ASSET_FAILED) {
+            return false;
+        }
+        SDL_Delay(1);
+    }
+}
+
+AssetState AssetLoader::state(AssetHandle handle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return assets[handle].state;
+}
+
+SDL_Surface* AssetLoader::takeSurface(AssetHandle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SDL_Surface* surface = assets[handle].surface;
+    assets[handle].surface = NULL;
+    return surface;
+}
+
+SDL_Texture* AssetLoader::takeTexture(AssetHandle handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SDL_Texture* texture = assets[handle].texture;
+    assets[handle].texture = NULL;
+    return texture;
+}
+
+void AssetLoader::progress(int& finished, int& total) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = 0;
+    total = (int)assets.size();
+    for (size_t i = 0; i < assets.size(); i++) {
+        const Asset& asset = assets[i];
+        // Assets that are never uploaded are done once decoded
+        if (asset.state == ASSET_READY || asset.state == ASSET_FAILED || (asset.state == ASSET_DECODED && !asset.upload)) {
+            finished++;
+        }
+    }
+}
+
+void AssetLoader::printMetrics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    printf("%-28s %9s %9s %9s %9s\n", "asset (ms from loader start)", "queued", "decoding", "decoded", "uploaded");
+    for (size_t i = 0; i < assets.size(); i++) {
+        const Asset& asset = assets[i];
+        double uploaded = asset.uploaded > 0 ? (asset.uploaded - created) / 1e6 : -1;
+        printf("%-28s %9.1f %9.1f %9.1f %9.1f\n", asset.name.c_str(), (asset.submitted - created) / 1e6,
+            asset.started > 0 ? (asset.started - created) / 1e6 : -1, asset.decoded > 0 ? (asset.decoded - created) / 1e6 : -1, uploaded);
+    }
+}
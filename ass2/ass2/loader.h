@@ -0,0 +1,101 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "threadpool.h"
+
+// Handle to an asset the loader produces
+typedef int AssetHandle;
+
+enum AssetState
+{
+    ASSET_LOADING,
+    ASSET_DECODED,
+    ASSET_READY,
+    ASSET_FAILED
+};
+
+// Work run on a worker thread that produces a surface, NULL on failure
+typedef std::function<SDL_Surface*()> DecodeJob;
+
+//Asset loader class
+//Decodes assets into surfaces on worker threads and hands them to the main
+//thread through a queue, where pump turns them into textures
+class AssetLoader
+{
+public:
+    //Starts the workers, 0 uses one per core
+    explicit AssetLoader(int threads);
+
+    //Waits for the workers and frees whatever was not taken
+    ~AssetLoader();
+
+    //Decodes an image file on a worker
+    //With upload set, pump creates a texture of it; otherwise the surface is
+    //kept for jobs that depend on it
+    AssetHandle loadImage(const char* path, bool upload);
+
+    //Runs a job on a worker once every dependency has decoded
+    AssetHandle submit(const char* name, DecodeJob job, const std::vector<AssetHandle>& dependencies, bool upload);
+
+    //Creates textures for the surfaces decoded since the last call
+    //Main thread only; returns how many textures were created
+    int pump(SDL_Renderer* renderer);
+
+    //Pumps until the asset is ready or has failed, true if ready
+    bool wait(SDL_Renderer* renderer, AssetHandle handle);
+
+    AssetState state(AssetHandle handle) const;
+
+    //Takes the decoded surface of an asset that is not uploaded
+    //Safe from jobs that depend on the asset
+    SDL_Surface* takeSurface(AssetHandle handle);
+
+    //Takes the texture of an uploaded asset
+    SDL_Texture* takeTexture(AssetHandle handle);
+
+    //Assets that are ready or have failed, out of all submitted
+    void progress(int& finished, int& total) const;
+
+    //Prints when each asset was decoded and uploaded
+    void printMetrics() const;
+
+private:
+    struct Asset
+    {
+        std::string name;
+        DecodeJob job;
+        bool upload;
+        AssetState state;
+        SDL_Surface* surface;
+        SDL_Texture* texture;
+
+        // Dependencies still decoding and assets waiting on this one
+        int waitingOn;
+        std::vector<AssetHandle> dependents;
+
+        // Nanoseconds on the profiler clock
+        int64_t submitted;
+        int64_t started;
+        int64_t decoded;
+        int64_t uploaded;
+    };
+
+    void start(AssetHandle handle);
+    void decode(AssetHandle handle);
+
+    mutable std::mutex mutex;
+    std::vector<Asset> assets;
+
+    // Decoded assets waiting for pump
+    std::vector<AssetHandle> uploads;
+
+    int64_t created;
+
+    // Declared last so the workers stop before the state they use goes away
+    ThreadPool pool;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// Lock-free hand-off between exactly two threads
+// Neither side ever waits for the other, so a stalled reader cannot hold up
+// the writer and the other way round
+
+//Triple buffer class
+//One thread writes whole values, another always reads the newest complete
+//one. The writer fills its own slot and swaps it with the shared middle slot;
+//the reader swaps its slot with the middle one only when that holds something
+//newer. Values are reused, so their storage is allocated once.
+template <typename T>
+class TripleBuffer
+{
+public:
+    //Initializes variables
+    TripleBuffer() : middle(1) {
+        back = 2;
+        front = 0;
+    }
+
+    //Slot the writer fills, only the writing thread may touch it
+    T& writeSlot() {
+        return slots[back];
+    }
+
+    //Makes the written slot the newest value and hands the writer another
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    //Moves the reader to the newest value, returns false if there is none since the last call
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    //Value the reader is on, only the reading thread may touch it
+    const T& readSlot() const {
+        return slots[front];
+    }
+
+    //Copies a value into every slot, so their storage is allocated up front
+    //Only before the buffer is shared between threads
+    void fill(const T& value) {
+        for (int i = 0; i < 3; i++) {
+            slots[i] = value;
+        }
+    }
+
+private:
+    // The middle slot index and whether the writer published it since the reader last took it
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    T slots[3];
+
+    // Padded so the reader's and the writer's slot indices never share a cache line
+    char padding1[64];
+    std::atomic<int> middle;
+    char padding2[64];
+    int back;
+    char padding3[64];
+    int front;
+};
+
+//Single producer single consumer queue class
+//A fixed ring of items, one thread pushes and another pops
+template <typename T>
+class SpscQueue
+{
+public:
+    //Initializes variables, capacity is rounded up to a power of two
+    explicit SpscQueue(int capacity) : head(0), tail(0) {
+        int size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    //Adds an item, false if the queue is full; producer only
+    bool push(const T& item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) > (size_t)mask) {
+            return false;
+        }
+        items[position & mask] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Takes the oldest item, false if the queue is empty; consumer only
+    bool pop(T& item) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Whether a push would fail; only exact for the producer
+    bool full() const {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) > (size_t)mask;
+    }
+
+private:
+    std::vector<T> items;
+    size_t mask;
+
+    // Consumer and producer positions, counting every item ever popped and pushed
+    char padding1[64];
+    std::atomic<size_t> head;
+    char padding2[64];
+    std::atomic<size_t> tail;
+    char padding3[64];
+};
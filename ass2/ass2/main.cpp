@@ -4,35 +4,45 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <random>
-#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include "alloctrack.h"
+#include "arena.h"
+#include "assetpack.h"
+#include "clock.h"
+#include "input.h"
+#include "layers.h"
+#include "loader.h"
+#include "media.h"
+#include "planner.h"
+#include "profiler.h"
+#include "recording.h"
+#include "rollback.h"
+#include "sdlalloc.h"
+#include "sim.h"
+#include "simthread.h"
 
 // Constants
-const int SCREEN_WIDTH = 1280;
-const int SCREEN_HEIGHT = 960;
 const int FPS = 60;
-const int FRAME_DELAY = 1000 / FPS;
-const int P = 22;
-const int B = 7;
-const int LEFT = 140;
-const int RIGHT = 1140;
-const int TOP = 105;
-const int BOTTOM = 855;
-const int GTOP = 330;
-const int GBOTTOM = 630;
-const int GKLEFT = 490;
-const int GKRIGHT = 790;
+
+// Most simulation steps run in a row when catching up after a stall
+const int MAX_STEPS_PER_FRAME = 5;
+
+// Waits for the other player of an online match
+const int HOST_TIMEOUT_MS = 60000;
+const int JOIN_TIMEOUT_MS = 10000;
+
+// Frame time histogram of the profiler overlay
+const int HUD_BUCKETS = 40;
+const double HUD_BUCKET_MS = 1.0;
+const int HUD_BAR_HEIGHT = 60;
 
 // Global variables
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
 
-int random(int range_from, int range_to) {
-    std::random_device                  rand_dev;
-    std::mt19937                        generator(rand_dev());
-    std::uniform_int_distribution<int>    distr(range_from, range_to);
-    return distr(generator);
-}
+// Display refreshes a second when present waits for vsync, 0 otherwise
+int refreshRate = 0;
 
 //Texture wrapper class
 class TextureWrapper
@@ -44,10 +54,6 @@ public:
         texture = NULL;
         width = 0;
         height = 0;
-        x = 0;
-        y = 0;
-        vx = 0;
-        vy = 0;
     }
 
     //Loads image at specified path
@@ -75,6 +81,35 @@ public:
         return texture != NULL;
     }
 
+    //Uses a texture created elsewhere
+    void adopt(SDL_Texture* newTexture) {
+        //Get rid of preexisting texture
+        free();
+
+        texture = newTexture;
+        if (texture != NULL)
+        {
+            SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+        }
+    }
+
+    //Creates the texture from pixels already in memory
+    bool loadFromPixels(Uint32 format, int w, int h, int pitch, const void* pixels) {
+        //Get rid of preexisting texture
+        free();
+
+        texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, w, h);
+        if (texture == NULL || SDL_UpdateTexture(texture, NULL, pixels, pitch) != 0)
+        {
+            printf("Unable to create texture from pixels! SDL Error: %s\n", SDL_GetError());
+            free();
+            return false;
+        }
+        width = w;
+        height = h;
+        return true;
+    }
+
     //Deallocates texture
     void free() {
         //Free texture if it exists
@@ -87,17 +122,6 @@ public:
         }
     }
 
-    //Renders texture at given point
-    void render() {
-        //Set rendering space and render to screen
-        SDL_Rect renderQuad = { x - width / 2, y - height / 2, width, height };
-        int result = SDL_RenderCopy(renderer, texture, NULL, &renderQuad);
-        if (result != 0)
-        {
-            printf("Unable to render texture! SDL Error: %s\n", SDL_GetError());
-        }
-    }
-
     //Renders texture full screen
     void renderFull() {
 		SDL_RenderCopy(renderer, texture, NULL, NULL);
@@ -110,30 +134,56 @@ public:
     //Image dimensions
     int width;
     int height;
-    int x;
-    int y;
-    int vx;
-    int vy;
 };
 
 // Global variables
 TextureWrapper bgTexture;
-TextureWrapper player1Texture;
-TextureWrapper player1GKTexture;
-TextureWrapper player2Texture;
-TextureWrapper player2GKTexture;
-TextureWrapper ballTexture;
-int score1 = 0, score2 = 0;
-bool win1 = false, win2 = false;
-int frame = 0;
-
-bool isColliding(TextureWrapper obj1, TextureWrapper obj2) {
-	// Use circle collision detection
-	int dx = obj1.x - obj2.x;
-	int dy = obj1.y - obj2.y;
-	int distance = sqrt(dx * dx + dy * dy);
-	return distance < obj1.width / 2 + obj2.width / 2;
-}
+
+// Reset at the start of every frame
+FrameArena frameArena(FRAME_ARENA_BYTES);
+
+// Players, ball and glyphs share one texture and are drawn in one batch
+SpriteAtlas spriteAtlas;
+SpriteBatch spriteBatch;
+Font font;
+
+GameSprites sprites;
+
+// Loose files still being decoded in the background, NULL when everything is in place
+AssetLoader* loader = NULL;
+AssetHandle backgroundAsset;
+AssetHandle atlasAsset;
+
+// Whether the sprite atlas, and with it the font, can be drawn
+bool atlasReady = false;
+
+// Pitch, scores, players and ball
+MatchView matchView(SCREEN_WIDTH, SCREEN_HEIGHT);
+
+// Whether the screen keeps the last frame after presenting, as with the
+// software renderer, so only changed areas need drawing
+bool keepsFrame = false;
+
+// Performance counter when the game started, for startup timings
+Uint64 launched = 0;
+
+// Stepped on the simulation thread while a match is on, drawn from its snapshots
+MatchState match;
+
+// Durations of the last frames, shown by the profiler overlay (F3)
+FrameTimes frameTimes;
+bool showProfiler = false;
+
+// Game keys, sampled once a frame and sent to the simulation thread
+InputLatch input;
+
+// Milliseconds from a key change, and from when the step shown was due,
+// until present returned with the frame showing it
+FrameTimes inputLatency;
+FrameTimes stepLatency;
+
+// Time the late latch slept last frame
+double lastLatchWait = 0;
 
 bool init() {
     // Initialize SDL
@@ -164,74 +214,182 @@ bool init() {
         return false;
     }
 
-    // Create renderer
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // Create renderer, in software when there is no GPU
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (renderer == NULL) {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
     if (renderer == NULL) {
         std::cout << "Renderer could not be created! SDL Error: " << SDL_GetError() << std::endl;
         return false;
     }
 
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        keepsFrame = (info.flags & SDL_RENDERER_SOFTWARE) != 0;
+        printf("Renderer %s%s\n", info.name, keepsFrame ? ", redrawing changed areas only" : "");
+
+        // Input can only be read late against a known refresh
+        SDL_DisplayMode displayMode;
+        if ((info.flags & SDL_RENDERER_PRESENTVSYNC) != 0 && SDL_GetWindowDisplayMode(window, &displayMode) == 0) {
+            refreshRate = displayMode.refresh_rate;
+        }
+    }
+
     // Initialize renderer color
     SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
 
     return true;
 }
 
-bool loadMedia()
+// Milliseconds since the game started
+double sinceLaunch() {
+    return (SDL_GetPerformanceCounter() - launched) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Starts decoding the loose files under assets/ on worker threads
+void startLooseMedia()
 {
-    // Loading success flag
-    bool success = true;
+    loader = new AssetLoader(0);
+    backgroundAsset = loader->loadImage(BACKGROUND_FILE, true);
 
-    // Load background texture
-    if (!bgTexture.loadFromFile("assets/img/bg.png"))
-    {
-        printf("Failed to load background texture image!\n");
-        success = false;
+    std::vector<AssetHandle> spriteAssets;
+    for (int i = 0; i < SPRITE_FILE_COUNT; i++) {
+        spriteAssets.push_back(loader->loadImage(SPRITE_FILES[i], false));
     }
 
-    // Load player texture
-    if (!player1Texture.loadFromFile("assets/img/player1.png"))
-    {
-		printf("Failed to load player1 texture image!\n");
-		success = false;
-	}
-    if (!player1GKTexture.loadFromFile("assets/img/player1GK.png"))
-    {
-		printf("Failed to load player1GK texture image!\n");
-		success = false;
-	}
+    // Glyphs are rasterized and packed with the sprites once those are decoded,
+    // while the background is still decoding; the main thread leaves the atlas
+    // and font alone until the atlas is ready
+    AssetLoader* owner = loader;
+    atlasAsset = loader->submit("atlas", [owner, spriteAssets]() -> SDL_Surface* {
+        SDL_Surface* decoded[SPRITE_FILE_COUNT];
+        for (int i = 0; i < SPRITE_FILE_COUNT; i++) {
+            decoded[i] = owner->takeSurface(spriteAssets[i]);
+        }
+        if (!addGameSprites(spriteAtlas, font, sprites, decoded)) {
+            return NULL;
+        }
+        return spriteAtlas.compose();
+    }, spriteAssets, true);
+}
+
+// Uploads whatever finished decoding, returns false if loading failed
+bool updateMedia()
+{
+    if (loader == NULL) {
+        return true;
+    }
+    loader->pump(renderer);
+
+    AssetState atlasState = loader->state(atlasAsset);
+    if (!atlasReady && atlasState == ASSET_READY) {
+        spriteAtlas.adopt(loader->takeTexture(atlasAsset));
+        atlasReady = true;
+        printf("Text ready after %.1f ms\n", sinceLaunch());
+    }
+    return atlasState != ASSET_FAILED && loader->state(backgroundAsset) != ASSET_FAILED;
+}
+
+// Waits for the rest of the loose files, returns false if any failed
+bool finishMedia()
+{
+    if (loader == NULL) {
+        return true;
+    }
+    bool success = loader->wait(renderer, backgroundAsset) && loader->wait(renderer, atlasAsset) && updateMedia();
+    if (success) {
+        bgTexture.adopt(loader->takeTexture(backgroundAsset));
+        printf("Loaded media from loose files after %.1f ms\n", sinceLaunch());
+    }
+    loader->printMetrics();
 
-    if (!player2Texture.loadFromFile("assets/img/player2.png"))
+    delete loader;
+    loader = NULL;
+    return success;
+}
+
+// Whether a sprite id refers to one of count sprites, -1 meaning none
+static bool validSprite(int sprite, int count) {
+    return sprite >= -1 && sprite < count;
+}
+
+// Uploads the background and sprite atlas straight from a mapped asset pack
+bool loadPackedMedia(const AssetPack& pack)
+{
+    const PackEntry* background = pack.find(PACK_BACKGROUND, PACK_IMAGE);
+    const PackEntry* atlas = pack.find(PACK_ATLAS, PACK_IMAGE);
+    const PackEntry* rects = pack.find(PACK_ATLAS_RECTS, PACK_BLOB);
+    const FontMetrics* metrics = (const FontMetrics*)pack.findBlob(PACK_FONT, sizeof(FontMetrics));
+    const GameSprites* packedSprites = (const GameSprites*)pack.findBlob(PACK_SPRITES, sizeof(GameSprites));
+    if (background == NULL || atlas == NULL || rects == NULL || rects->size % sizeof(SDL_Rect) != 0 || metrics == NULL || packedSprites == NULL)
     {
-		printf("Failed to load player2 texture image!\n");
-		success = false;
-	}
+        printf("Asset pack is missing entries!\n");
+        return false;
+    }
 
-    if (!player2GKTexture.loadFromFile("assets/img/player2GK.png"))
+    // Every sprite id has to point into the atlas
+    int spriteCount = (int)(rects->size / sizeof(SDL_Rect));
+    bool valid = validSprite(packedSprites->ball, spriteCount);
+    for (int side = 0; side < 2; side++) {
+        for (int role = 0; role < 2; role++) {
+            valid = valid && validSprite(packedSprites->player[side][role], spriteCount);
+        }
+    }
+    for (int face = 0; face < FONT_FACES; face++) {
+        for (int i = 0; i < GLYPH_COUNT; i++) {
+            valid = valid && validSprite(metrics->sprites[face][i], spriteCount);
+        }
+    }
+    if (!valid)
     {
-		printf("Failed to load playerGK texture image!\n");
-		success = false;
-	}
+        printf("Asset pack refers to sprites it does not have!\n");
+        return false;
+    }
 
-    // Load ball texture
-    if (!ballTexture.loadFromFile("assets/img/ball.png"))
+    if (!bgTexture.loadFromPixels(background->format, background->width, background->height, background->pitch, pack.data(*background)))
     {
-        printf("Failed to load ball texture image!\n");
-        success = false;
+        printf("Failed to upload background texture!\n");
+        return false;
+    }
+    if (!spriteAtlas.loadPacked(renderer, atlas->format, pack.data(*atlas), atlas->width, atlas->height, atlas->pitch,
+        (const SDL_Rect*)pack.data(*rects), spriteCount))
+    {
+        printf("Failed to upload sprite atlas!\n");
+        return false;
     }
+    font.setMetrics(*metrics);
+    sprites = *packedSprites;
+    return true;
+}
 
-	return success;
+// Loads the assets from the pack when there is a valid one; otherwise starts
+// decoding the loose files in the background
+void startMedia(const char* packPath)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    AssetPack pack;
+    bool packed = packPath != NULL && pack.open(packPath) && loadPackedMedia(pack);
+    pack.close();
+    if (!packed) {
+        startLooseMedia();
+        return;
+    }
+
+    atlasReady = true;
+    double milliseconds = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    printf("Loaded media from %s in %.1f ms\n", packPath, milliseconds);
 }
 
 void close()
 {
-    //Free loaded images
+    //Stop loading and free loaded images
+    delete loader;
+    loader = NULL;
+    matchView.free();
     bgTexture.free();
-    player1Texture.free();
-    player1GKTexture.free();
-    player2Texture.free();
-    player2GKTexture.free();
-    ballTexture.free();
+    spriteAtlas.free();
 
     //Destroy window	
     SDL_DestroyRenderer(renderer);
@@ -240,30 +398,20 @@ void close()
     window = NULL;
 
     //Quit SDL subsystems
+    TTF_Quit();
     IMG_Quit();
     SDL_Quit();
 }
 
+// Asks for 1P or 2P mode while the assets finish loading
+// Returns 0 if loading failed
 int showStartScreen() {
     bool done = false;
     int mode = 1; // 1 for 1P, 2 for 2P
     SDL_Event e;
+    bool firstFrame = true;
 
-    TTF_Font* font = TTF_OpenFont("assets/font/font.ttf", 32); // Load your font
-    SDL_Color textColor = { 255, 255, 255, 255 }; // White color
-
-    if (!font) {
-        std::cerr << "Failed to load font: " << TTF_GetError() << std::endl;
-        return -1;
-    }
-
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, "Press 1 for 1P mode, Press 2 for 2P mode", textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
-
-    SDL_Rect textRect = { (SCREEN_WIDTH - textWidth) / 2, (SCREEN_HEIGHT - textHeight) / 2, textWidth, textHeight };
+    const char* prompt = "Press 1 for 1P mode, Press 2 for 2P mode";
 
     while (!done) {
         while (SDL_PollEvent(&e) != 0) {
@@ -284,525 +432,261 @@ int showStartScreen() {
             }
         }
 
+        if (!updateMedia()) {
+            return 0;
+        }
+
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
 
-        // Render text
-        SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
+        if (atlasReady) {
+            // Render text
+            int textWidth = font.measure(FONT_SMALL, prompt);
+            int textHeight = font.lineHeight(FONT_SMALL);
+            spriteBatch.begin(&spriteAtlas);
+            font.render(spriteBatch, FONT_SMALL, prompt, (SCREEN_WIDTH - textWidth) / 2, (SCREEN_HEIGHT - textHeight) / 2);
+            spriteBatch.flush(renderer);
+        }
+        else {
+            // Loading bar until there is a font to draw with
+            int finished = 0, total = 1;
+            loader->progress(finished, total);
+            SDL_Rect outline = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 2 - 10, SCREEN_WIDTH / 2, 20 };
+            SDL_Rect bar = { outline.x, outline.y, outline.w * finished / (total > 0 ? total : 1), outline.h };
+            SDL_SetRenderDrawColor(renderer, 60, 60, 60, 255);
+            SDL_RenderFillRect(renderer, &outline);
+            SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+            SDL_RenderFillRect(renderer, &bar);
+        }
 
         SDL_RenderPresent(renderer);
+        if (firstFrame) {
+            printf("Start screen shown after %.1f ms\n", sinceLaunch());
+            firstFrame = false;
+        }
     }
 
-    SDL_DestroyTexture(textTexture);
-    TTF_CloseFont(font);
-
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     return mode;
 }
 
-void reset() {
-    // Reset player positions
-    player1Texture.x = 400;
-    player1Texture.y = 480;
-
-    player1GKTexture.x = 200;
-    player1GKTexture.y = 480;
-
-    player2Texture.x = 880;
-    player2Texture.y = 480;
-
-    player2GKTexture.x = 1080;
-    player2GKTexture.y = 480;
-
-    // Reset ball position
-    ballTexture.x = 640;
-    ballTexture.y = random(410, 550);
-
-    // Reset ball velocity
-    ballTexture.vx = 0;
-    ballTexture.vy = 0;
-
-    // Render background
-    bgTexture.renderFull();
-
-    // Render players and ball
-    player1Texture.render();
-    player1GKTexture.render();
-
-    player2Texture.render();
-    player2GKTexture.render();
-
-    ballTexture.render();
-
-    // Render scores
-    TTF_Font* font = TTF_OpenFont("assets/font/font.ttf", 64); // Load your font
-    SDL_Color textColor = { 255, 255, 255, 255 }; // White color
-
-    if (!font) {
-		std::cerr << "Failed to load font: " << TTF_GetError() << std::endl;
-		return;
-	}
-
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, std::to_string(score1).c_str(), textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
-
-    SDL_Rect textRect = { 500, 30, textWidth, textHeight };
-    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-
-    textSurface = TTF_RenderText_Solid(font, std::to_string(score2).c_str(), textColor);
-    textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    textWidth = textSurface->w;
-    textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
-
-    textRect = { 740, 30, textWidth, textHeight };
-    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-
-    // Update screen
-    SDL_RenderPresent(renderer);
-}
-
-void handleInput1P(int selectedPlayer1) {
-    const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
-    // Handle player
-    if (selectedPlayer1 == 1) {
-        if (currentKeyStates[SDL_SCANCODE_W]) {
-            player1Texture.vy = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_A]) {
-            player1Texture.vx = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_S]) {
-            player1Texture.vy = +4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_D]) {
-            player1Texture.vx = +4;
-        }
-    }
-    else {
-        if (currentKeyStates[SDL_SCANCODE_W]) {
-            player1GKTexture.vy = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_A]) {
-            player1GKTexture.vx = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_S]) {
-            player1GKTexture.vy = +4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_D]) {
-            player1GKTexture.vx = +4;
-        }
-    }
-
-    // Handle AI
-    // handle first player
-    if (ballTexture.y < player2Texture.y) {
-		player2Texture.vy = -4;
-	}
-    else if (ballTexture.y > player2Texture.y) {
-		player2Texture.vy = +4;
-	}
-    if (ballTexture.x < player2Texture.x) {
-        player2Texture.vx = -4;
-    }
-    else if (ballTexture.x > player2Texture.x) {
-		player2Texture.vx = +4;
-	}
-    
-    // handle goal keeper
-    if (ballTexture.y < player2GKTexture.y) {
-        player2GKTexture.vy = -4;
-	}
-    else if (ballTexture.y > player2GKTexture.y) {
-        player2GKTexture.vy = +4;
+// Screen area the profiler overlay covers
+SDL_Rect profilerPanel() {
+    int width = font.measure(FONT_SMALL, "p50 00.00  p99 00.00  max 000.00 ms");
+    if (width < HUD_BUCKETS * 8) {
+        width = HUD_BUCKETS * 8;
     }
+    SDL_Rect panel = { 10, 10, width + 20, font.lineHeight(FONT_SMALL) * 3 + HUD_BAR_HEIGHT + 30 };
+    return panel;
 }
 
-void handleInput2P(int selectedPlayer1, int selectedPlayer2) {
-    const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
-    // Handle player 1
-    if (selectedPlayer1 == 1) {
-        if (currentKeyStates[SDL_SCANCODE_W]) {
-			player1Texture.vy = -4;
-		}
-        if (currentKeyStates[SDL_SCANCODE_A]) {
-			player1Texture.vx = -4;
-		}
-        if (currentKeyStates[SDL_SCANCODE_S]) {
-			player1Texture.vy = +4;
-		}
-        if (currentKeyStates[SDL_SCANCODE_D]) {
-			player1Texture.vx = +4;
-		}
-	}
-    else {
-        if (currentKeyStates[SDL_SCANCODE_W]) {
-			player1GKTexture.vy = -4;
-		}
-        if (currentKeyStates[SDL_SCANCODE_A]) {
-			player1GKTexture.vx = -4;
-		}
-        if (currentKeyStates[SDL_SCANCODE_S]) {
-			player1GKTexture.vy = +4;
-		}
-        if (currentKeyStates[SDL_SCANCODE_D]) {
-			player1GKTexture.vx = +4;
-		}
-	}
+// Draws frame time percentiles and a histogram of recent frame times
+void renderProfiler() {
+    double p50, p99, max;
+    frameTimes.summary(p50, p99, max);
+    int buckets[HUD_BUCKETS];
+    frameTimes.histogram(buckets, HUD_BUCKETS, HUD_BUCKET_MS);
+    int most = 1;
+    for (int b = 0; b < HUD_BUCKETS; b++) {
+        if (buckets[b] > most) {
+            most = buckets[b];
+        }
+    }
+
+    char times[96];
+    snprintf(times, sizeof(times), "p50 %.2f  p99 %.2f  max %.2f ms", p50, p99, max);
+    char fill[64];
+    snprintf(fill, sizeof(fill), "fill %.1f%% of the screen", 100.0 * matchView.getFill() / (SCREEN_WIDTH * SCREEN_HEIGHT));
+    double inputP50, inputP99, inputMax;
+    inputLatency.summary(inputP50, inputP99, inputMax);
+    char latency[96];
+    snprintf(latency, sizeof(latency), "input p50 %.1f  p99 %.1f ms  latch %.1f ms", inputP50, inputP99, lastLatchWait);
+    int textHeight = font.lineHeight(FONT_SMALL);
+
+    // Translucent panel
+    SDL_Rect panel = profilerPanel();
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(renderer, &panel);
+
+    // One bar per millisecond, the last one holds every longer frame
+    int base = panel.y + panel.h - 10;
+    SDL_SetRenderDrawColor(renderer, 80, 220, 80, 255);
+    for (int b = 0; b < HUD_BUCKETS; b++) {
+        SDL_Rect bar = { 20 + b * 8, 0, 6, buckets[b] * HUD_BAR_HEIGHT / most };
+        bar.y = base - bar.h;
+        SDL_RenderFillRect(renderer, &bar);
+    }
+
+    // Frame budget at the simulation rate
+    int budget = 20 + (int)(1000.0 / FPS / HUD_BUCKET_MS * 8);
+    SDL_SetRenderDrawColor(renderer, 220, 60, 60, 255);
+    SDL_RenderDrawLine(renderer, budget, base - HUD_BAR_HEIGHT, budget, base);
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
 
-    // Handle player 2
-    if (selectedPlayer2 == 1) {
-        if (currentKeyStates[SDL_SCANCODE_UP]) {
-            player2Texture.vy = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_LEFT]) {
-            player2Texture.vx = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_DOWN]) {
-            player2Texture.vy = +4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_RIGHT]) {
-            player2Texture.vx = +4;
-        }
-    }
-    else {
-        if (currentKeyStates[SDL_SCANCODE_UP]) {
-            player2GKTexture.vy = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_LEFT]) {
-            player2GKTexture.vx = -4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_DOWN]) {
-            player2GKTexture.vy = +4;
-        }
-        if (currentKeyStates[SDL_SCANCODE_RIGHT]) {
-            player2GKTexture.vx = +4;
-        }
-    }
+    spriteBatch.begin(&spriteAtlas);
+    font.render(spriteBatch, FONT_SMALL, times, 20, 15);
+    font.render(spriteBatch, FONT_SMALL, fill, 20, 15 + textHeight);
+    font.render(spriteBatch, FONT_SMALL, latency, 20, 15 + textHeight * 2);
+    spriteBatch.flush(renderer);
 }
 
-void updateVelocity() {
-    // Check ball collision with walls
-    if (ballTexture.x - ballTexture.width / 2 < LEFT) {
-		ballTexture.vx = -ballTexture.vx;
-		ballTexture.x = LEFT + ballTexture.width / 2;
-	}
-    else if (ballTexture.x + ballTexture.width / 2 > RIGHT) {
-		ballTexture.vx = -ballTexture.vx;
-		ballTexture.x = RIGHT - ballTexture.width / 2;
-	}
-    if (ballTexture.y - ballTexture.height / 2 < TOP) {
-		ballTexture.vy = -ballTexture.vy;
-		ballTexture.y = TOP + ballTexture.height / 2;
-	}
-    else if (ballTexture.y + ballTexture.height / 2 > BOTTOM) {
-		ballTexture.vy = -ballTexture.vy;
-		ballTexture.y = BOTTOM - ballTexture.height / 2;
-	}
-
-    // Check ball collision with players
-    if (isColliding(player1Texture, ballTexture)) {
-        ballTexture.vx += (ballTexture.x - player1Texture.x) / B;
-        ballTexture.vy += (ballTexture.y - player1Texture.y) / B;
-    }
-    if (isColliding(player1GKTexture, ballTexture)) {
-		ballTexture.vx += (ballTexture.x - player1GKTexture.x) / B;
-		ballTexture.vy += (ballTexture.y - player1GKTexture.y) / B;
-	}
-    if (isColliding(player2Texture, ballTexture)) {
-        ballTexture.vx += (ballTexture.x - player2Texture.x) / B;
-        ballTexture.vy += (ballTexture.y - player2Texture.y) / B;
-    }
-    if (isColliding(player2GKTexture, ballTexture)) {
-        ballTexture.vx += (ballTexture.x - player2GKTexture.x) / B;
-        ballTexture.vy += (ballTexture.y - player2GKTexture.y) / B;
-    }
-    if (ballTexture.vx > 10) {
-        ballTexture.vx = 10;
-    }
-    else if (ballTexture.vx < -10) {
-		ballTexture.vx = -10;
-	}
-    if (ballTexture.vy > 10) {
-		ballTexture.vy = 10;
-	}
-    else if (ballTexture.vy < -10) {
-		ballTexture.vy = -10;
-	}
-
-    if (frame % 300 == 0) {
-        if (ballTexture.vx >= 0) {
-			ballTexture.vx = -10;
-		}
-        else if (ballTexture.vx < 0) {
-			ballTexture.vx = 10;
-		}
-        if (ballTexture.vy >= 0) {
-			ballTexture.vy = -10;
-		}
-        else if (ballTexture.vy < 0) {
-			ballTexture.vy = 10;
-		}
-	}
-
-	// Check player collision with walls
-    if (player1Texture.x - player1Texture.width / 2 < LEFT) {
-		player1Texture.vx = 0;
-		player1Texture.x = LEFT + player1Texture.width / 2;
-	}
-    else if (player1Texture.x + player1Texture.width / 2 > RIGHT) {
-		player1Texture.vx = 0;
-		player1Texture.x = RIGHT - player1Texture.width / 2;
-	}
-    if (player1Texture.y - player1Texture.height / 2 < TOP) {
-		player1Texture.vy = 0;
-		player1Texture.y = TOP + player1Texture.height / 2;
-	}
-    else if (player1Texture.y + player1Texture.height / 2 > BOTTOM) {
-		player1Texture.vy = 0;
-		player1Texture.y = BOTTOM - player1Texture.height / 2;
-	}
-
-    if (player1GKTexture.x - player1GKTexture.width / 2 < LEFT) {
-		player1GKTexture.vx = 0;
-		player1GKTexture.x = LEFT + player1GKTexture.width / 2;
-	}
-    else if (player1GKTexture.x + player1GKTexture.width / 2 > GKLEFT) {
-		player1GKTexture.vx = 0;
-		player1GKTexture.x = GKLEFT - player1GKTexture.width / 2;
-	}
-    if (player1GKTexture.y - player1GKTexture.height / 2 < TOP) {
-		player1GKTexture.vy = 0;
-		player1GKTexture.y = TOP + player1GKTexture.height / 2;
-	}
-    else if (player1GKTexture.y + player1GKTexture.height / 2 > BOTTOM) {
-		player1GKTexture.vy = 0;
-        player1GKTexture.y = BOTTOM - player1GKTexture.height / 2;
-    }
-
-    if (player2Texture.x - player2Texture.width / 2 < LEFT) {
-        player2Texture.vx = 0;
-        player2Texture.x = LEFT + player2Texture.width / 2;
-    }
-    else if (player2Texture.x + player2Texture.width / 2 > RIGHT) {
-		player2Texture.vx = 0;
-		player2Texture.x = RIGHT - player2Texture.width / 2;
-	}
-    if (player2Texture.y - player2Texture.height / 2 < TOP) {
-        player2Texture.vy = 0;
-        player2Texture.y = TOP + player2Texture.height / 2;
-    }
-    else if (player2Texture.y + player2Texture.height / 2 > BOTTOM) {
-        player2Texture.vy = 0;
-        player2Texture.y = BOTTOM - player2Texture.height / 2;
+// Draws the match and, when it is on, the profiler overlay over it
+void render(const MatchSnapshot& shown, float alpha) {
+    if (!showProfiler) {
+        matchView.render(shown, alpha, NULL);
+        return;
     }
-
-    if (player2GKTexture.x - player2GKTexture.width / 2 < GKRIGHT) {
-		player2GKTexture.vx = 0;
-		player2GKTexture.x = GKRIGHT + player2GKTexture.width / 2;
-	}
-    else if (player2GKTexture.x + player2GKTexture.width / 2 > RIGHT) {
-		player2GKTexture.vx = 0;
-		player2GKTexture.x = RIGHT - player2GKTexture.width / 2;
-	}
-    if (player2GKTexture.y - player2GKTexture.height / 2 < TOP) {
-		player2GKTexture.vy = 0;
-		player2GKTexture.y = TOP + player2GKTexture.height / 2;
-	}
-    else if (player2GKTexture.y + player2GKTexture.height / 2 > BOTTOM) {
-		player2GKTexture.vy = 0;
-		player2GKTexture.y = BOTTOM - player2GKTexture.height / 2;
-	}
+    SDL_Rect panel = profilerPanel();
+    matchView.render(shown, alpha, &panel);
+    renderProfiler();
 }
 
-void updatePosition() {
-	// Update player position
-	player1Texture.x += player1Texture.vx;
-	player1Texture.y += player1Texture.vy;
-
-
-	player1GKTexture.x += player1GKTexture.vx;
-	player1GKTexture.y += player1GKTexture.vy;
-
-	player2Texture.x += player2Texture.vx;
-	player2Texture.y += player2Texture.vy;
-
-	player2GKTexture.x += player2GKTexture.vx;
-	player2GKTexture.y += player2GKTexture.vy;
-
-    // Check player collision with each other
-    if (isColliding(player1GKTexture, player1Texture)) {
-        int dx = player1GKTexture.x - player1Texture.x;
-        int dy = player1GKTexture.y - player1Texture.y;
-        if (dx > 0) {
-            player1GKTexture.x += 2;
-            player1Texture.x -= 2;
-        }
-        else {
-            player1GKTexture.x -= 2;
-            player1Texture.x += 2;
-        }
-        if (dy > 0) {
-            player1GKTexture.y += 2;
-            player1Texture.y -= 2;
-        }
-        else {
-            player1GKTexture.y -= 2;
-            player1Texture.y += 2;
-        }
-    }
-
-    if (isColliding(player2GKTexture, player2Texture)) {
-        int dx = player2GKTexture.x - player2Texture.x;
-        int dy = player2GKTexture.y - player2Texture.y;
-        if (dx > 0) {
-            player2GKTexture.x += 2;
-            player2Texture.x -= 2;
-        }
-        else {
-            player2GKTexture.x -= 2;
-            player2Texture.x += 2;
-        }
-        if (dy > 0) {
-            player2GKTexture.y += 2;
-            player2Texture.y -= 2;
-        }
-        else {
-            player2GKTexture.y -= 2;
-            player2Texture.y += 2;
-        }
-    }
-
-    if (isColliding(player1Texture, player2Texture)) {
-        int dx = player1Texture.x - player2Texture.x;
-        int dy = player1Texture.y - player2Texture.y;
-        if (dx > 0) {
-            player1Texture.x += 2;
-            player2Texture.x -= 2;
-        }
-        else {
-            player1Texture.x -= 2;
-            player2Texture.x += 2;
-        }
-        if (dy > 0) {
-            player1Texture.y += 2;
-            player2Texture.y -= 2;
-        }
-        else {
-            player1Texture.y -= 2;
-            player2Texture.y += 2;
-        }
-    }
-
-    if (isColliding(player1GKTexture, player2Texture)) {
-        int dx = player1GKTexture.x - player2Texture.x;
-        int dy = player1GKTexture.y - player2Texture.y;
-        if (dx > 0) {
-            player1GKTexture.x += 2;
-            player2Texture.x -= 2;
-        }
-        else {
-            player1GKTexture.x -= 2;
-            player2Texture.x += 2;
-        }
-        if (dy > 0) {
-            player1GKTexture.y += 2;
-            player2Texture.y -= 2;
-        }
-        else {
-            player1GKTexture.y -= 2;
-            player2Texture.y += 2;
+// Records how long the step shown, and the input it used, took to reach the
+// screen, with presented the time present returned with the frame showing it
+// Only the first frame showing a step counts
+void trackLatency(const MatchSnapshot& shown, int64_t presented, FILE* log) {
+    double stepMs = (presented - shown.due) / 1e6;
+    double inputMs = -1;
+    stepLatency.add(stepMs);
+    if (shown.inputChanged >= 0) {
+        inputMs = (presented - shown.inputChanged) / 1e6;
+        inputLatency.add(inputMs);
+        if (isProfiling()) {
+            recordEvent("input to present", shown.inputChanged, presented);
         }
     }
-
-    if (isColliding(player2GKTexture, player1Texture)) {
-        int dx = player2GKTexture.x - player1Texture.x;
-        int dy = player2GKTexture.y - player1Texture.y;
-        if (dx > 0) {
-            player2GKTexture.x += 2;
-            player1Texture.x -= 2;
-        }
-        else {
-            player2GKTexture.x -= 2;
-            player1Texture.x += 2;
-        }
-        if (dy > 0) {
-            player2GKTexture.y += 2;
-            player1Texture.y -= 2;
-        }
-        else {
-            player2GKTexture.y -= 2;
-            player1Texture.y += 2;
-        }
+    if (log != NULL) {
+        fprintf(log, "%d,%.3f,%.3f,%.3f\n", shown.frame, lastLatchWait, stepMs, inputMs);
     }
-
-	// Update ball position
-	ballTexture.x += ballTexture.vx;
-	ballTexture.y += ballTexture.vy;
-
-    // Check goal
-    if (ballTexture.x - ballTexture.width / 2 < LEFT) {
-        if (ballTexture.y > GTOP && ballTexture.y < GBOTTOM) {
-			win2 = true;
-		}
-	}
-    else if (ballTexture.x + ballTexture.width / 2 > RIGHT) {
-        if (ballTexture.y > GTOP && ballTexture.y < GBOTTOM) {
-            win1 = true;
-		}
-	}
 }
 
-void render() {
-    // Clear screen
-    SDL_RenderClear(renderer);
-
-    // Render background
-    bgTexture.renderFull();
-
-    // Render players and ball
-    player1Texture.render();
-    player1GKTexture.render();
-
-    player2Texture.render();
-    player2GKTexture.render();
-
-    ballTexture.render();
-
-    // Render scores
-    TTF_Font* font = TTF_OpenFont("assets/font/font.ttf", 64); // Load your font
-    SDL_Color textColor = { 255, 255, 255, 255 }; // White color
-
-    if (!font) {
-        std::cerr << "Failed to load font: " << TTF_GetError() << std::endl;
-        return;
-    }
-
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, std::to_string(score1).c_str(), textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
-
-    SDL_Rect textRect = { 500, 30, textWidth, textHeight };
-    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-
-    textSurface = TTF_RenderText_Solid(font, std::to_string(score2).c_str(), textColor);
-    textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    textWidth = textSurface->w;
-    textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
-
-    textRect = { 740, 30, textWidth, textHeight };
-    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-
-    // Update screen
-    SDL_RenderPresent(renderer);
+// Prints latency percentiles of the last frames
+void printLatency(const char* name, const FrameTimes& times) {
+    double p50, p99, max;
+    times.summary(p50, p99, max);
+    printf("%s over the last %d frames: p50 %.2f  p99 %.2f  max %.2f ms\n", name, times.count(), p50, p99, max);
 }
 
 int main(int argc, char* args[]) {
+    launched = SDL_GetPerformanceCounter();
+
+    // Players a side can be set with --team-size N, frames drawn per second with --fps N
+    // and the match seed with --seed N; --record FILE saves the inputs for the replay tool
+    // and --profile FILE saves a Chrome trace of the last frames on exit
+    // Assets come from the pack built by packassets, --pack FILE picks another one
+    // --latency FILE logs input to present latency per frame as CSV and
+    // --late-latch 0 reads input right after present instead of just in time
+    // --host PORT waits for another player to --join HOST:PORT for an online
+    // match; --net-delay MS, --net-jitter MS and --net-loss PERCENT make the
+    // connection worse for trying it out and --input-delay N holds back local
+    // keys for N steps so fewer remote inputs arrive late
+    // --ai-budget MS gives the 1P opponent's planner MS of search a step, 0
+    // plays the plain computer instead, and --ai-threads N sets its threads
+    // --track-allocs N counts heap allocations, SDL's included, and reports
+    // the call sites of every frame after the first N that still allocates
+    int teamSize = DEFAULT_TEAM_SIZE;
+    int renderFps = 0;
+    uint64_t seed = randomSeed();
+    const char* recordPath = NULL;
+    const char* tracePath = NULL;
+    const char* packPath = ASSET_PACK_FILE;
+    const char* latencyPath = NULL;
+    bool lateLatch = true;
+    int hostPort = 0;
+    const char* joinAddress = NULL;
+    LinkConditions conditions = { 0, 0, 0 };
+    int inputDelay = 2;
+    PlannerOptions plannerOptions;
+    int allocWarmup = -1;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(args[i], "--team-size") == 0) {
+            teamSize = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--fps") == 0) {
+            renderFps = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--seed") == 0) {
+            seed = strtoull(args[i + 1], NULL, 10);
+        }
+        else if (strcmp(args[i], "--record") == 0) {
+            recordPath = args[i + 1];
+        }
+        else if (strcmp(args[i], "--pack") == 0) {
+            packPath = args[i + 1];
+        }
+        else if (strcmp(args[i], "--profile") == 0) {
+            tracePath = args[i + 1];
+            setProfiling(true);
+        }
+        else if (strcmp(args[i], "--latency") == 0) {
+            latencyPath = args[i + 1];
+        }
+        else if (strcmp(args[i], "--late-latch") == 0) {
+            lateLatch = atoi(args[i + 1]) != 0;
+        }
+        else if (strcmp(args[i], "--host") == 0) {
+            hostPort = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--join") == 0) {
+            joinAddress = args[i + 1];
+        }
+        else if (strcmp(args[i], "--net-delay") == 0) {
+            conditions.delayMs = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--net-jitter") == 0) {
+            conditions.jitterMs = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--net-loss") == 0) {
+            conditions.lossPercent = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--input-delay") == 0) {
+            inputDelay = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--ai-budget") == 0) {
+            plannerOptions.budgetMs = atof(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--ai-threads") == 0) {
+            plannerOptions.threads = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--track-allocs") == 0) {
+            allocWarmup = atoi(args[i + 1]);
+        }
+    }
+
+    // SDL has to allocate through the counting functions from the start
+    if (allocWarmup >= 0) {
+        trackSdlAllocations();
+    }
+
+    // Online matches are set up before the window opens, the host decides
+    // the seed and team size and plays the left side
+    UdpSocket socket;
+    NetAddress peer;
+    ReplayHeader setup;
+    int localSide = -1;
+    if (hostPort > 0) {
+        setup.seed = seed;
+        setup.teamSize = teamSize;
+        setup.control[0] = CONTROL_HUMAN;
+        setup.control[1] = CONTROL_HUMAN;
+        printf("Waiting for a player on port %d\n", hostPort);
+        if (!socket.open((uint16_t)hostPort) || !hostMatch(socket, setup, HOST_TIMEOUT_MS, peer)) {
+            return -1;
+        }
+        localSide = 0;
+    }
+    else if (joinAddress != NULL) {
+        if (!parseAddress(joinAddress, peer) || !socket.open(0) || !joinMatch(socket, peer, JOIN_TIMEOUT_MS, setup)) {
+            return -1;
+        }
+        seed = setup.seed;
+        teamSize = setup.teamSize;
+        localSide = 1;
+    }
+
     //Start up SDL and create window
     if (!init())
     {
@@ -810,349 +694,200 @@ int main(int argc, char* args[]) {
         return -1;
     }
 
-    //Load media
-    if (!loadMedia())
-    {
-        printf("Failed to load media!\n");
-        return -1;
-    }
+    printf("Window ready after %.1f ms\n", sinceLaunch());
+
+    //Load media, loose files finish in the background while the start screen is up
+    startMedia(packPath);
 
     bool quit = false;
     SDL_Event e;
 
-    int mode = showStartScreen();
-
-    reset();
+    int mode = localSide >= 0 ? 2 : showStartScreen();
+    if (mode == 0 || !finishMedia())
+    {
+        printf("Failed to load media!\n");
+        close();
+        return -1;
+    }
+    matchView.create(renderer, bgTexture.texture, &spriteAtlas, &spriteBatch, &font, sprites, keepsFrame);
+    spriteBatch.setArena(&frameArena);
 
-    // Main loop
+    // 1P plays against the computer, 2P shares the keyboard or plays online
+    int opponentControl = CONTROL_HUMAN;
     if (mode == 1) {
-        int selectedPlayer1 = 1;
-        // 1P game loop
-        while (!quit) {
-            Uint32 frameStart = SDL_GetTicks();
+        opponentControl = plannerOptions.budgetMs > 0 ? CONTROL_PLANNED : CONTROL_AI;
+    }
+    initMatch(match, CONTROL_HUMAN, opponentControl, teamSize, seed);
+    printf("Match seed %llu\n", (unsigned long long)seed);
+    ReplayWriter recording;
+    if (recordPath != NULL && recording.open(recordPath, replayHeaderFor(match))) {
+        printf("Recording to %s\n", recordPath);
+    }
+    FILE* latencyLog = latencyPath != NULL ? fopen(latencyPath, "w") : NULL;
+    if (latencyLog != NULL) {
+        fprintf(latencyLog, "frame,latch_wait_ms,step_to_present_ms,input_to_present_ms\n");
+    }
+
+    // The simulation runs on its own thread at a fixed FPS steps a second;
+    // frames are drawn as often as vsync or --fps allow from its newest
+    // snapshot, blending between the last two steps. With vsync the late
+    // latch waits out the spare part of each refresh before input is read
+    // and the snapshot picked, then the frame draws and presents
+    // Online, the rollback session steps the match and records what it confirms
+    NetLink* link = NULL;
+    RollbackSession* session = NULL;
+    MonteCarloPlanner* planner = NULL;
+    SimThread simulation(match, FPS, MAX_STEPS_PER_FRAME, recording.isOpen() && localSide < 0 ? &recording : NULL);
+    if (opponentControl == CONTROL_PLANNED) {
+        plannerOptions.seed = mixSeed(seed);
+        planner = new MonteCarloPlanner(1, plannerOptions);
+        simulation.setPlanner(planner);
+        printf("Computer plans with %.2f ms on %d threads a step\n", plannerOptions.budgetMs, planner->getThreads());
+    }
+    if (localSide >= 0) {
+        link = new NetLink(socket, peer, conditions, mixSeed(seed) + localSide);
+        session = new RollbackSession(match, localSide, inputDelay, *link);
+        if (recording.isOpen()) {
+            session->recordTo(&recording);
+        }
+        if (localSide == 0) {
+            session->setWelcome(setup);
+        }
+        simulation.setSession(session);
+        printf("Playing online as the %s side\n", localSide == 0 ? "left" : "right");
+    }
+    simulation.start();
+    int lastShown = -1;
+    FramePacer pacer(renderFps);
+    LateLatch latch(lateLatch ? refreshRate : 0);
+    if (lateLatch && refreshRate > 0) {
+        printf("Reading input late for a %d Hz display\n", refreshRate);
+    }
+    int64_t frameStart = profileNow();
+    AllocationWatch allocations(allocWarmup);
+    if (allocWarmup >= 0) {
+        setAllocationTracking(true);
+    }
 
+    // Main loop
+    while (!quit) {
+        PROFILE_SCOPE("frame");
+        frameArena.reset();
+        if (allocWarmup >= 0) {
+            allocations.beginFrame();
+        }
+        {
+            PROFILE_SCOPE("latch");
+            latch.wait();
+            lastLatchWait = latch.lastWaitMs();
+        }
+        {
+            PROFILE_SCOPE("events");
             while (SDL_PollEvent(&e) != 0) {
                 //User requests quit
                 if (e.type == SDL_QUIT) {
                     quit = true;
                 }
-                //User presses a key
-                else if (e.type == SDL_KEYDOWN) {
+                //Movement and switching keys go to the input latch
+                else if (!input.handleEvent(e) && e.type == SDL_KEYDOWN && e.key.repeat == 0) {
                     switch (e.key.keysym.sym) {
-                    case SDLK_w:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vy = -4;
-                        }
-                        else {
-                            player1GKTexture.vy = -4;
-                        }
-                        break;
-                    case SDLK_a:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vx = -4;
-                        }
-                        else {
-                            player1GKTexture.vx = -4;
-                        }
-                        break;
-                    case SDLK_s:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vy = +4;
-                        }
-                        else {
-                            player1GKTexture.vy = +4;
-                        }
-                        break;
-                    case SDLK_d:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vx = +4;
-                        }
-                        else {
-                            player1GKTexture.vx = +4;
-                        }
-                        break;
-                    case SDLK_LSHIFT:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vx = 0;
-                            player1Texture.vy = 0;
-                            selectedPlayer1 = 2;
-                        }
-                        else {
-                            player1GKTexture.vx = 0;
-                            player1GKTexture.vy = 0;
-                            selectedPlayer1 = 1;
-                        }
+                    case SDLK_F3:
+                        showProfiler = !showProfiler;
+                        matchView.redrawAll();
                         break;
                     }
                 }
-                else if (e.type == SDL_KEYUP) {
-                    switch (e.key.keysym.sym) {
-                    case SDLK_w:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vy = 0;
-                        }
-                        else {
-                            player1GKTexture.vy = 0;
-                        }
-                        break;
-                    case SDLK_a:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vx = 0;
-                        }
-                        else {
-                            player1GKTexture.vx = 0;
-                        }
-                        break;
-                    case SDLK_s:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vy = 0;
-                        }
-                        else {
-                            player1GKTexture.vy = 0;
-                        }
-                        break;
-                    case SDLK_d:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vx = 0;
-                        }
-                        else {
-                            player1GKTexture.vx = 0;
-                        }
-                        break;
-                    }
+                //Window contents or render targets lost, draw everything again
+                else if (e.type == SDL_WINDOWEVENT) {
+                    matchView.redrawAll();
+                }
+                else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+                    matchView.invalidateStage();
                 }
             }
-            handleInput1P(selectedPlayer1);
-
-            updateVelocity();
-            updatePosition();
-
-            render();
-
-            if (win1) {
-                score1++;
-                win1 = false;
-                reset();
-                continue;
-            }
-            else if (win2) {
-                score2++;
-                win2 = false;
-                reset();
-                continue;
-            }
+        }
 
-            frame++;
+        // A full queue leaves the keys in the latch for the next frame
+        if (!simulation.inputFull()) {
+            simulation.sendInput(input.sample());
+        }
 
-            int frameTime = SDL_GetTicks() - frameStart;
-            if (frameTime < FRAME_DELAY) {
-                SDL_Delay(FRAME_DELAY - frameTime);
-            }
+        // Blend from the step shown by how far the next one is due
+        const MatchSnapshot& shown = simulation.latest();
+        float alpha = (float)(profileNow() - shown.due) / simulation.stepInterval();
+        alpha = alpha < 0 ? 0 : (alpha > 1 ? 1 : alpha);
+        {
+            PROFILE_SCOPE("render");
+            render(shown, alpha);
+        }
+        {
+            // Update screen
+            PROFILE_SCOPE("present");
+            latch.presenting();
+            SDL_RenderPresent(renderer);
+            latch.presented();
+        }
+        if (shown.frame != lastShown) {
+            trackLatency(shown, profileNow(), latencyLog);
+            lastShown = shown.frame;
         }
+        {
+            PROFILE_SCOPE("wait");
+            pacer.wait();
+        }
+
+        int64_t frameEnd = profileNow();
+        frameTimes.add((frameEnd - frameStart) / 1e6);
+        frameStart = frameEnd;
+        if (allocWarmup >= 0) {
+            allocations.endFrame();
+        }
+    }
+    setAllocationTracking(false);
+
+    simulation.stop();
+    recording.close(session != NULL ? session->confirmedState() : match);
+    double lateP50, lateP99, lateMax;
+    simulation.getLateness().summary(lateP50, lateP99, lateMax);
+    printf("Simulation ran %lld steps, dropped %lld, held back %lld, started late p50 %.2f  p99 %.2f  max %.2f ms\n",
+        simulation.getSteps(), simulation.getDroppedSteps(), simulation.getHeldSteps(), lateP50, lateP99, lateMax);
+    if (session != NULL) {
+        printf("Sent %lld packets, dropped %lld\n", link->getSent(), link->getDropped());
+        printRollbackStats(session->getStats(), 1000.0 / FPS);
+        delete session;
+        delete link;
+    }
+    if (planner != NULL) {
+        PlannerStats plannerStats = planner->getStats();
+        double planP50, planP99, planMax, overP50, overP99, overMax;
+        plannerStats.planMs.summary(planP50, planP99, planMax);
+        plannerStats.overrunMs.summary(overP50, overP99, overMax);
+        printf("Planner ran %.0f rollouts a step, changed tactic %lld times in %lld decisions\n",
+            plannerStats.frames > 0 ? (double)plannerStats.rollouts / plannerStats.frames : 0.0,
+            plannerStats.changes, plannerStats.decisions);
+        printf("Planner took p99 %.3f  max %.3f ms a step, searched past its budget p99 %.3f  max %.3f ms\n",
+            planP99, planMax, overP99, overMax);
+        delete planner;
+    }
+    if (stepLatency.count() > 0) {
+        printLatency("Step to present", stepLatency);
+    }
+    if (inputLatency.count() > 0) {
+        printLatency("Input to present", inputLatency);
+    }
+    if (latencyLog != NULL) {
+        fclose(latencyLog);
+    }
+    if (tracePath != NULL) {
+        writeChromeTrace(tracePath);
+    }
+    printf("Frame arena peaked at %zu of %zu bytes, outgrown %lld times\n", frameArena.getPeak(), frameArena.getCapacity(),
+        frameArena.getOverflows());
+    if (allocWarmup >= 0) {
+        allocations.printReport("Heap allocations");
     }
-    else {
-        int selectedPlayer1 = 1, selectedPlayer2 = 1;
-        // 2P game loop
-		while (!quit) {
-			Uint32 frameStart = SDL_GetTicks();
-
-			while (SDL_PollEvent(&e) != 0) {
-                //User requests quit
-				if (e.type == SDL_QUIT) {
-					quit = true;
-				}
-                //User presses a key
-                else if (e.type == SDL_KEYDOWN) {
-                    switch (e.key.keysym.sym) {
-					case SDLK_w:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vy = -4;
-						}
-                        else {
-							player1GKTexture.vy = -4;
-						}
-						break;
-					case SDLK_a:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vx = -4;
-						}
-                        else {
-							player1GKTexture.vx = -4;
-						}
-						break;
-                    case SDLK_s:
-                            if (selectedPlayer1 == 1) {
-							player1Texture.vy = +4;
-						}
-                            else {
-							player1GKTexture.vy = +4;
-						}
-						break;
-					case SDLK_d:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vx = +4;
-						}
-                        else {
-							player1GKTexture.vx = +4;
-						}
-                        break;
-                    case SDLK_UP:
-                        if (selectedPlayer2 == 1) {
-                            player2Texture.vy = -4;
-                        }
-                        else {
-							player2GKTexture.vy = -4;
-						}
-                        break;
-					case SDLK_LEFT:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vx = -4;
-						}
-                        else {
-							player2GKTexture.vx = -4;
-						}
-						break;
-					case SDLK_DOWN:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vy = +4;
-						}
-                        else {
-							player2GKTexture.vy = +4;
-						}
-						break;
-					case SDLK_RIGHT:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vx = +4;
-						}
-                        else {
-							player2GKTexture.vx = +4;
-						}
-						break;
-                    case SDLK_LSHIFT:
-                        if (selectedPlayer1 == 1) {
-                            player1Texture.vx = 0;
-                            player1Texture.vy = 0;
-							selectedPlayer1 = 2;
-						}
-                        else {
-                            player1GKTexture.vx = 0;
-							player1GKTexture.vy = 0;
-							selectedPlayer1 = 1;
-						}
-						break;
-                    case SDLK_RSHIFT:
-                        if (selectedPlayer2 == 1) {
-                            player2Texture.vx = 0;
-                            player2Texture.vy = 0;
-                            selectedPlayer2 = 2;
-                        }
-                        else {
-                            player2GKTexture.vx = 0;
-							player2GKTexture.vy = 0;
-							selectedPlayer2 = 1;
-						}
-                        break;
-					}
-				}
-                else if (e.type == SDL_KEYUP) {
-                    switch (e.key.keysym.sym) {
-					case SDLK_w:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vy = 0;
-						}
-                        else {
-							player1GKTexture.vy = 0;
-						}
-						break;
-					case SDLK_a:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vx = 0;
-						}
-                        else {
-							player1GKTexture.vx = 0;
-						}
-						break;
-					case SDLK_s:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vy = 0;
-						}
-                        else {
-							player1GKTexture.vy = 0;
-						}
-						break;
-					case SDLK_d:
-                        if (selectedPlayer1 == 1) {
-							player1Texture.vx = 0;
-						}
-                        else {
-							player1GKTexture.vx = 0;
-						}
-						break;
-					case SDLK_UP:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vy = 0;
-						}
-                        else {
-							player2GKTexture.vy = 0;
-						}
-						break;
-					case SDLK_LEFT:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vx = 0;
-						}
-                        else {
-							player2GKTexture.vx = 0;
-						}
-						break;
-					case SDLK_DOWN:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vy = 0;
-						}
-                        else {
-							player2GKTexture.vy = 0;
-						}
-						break;
-					case SDLK_RIGHT:
-                        if (selectedPlayer2 == 1) {
-							player2Texture.vx = 0;
-						}
-                        else {
-							player2GKTexture.vx = 0;
-						}
-						break;
-					}
-				}
-			}
-            handleInput2P(selectedPlayer1, selectedPlayer2);
-
-            updateVelocity();
-            updatePosition();
-
-			render();
-
-            if (win1) {
-				score1++;
-                win1 = false;
-                reset();
-                continue;
-			}
-            else if (win2) {
-				score2++;
-                win2 = false;
-                reset();
-                continue;
-			}
-
-            frame++;
-
-			int frameTime = SDL_GetTicks() - frameStart;
-			if (frameTime < FRAME_DELAY) {
-				SDL_Delay(FRAME_DELAY - frameTime);
-			}
-		}
-	}
-
     close();
 
-    return 0;
+    // Frames that allocate after warm-up fail the run when tracking
+    return allocWarmup >= 0 && allocations.getFramesAllocating() > 0 ? 1 : 0;
 }
@@ -0,0 +1,853 @@
+#include "matchserver.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "lockfree.h"
+#include "profiler.h"
+#include "sim.h"
+#include "snapshot.h"
+
+// Largest team a state packet has room for
+const int MAX_SERVER_TEAM_SIZE = 11;
+
+// Ticks run in a row when a worker falls behind, the rest are skipped
+const int MAX_CATCH_UP_TICKS = 3;
+
+// A match ends once one of its players has not been heard from for this long
+const int SILENCE_MS = 5000;
+
+// Players given a match are ignored by the lobby for this long, the worker
+// sends the welcome again until they answer it
+const int RECENT_JOIN_MS = 2000;
+
+// A player waiting for an opponent is dropped once it stops saying hello
+const int WAITING_MS = 1000;
+
+// Matches the lobby can hand a worker before it picks them up
+const int PENDING_CAPACITY = 1024;
+
+// Packets read and sent a system call
+const int RECEIVE_BATCH = 64;
+const int SEND_BATCH = 256;
+
+// Socket buffers, room for a few ticks of states
+const int SOCKET_BUFFER_BYTES = 4 << 20;
+
+// Match ids hold the slot in their low bits and a generation above, so
+// packets for a finished match do not reach the next one in its slot
+const int SLOT_BITS = 20;
+const uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+
+static int64_t monotonicNow() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int64_t threadCpuNow() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void setBufferSizes(intptr_t socket) {
+    int bytes = SOCKET_BUFFER_BYTES;
+    setsockopt((int)socket, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    setsockopt((int)socket, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+}
+
+// Adds a descriptor to an epoll set, to be woken when it can be read
+static bool watch(int epoll, int descriptor) {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = descriptor;
+    return epoll_ctl(epoll, EPOLL_CTL_ADD, descriptor, &event) == 0;
+}
+
+int writeServerJoin(unsigned char* out, uint32_t token) {
+    out[0] = SERVER_JOIN;
+    out[1] = SERVER_VERSION;
+    putU32(out + 2, token);
+    return SERVER_JOIN_SIZE;
+}
+
+int writeServerWelcome(unsigned char* out, const ServerWelcome& welcome) {
+    out[0] = SERVER_WELCOME;
+    out[1] = SERVER_VERSION;
+    putU32(out + 2, welcome.token);
+    putU32(out + 6, welcome.match);
+    out[10] = (unsigned char)welcome.side;
+    putU64(out + 11, welcome.seed);
+    out[19] = (unsigned char)welcome.teamSize;
+    out[20] = (unsigned char)welcome.rate;
+    return SERVER_WELCOME_SIZE;
+}
+
+int writeServerInput(unsigned char* out, uint32_t match, int side, uint32_t sequence, unsigned char buttons, int stateFrame) {
+    out[0] = SERVER_INPUT;
+    putU32(out + 1, match);
+    out[5] = (unsigned char)side;
+    putU32(out + 6, sequence);
+    out[10] = buttons;
+    putU32(out + 11, (uint32_t)stateFrame);
+    return SERVER_INPUT_SIZE;
+}
+
+bool readServerWelcome(const unsigned char* in, int size, ServerWelcome& welcome) {
+    if (size < SERVER_WELCOME_SIZE || in[0] != SERVER_WELCOME || in[1] != SERVER_VERSION) {
+        return false;
+    }
+    welcome.token = getU32(in + 2);
+    welcome.match = getU32(in + 6);
+    welcome.side = in[10];
+    welcome.seed = getU64(in + 11);
+    welcome.teamSize = in[19];
+    welcome.rate = in[20];
+    return true;
+}
+
+bool readServerState(const unsigned char* in, int size, ServerState& state) {
+    if (size < SERVER_STATE_HEADER || in[0] != SERVER_STATE) {
+        return false;
+    }
+    state.token = getU32(in + 1);
+    state.ack = getU32(in + 5);
+    state.snapshot = in + SERVER_STATE_HEADER;
+    state.snapshotSize = size - SERVER_STATE_HEADER;
+    return true;
+}
+
+bool readServerEnd(const unsigned char* in, int size, uint32_t& token) {
+    if (size < SERVER_END_SIZE || in[0] != SERVER_END) {
+        return false;
+    }
+    token = getU32(in + 1);
+    return true;
+}
+
+static sockaddr_in toSockaddr(const NetAddress& address) {
+    sockaddr_in result;
+    memset(&result, 0, sizeof(result));
+    result.sin_family = AF_INET;
+    result.sin_addr.s_addr = htonl(address.host);
+    result.sin_port = htons(address.port);
+    return result;
+}
+
+SendBatch::SendBatch(int capacity, int size) : buffer((size_t)capacity * size), messages(capacity), pieces(capacity), addresses(capacity) {
+    //Initialize
+    slotSize = size;
+    count = 0;
+    sent = 0;
+    bytes = 0;
+    dropped = 0;
+
+    memset(messages.data(), 0, messages.size() * sizeof(mmsghdr));
+    for (int i = 0; i < capacity; i++) {
+        pieces[i].iov_base = &buffer[(size_t)i * slotSize];
+        messages[i].msg_hdr.msg_iov = &pieces[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_name = &addresses[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+}
+
+void SendBatch::add(intptr_t socket, const NetAddress& to, const unsigned char* data, int size) {
+    if (count == (int)messages.size()) {
+        flush(socket);
+    }
+    memcpy(pieces[count].iov_base, data, size);
+    pieces[count].iov_len = size;
+    addresses[count] = toSockaddr(to);
+    count++;
+}
+
+void SendBatch::flush(intptr_t socket) {
+    int done = 0;
+    while (done < count) {
+        int result = sendmmsg((int)socket, &messages[done], count - done, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Socket buffer full, nothing waits for room
+            dropped += count - done;
+            break;
+        }
+        for (int i = done; i < done + result; i++) {
+            bytes += messages[i].msg_len;
+        }
+        sent += result;
+        done += result;
+    }
+    count = 0;
+}
+
+long long SendBatch::getSent() const {
+    return sent;
+}
+
+long long SendBatch::getBytes() const {
+    return bytes;
+}
+
+long long SendBatch::getDropped() const {
+    return dropped;
+}
+
+ReceiveBatch::ReceiveBatch(int capacity) : buffer((size_t)capacity * MAX_PACKET), messages(capacity), pieces(capacity), addresses(capacity) {
+    //Initialize
+    memset(messages.data(), 0, messages.size() * sizeof(mmsghdr));
+    for (int i = 0; i < capacity; i++) {
+        pieces[i].iov_base = &buffer[(size_t)i * MAX_PACKET];
+        pieces[i].iov_len = MAX_PACKET;
+        messages[i].msg_hdr.msg_iov = &pieces[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_name = &addresses[i];
+    }
+}
+
+int ReceiveBatch::receive(intptr_t socket) {
+    for (size_t i = 0; i < messages.size(); i++) {
+        messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+    int count = recvmmsg((int)socket, messages.data(), (unsigned int)messages.size(), MSG_DONTWAIT, NULL);
+    return count > 0 ? count : 0;
+}
+
+const unsigned char* ReceiveBatch::data(int index) const {
+    return (const unsigned char*)pieces[index].iov_base;
+}
+
+int ReceiveBatch::size(int index) const {
+    return (int)messages[index].msg_len;
+}
+
+NetAddress ReceiveBatch::from(int index) const {
+    NetAddress address;
+    address.host = ntohl(addresses[index].sin_addr.s_addr);
+    address.port = ntohs(addresses[index].sin_port);
+    return address;
+}
+
+ServerOptions::ServerOptions() {
+    //Initialize
+    rate = 60;
+    workers = (int)std::thread::hardware_concurrency();
+    if (workers < 1) {
+        workers = 1;
+    }
+    maxMatches = 10000;
+    teamSize = DEFAULT_TEAM_SIZE;
+    matchSeconds = 120;
+    seed = randomSeed();
+    pin = true;
+}
+
+WorkerReport::WorkerReport() {
+    //Initialize
+    matches = 0;
+    ticks = 0;
+    missed = 0;
+    packetsIn = 0;
+    packetsOut = 0;
+    bytesOut = 0;
+    sendDropped = 0;
+    cpuNanoseconds = 0;
+}
+
+void WorkerReport::merge(const WorkerReport& other) {
+    matches += other.matches;
+    ticks += other.ticks;
+    missed += other.missed;
+    packetsIn += other.packetsIn;
+    packetsOut += other.packetsOut;
+    bytesOut += other.bytesOut;
+    sendDropped += other.sendDropped;
+    cpuNanoseconds += other.cpuNanoseconds;
+    tickMs.insert(tickMs.end(), other.tickMs.begin(), other.tickMs.end());
+    tickCpuMs.insert(tickCpuMs.end(), other.tickCpuMs.begin(), other.tickCpuMs.end());
+}
+
+// Two players the lobby paired, on their way to a worker
+struct PendingMatch
+{
+    NetAddress address[2];
+    uint32_t token[2];
+    uint64_t seed;
+};
+
+// A match hosted by a worker
+struct ServerMatch
+{
+    // 0 while the slot is free
+    uint32_t id;
+
+    NetAddress address[2];
+    uint32_t token[2];
+
+    // Whether each player has sent input yet, until then it gets welcomes
+    bool heard[2];
+
+    // Snapshots sent, counted by tick, and the newest each player decoded
+    int tick;
+    SnapshotHistory sent;
+    int decoded[2];
+
+    // Newest input sequence of each player, the buttons it holds and the
+    // switch presses since the last step
+    uint32_t sequence[2];
+    unsigned char held[2];
+    unsigned char pressed[2];
+    int64_t lastHeard[2];
+
+    int ticksLeft;
+    MatchState state;
+};
+
+//Server worker class
+//Steps a share of the matches on its own thread, socket and timer
+class ServerWorker
+{
+public:
+    //Initializes variables; hosts up to capacity matches
+    ServerWorker(int index, int capacity, const ServerOptions& options);
+
+    //Stops the thread and closes the descriptors
+    ~ServerWorker();
+
+    //Binds the worker's socket and sets up its epoll set
+    bool open(uint16_t port);
+
+    void start();
+    void stop();
+
+    //Hands over a match from the lobby thread, false when the worker is full
+    bool add(const PendingMatch& match);
+
+    //Matches handed over and not finished yet
+    int getLoad() const;
+
+    //Takes the figures gathered since the last call
+    void collect(WorkerReport& out);
+
+private:
+    void run();
+    void admit();
+    void receive();
+    void handleInput(const unsigned char* data, int size, const NetAddress& from, int64_t now);
+    void tick(int steps, int64_t due);
+    void end(int activeIndex);
+
+    int index;
+    ServerOptions options;
+    int64_t interval;
+
+    UdpSocket socket;
+    int epoll;
+    int timer;
+    int wake;
+
+    // Slots of matches, the free ones and the ones playing
+    std::vector<ServerMatch> matches;
+    std::vector<int> freeSlots;
+    std::vector<int> active;
+    uint32_t generation;
+
+    SpscQueue<PendingMatch> pending;
+    std::atomic<int> load;
+
+    ReceiveBatch received;
+    SendBatch sending;
+    long long packetsIn;
+    long long lastSent;
+    long long lastBytes;
+    long long lastDropped;
+
+    std::mutex reportLock;
+    WorkerReport report;
+
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+ServerWorker::ServerWorker(int workerIndex, int capacity, const ServerOptions& serverOptions)
+    : matches(capacity), pending(PENDING_CAPACITY), load(0), received(RECEIVE_BATCH), sending(SEND_BATCH, SERVER_PACKET_SLOT), running(false) {
+    //Initialize
+    index = workerIndex;
+    options = serverOptions;
+    interval = 1000000000LL / options.rate;
+    epoll = -1;
+    timer = -1;
+    wake = -1;
+    generation = 1;
+    packetsIn = 0;
+    lastSent = 0;
+    lastBytes = 0;
+    lastDropped = 0;
+
+    freeSlots.reserve(capacity);
+    for (int slot = capacity - 1; slot >= 0; slot--) {
+        matches[slot].id = 0;
+        freeSlots.push_back(slot);
+    }
+    active.reserve(capacity);
+}
+
+ServerWorker::~ServerWorker() {
+    stop();
+    if (epoll >= 0) {
+        ::close(epoll);
+    }
+    if (timer >= 0) {
+        ::close(timer);
+    }
+    if (wake >= 0) {
+        ::close(wake);
+    }
+}
+
+bool ServerWorker::open(uint16_t port) {
+    if (!socket.open(port)) {
+        return false;
+    }
+    setBufferSizes(socket.handle());
+
+    epoll = epoll_create1(0);
+    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    wake = eventfd(0, EFD_NONBLOCK);
+    if (epoll < 0 || timer < 0 || wake < 0
+        || !watch(epoll, (int)socket.handle()) || !watch(epoll, timer) || !watch(epoll, wake)) {
+        printf("Unable to set up worker %d: %s!\n", index, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void ServerWorker::start() {
+    running = true;
+    thread = std::thread(&ServerWorker::run, this);
+}
+
+void ServerWorker::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    uint64_t one = 1;
+    if (write(wake, &one, sizeof(one)) < 0) {
+        printf("Unable to wake worker %d!\n", index);
+    }
+    thread.join();
+}
+
+bool ServerWorker::add(const PendingMatch& match) {
+    if (load.load(std::memory_order_relaxed) >= (int)matches.size() || !pending.push(match)) {
+        return false;
+    }
+    load.fetch_add(1, std::memory_order_relaxed);
+
+    // The match is queued either way, the worker takes it at its next tick
+    uint64_t one = 1;
+    if (write(wake, &one, sizeof(one)) != sizeof(one)) {
+        printf("Unable to wake worker %d!\n", index);
+    }
+    return true;
+}
+
+int ServerWorker::getLoad() const {
+    return load.load(std::memory_order_relaxed);
+}
+
+void ServerWorker::collect(WorkerReport& out) {
+    std::lock_guard<std::mutex> lock(reportLock);
+    out = WorkerReport();
+    std::swap(out, report);
+    report.matches = out.matches;
+    report.tickMs.reserve(out.tickMs.capacity());
+    report.tickCpuMs.reserve(out.tickCpuMs.capacity());
+}
+
+void ServerWorker::run() {
+    // One worker to a core keeps its matches in that core's caches
+    if (options.pin) {
+        int coreCount = (int)std::thread::hardware_concurrency();
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(index % (coreCount > 0 ? coreCount : 1), &cores);
+        pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+    }
+
+    // Ticks are due at fixed times from now on, however long each one takes
+    int64_t nextDue = monotonicNow() + interval;
+    itimerspec schedule;
+    schedule.it_value.tv_sec = nextDue / 1000000000;
+    schedule.it_value.tv_nsec = nextDue % 1000000000;
+    schedule.it_interval.tv_sec = interval / 1000000000;
+    schedule.it_interval.tv_nsec = interval % 1000000000;
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &schedule, NULL);
+
+    epoll_event events[3];
+    while (running) {
+        int count = epoll_wait(epoll, events, 3, -1);
+        for (int i = 0; i < count; i++) {
+            int descriptor = events[i].data.fd;
+            uint64_t value;
+            if (descriptor == wake) {
+                if (read(wake, &value, sizeof(value)) == sizeof(value)) {
+                    admit();
+                }
+            }
+            else if (descriptor == timer) {
+                if (read(timer, &value, sizeof(value)) != sizeof(value) || value == 0) {
+                    continue;
+                }
+                // Late wakeups run the ticks missed, up to a limit
+                int64_t due = nextDue + (int64_t)(value - 1) * interval;
+                nextDue += (int64_t)value * interval;
+                int steps = value > (uint64_t)MAX_CATCH_UP_TICKS ? MAX_CATCH_UP_TICKS : (int)value;
+                tick(steps, due);
+                std::lock_guard<std::mutex> lock(reportLock);
+                report.missed += (long long)value - steps;
+            }
+            else {
+                receive();
+            }
+        }
+    }
+}
+
+void ServerWorker::admit() {
+    int64_t now = monotonicNow();
+    PendingMatch arrived;
+    while (pending.pop(arrived)) {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        ServerMatch& match = matches[slot];
+        match.id = ((generation++ & (0xFFFFFFFFu >> SLOT_BITS)) << SLOT_BITS) | (uint32_t)(slot + 1);
+        for (int side = 0; side < 2; side++) {
+            match.address[side] = arrived.address[side];
+            match.token[side] = arrived.token[side];
+            match.heard[side] = false;
+            match.sequence[side] = 0;
+            match.held[side] = 0;
+            match.pressed[side] = 0;
+            match.lastHeard[side] = now;
+            match.decoded[side] = -1;
+        }
+        match.tick = 0;
+        match.sent.clear();
+        match.ticksLeft = options.matchSeconds * options.rate;
+        initMatch(match.state, CONTROL_HUMAN, CONTROL_HUMAN, options.teamSize, arrived.seed);
+        active.push_back(slot);
+    }
+}
+
+void ServerWorker::receive() {
+    int count;
+    while ((count = received.receive(socket.handle())) > 0) {
+        int64_t now = monotonicNow();
+        packetsIn += count;
+        for (int i = 0; i < count; i++) {
+            handleInput(received.data(i), received.size(i), received.from(i), now);
+        }
+    }
+}
+
+void ServerWorker::handleInput(const unsigned char* data, int size, const NetAddress& from, int64_t now) {
+    if (size < SERVER_INPUT_SIZE || data[0] != SERVER_INPUT) {
+        return;
+    }
+    uint32_t id = getU32(data + 1);
+    int side = data[5];
+    int slot = (int)(id & SLOT_MASK) - 1;
+    if (slot < 0 || slot >= (int)matches.size() || side > 1) {
+        return;
+    }
+    ServerMatch& match = matches[slot];
+    if (match.id != id || !sameAddress(from, match.address[side])) {
+        return;
+    }
+
+    // Late arrivals are older than what the player holds now
+    uint32_t sequence = getU32(data + 6);
+    if (match.heard[side] && (int32_t)(sequence - match.sequence[side]) <= 0) {
+        return;
+    }
+    int decoded = (int)getU32(data + 11);
+    if (decoded > match.decoded[side] && decoded <= match.tick) {
+        match.decoded[side] = decoded;
+    }
+    match.heard[side] = true;
+    match.sequence[side] = sequence;
+    match.held[side] = data[10] & ~INPUT_SWITCH;
+    match.pressed[side] |= data[10] & INPUT_SWITCH;
+    match.lastHeard[side] = now;
+}
+
+// Writes what one player sees of a match against the newest snapshot it
+// decoded, returns the size
+static int writeState(unsigned char* out, const ServerMatch& match, int side, const Snapshot& current) {
+    out[0] = SERVER_STATE;
+    putU32(out + 1, match.token[side]);
+    putU32(out + 5, match.sequence[side]);
+    int size = encodeSnapshot(current, match.sent.find(match.decoded[side]), out + SERVER_STATE_HEADER, SERVER_PACKET_SLOT - SERVER_STATE_HEADER);
+    return SERVER_STATE_HEADER + size;
+}
+
+void ServerWorker::tick(int steps, int64_t due) {
+    int64_t cpuStart = threadCpuNow();
+    int64_t now = monotonicNow();
+    int64_t silence = (int64_t)SILENCE_MS * 1000000;
+    unsigned char packet[SERVER_PACKET_SLOT];
+
+    // Backwards, so finished matches can be swapped out of the list
+    for (int i = (int)active.size() - 1; i >= 0; i--) {
+        ServerMatch& match = matches[active[i]];
+        for (int s = 0; s < steps; s++) {
+            Inputs inputs;
+            for (int side = 0; side < 2; side++) {
+                inputs.player[side].buttons = match.held[side] | match.pressed[side];
+                match.pressed[side] = 0;
+            }
+            step(match.state, inputs);
+        }
+        match.ticksLeft -= steps;
+        if (match.ticksLeft <= 0 || now - match.lastHeard[0] > silence || now - match.lastHeard[1] > silence) {
+            end(i);
+            continue;
+        }
+
+        // Players who have not answered yet may have lost their welcome
+        match.tick++;
+        Snapshot& current = match.sent.add(match.tick);
+        takeSnapshot(match.state, match.tick, current);
+        for (int side = 0; side < 2; side++) {
+            int size;
+            if (match.heard[side]) {
+                size = writeState(packet, match, side, current);
+            }
+            else {
+                ServerWelcome welcome = { match.token[side], match.id, side, match.state.seed, options.teamSize, options.rate };
+                size = writeServerWelcome(packet, welcome);
+            }
+            sending.add(socket.handle(), match.address[side], packet, size);
+        }
+    }
+    sending.flush(socket.handle());
+
+    int64_t done = monotonicNow();
+    int64_t cpu = threadCpuNow() - cpuStart;
+    std::lock_guard<std::mutex> lock(reportLock);
+    report.matches = (int)active.size();
+    report.ticks += steps;
+    report.packetsIn += packetsIn;
+    report.packetsOut += sending.getSent() - lastSent;
+    report.bytesOut += sending.getBytes() - lastBytes;
+    report.sendDropped += sending.getDropped() - lastDropped;
+    report.cpuNanoseconds += cpu;
+    report.tickMs.push_back((float)((done - due) / 1e6));
+    report.tickCpuMs.push_back((float)(cpu / 1e6));
+    packetsIn = 0;
+    lastSent = sending.getSent();
+    lastBytes = sending.getBytes();
+    lastDropped = sending.getDropped();
+}
+
+void ServerWorker::end(int activeIndex) {
+    int slot = active[activeIndex];
+    ServerMatch& match = matches[slot];
+    unsigned char packet[SERVER_END_SIZE];
+    packet[0] = SERVER_END;
+    putU16(packet + 5, (uint16_t)match.state.score1);
+    putU16(packet + 7, (uint16_t)match.state.score2);
+    for (int side = 0; side < 2; side++) {
+        putU32(packet + 1, match.token[side]);
+        sending.add(socket.handle(), match.address[side], packet, SERVER_END_SIZE);
+    }
+
+    match.id = 0;
+    freeSlots.push_back(slot);
+    active[activeIndex] = active.back();
+    active.pop_back();
+    load.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool MatchServer::JoinKey::operator<(const JoinKey& other) const {
+    if (host != other.host) {
+        return host < other.host;
+    }
+    if (port != other.port) {
+        return port < other.port;
+    }
+    return token < other.token;
+}
+
+MatchServer::MatchServer(const ServerOptions& serverOptions) : received(RECEIVE_BATCH) {
+    //Initialize
+    options = serverOptions;
+    if (options.rate < 1) {
+        options.rate = 1;
+    }
+    if (options.workers < 1) {
+        options.workers = 1;
+    }
+    if (options.teamSize > MAX_SERVER_TEAM_SIZE) {
+        options.teamSize = MAX_SERVER_TEAM_SIZE;
+    }
+    epoll = -1;
+    waiting = false;
+    waitingSince = 0;
+    lastForget = 0;
+    matchesStarted = 0;
+    joins = 0;
+    turnedAway = 0;
+}
+
+MatchServer::~MatchServer() {
+    stop();
+    for (size_t i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+    if (epoll >= 0) {
+        ::close(epoll);
+    }
+}
+
+bool MatchServer::start(uint16_t port) {
+    if (!lobby.open(port)) {
+        return false;
+    }
+    setBufferSizes(lobby.handle());
+    epoll = epoll_create1(0);
+    if (epoll < 0 || !watch(epoll, (int)lobby.handle())) {
+        printf("Unable to set up the lobby: %s!\n", strerror(errno));
+        return false;
+    }
+
+    int capacity = (options.maxMatches + options.workers - 1) / options.workers;
+    for (int i = 0; i < options.workers; i++) {
+        ServerWorker* worker = new ServerWorker(i, capacity, options);
+        workers.push_back(worker);
+        if (!worker->open((uint16_t)(port + 1 + i))) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->start();
+    }
+    return true;
+}
+
+void MatchServer::poll(int timeoutMs) {
+    epoll_event event;
+    if (epoll_wait(epoll, &event, 1, timeoutMs) > 0) {
+        int count;
+        while ((count = received.receive(lobby.handle())) > 0) {
+            for (int i = 0; i < count; i++) {
+                const unsigned char* data = received.data(i);
+                if (received.size(i) >= SERVER_JOIN_SIZE && data[0] == SERVER_JOIN && data[1] == SERVER_VERSION) {
+                    handleJoin(received.from(i), getU32(data + 2));
+                }
+            }
+        }
+    }
+
+    int64_t now = profileNow();
+    if (now - lastForget > 1000000000LL) {
+        forget(now);
+        lastForget = now;
+    }
+}
+
+void MatchServer::handleJoin(const NetAddress& from, uint32_t token) {
+    int64_t now = profileNow();
+    JoinKey key = { from.host, from.port, token };
+    std::map<JoinKey, int64_t>::iterator found = recent.find(key);
+    if (found != recent.end() && now - found->second < (int64_t)RECENT_JOIN_MS * 1000000) {
+        return;
+    }
+
+    // Saying hello again keeps a place in the queue
+    bool same = waiting && !(key < waitingKey) && !(waitingKey < key);
+    if (!waiting || same || now - waitingSince > (int64_t)WAITING_MS * 1000000) {
+        waiting = true;
+        waitingKey = key;
+        waitingSince = now;
+        return;
+    }
+
+    PendingMatch match;
+    match.address[0].host = waitingKey.host;
+    match.address[0].port = waitingKey.port;
+    match.token[0] = waitingKey.token;
+    match.address[1] = from;
+    match.token[1] = token;
+    match.seed = mixSeed(options.seed + matchesStarted);
+    waiting = false;
+
+    // The worker with the fewest matches takes it
+    ServerWorker* best = workers[0];
+    for (size_t i = 1; i < workers.size(); i++) {
+        if (workers[i]->getLoad() < best->getLoad()) {
+            best = workers[i];
+        }
+    }
+    if (!best->add(match)) {
+        turnedAway++;
+        return;
+    }
+    matchesStarted++;
+    joins += 2;
+    recent[waitingKey] = now;
+    recent[key] = now;
+}
+
+void MatchServer::forget(int64_t now) {
+    std::map<JoinKey, int64_t>::iterator it = recent.begin();
+    while (it != recent.end()) {
+        if (now - it->second >= (int64_t)RECENT_JOIN_MS * 1000000) {
+            recent.erase(it++);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void MatchServer::stop() {
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->stop();
+    }
+}
+
+int MatchServer::getWorkers() const {
+    return (int)workers.size();
+}
+
+void MatchServer::collect(std::vector<WorkerReport>& reports) {
+    reports.resize(workers.size());
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->collect(reports[i]);
+    }
+}
+
+long long MatchServer::getJoins() const {
+    return joins;
+}
+
+long long MatchServer::getTurnedAway() const {
+    return turnedAway;
+}
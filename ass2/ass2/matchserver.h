@@ -0,0 +1,267 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "net.h"
+
+// Dedicated match server
+//
+// Hosts many matches in one process with the server stepping every one of
+// them. Players say hello to the lobby port and are paired in the order they
+// arrive; each pair's match goes to the worker thread hosting the fewest.
+// Every worker owns a UDP socket, an epoll loop and a timer ticking at the
+// match rate, and steps all of its matches on each tick. Players learn their
+// worker's port from the welcome it sends them.
+//
+// Linux only: epoll, timerfd, eventfd, recvmmsg and sendmmsg.
+//
+// Packets, integers little endian:
+//   join     type, version, token (4) the player picks to tell its packets apart
+//   welcome  type, version, token (4), match (4), side (1), seed (8),
+//            team size (1), steps a second (1)
+//   input    type, match (4), side (1), sequence (4), buttons (1),
+//            frame of the newest state decoded (4)
+//   state    type, token (4), newest input sequence received (4), snapshot
+//            encoded against the newest state the player decoded
+//   end      type, token (4), score of each side (2 + 2)
+
+const int SERVER_VERSION = 2;
+
+// Port players join on, worker sockets take the ports after it
+const int DEFAULT_SERVER_PORT = 7777;
+
+// Packet types, apart from the peer to peer ones
+enum ServerMessage
+{
+    SERVER_JOIN = 16,
+    SERVER_WELCOME = 17,
+    SERVER_INPUT = 18,
+    SERVER_STATE = 19,
+    SERVER_END = 20
+};
+
+const int SERVER_JOIN_SIZE = 6;
+const int SERVER_WELCOME_SIZE = 21;
+const int SERVER_INPUT_SIZE = 15;
+const int SERVER_STATE_HEADER = 9;
+const int SERVER_END_SIZE = 9;
+
+// Largest packet the server sends, a whole state with full teams
+const int SERVER_PACKET_SLOT = 512;
+
+// A match as its player sees it
+struct ServerWelcome
+{
+    uint32_t token;
+    uint32_t match;
+    int side;
+    uint64_t seed;
+    int teamSize;
+    int rate;
+};
+
+// A state packet, the snapshot still encoded
+struct ServerState
+{
+    uint32_t token;
+    uint32_t ack;
+    const unsigned char* snapshot;
+    int snapshotSize;
+};
+
+int writeServerJoin(unsigned char* out, uint32_t token);
+int writeServerWelcome(unsigned char* out, const ServerWelcome& welcome);
+int writeServerInput(unsigned char* out, uint32_t match, int side, uint32_t sequence, unsigned char buttons, int stateFrame);
+
+// Readers return false for packets too short or of another type
+bool readServerWelcome(const unsigned char* in, int size, ServerWelcome& welcome);
+bool readServerState(const unsigned char* in, int size, ServerState& state);
+bool readServerEnd(const unsigned char* in, int size, uint32_t& token);
+
+//Send batch class
+//Collects outgoing datagrams and sends them with as few system calls as
+//possible. Packets that find the socket buffer full are dropped and counted.
+class SendBatch
+{
+public:
+    //Initializes variables; holds up to capacity packets of slotSize bytes
+    SendBatch(int capacity, int slotSize);
+
+    //Copies a packet in, sending everything held first when full
+    void add(intptr_t socket, const NetAddress& to, const unsigned char* data, int size);
+
+    //Sends every packet held
+    void flush(intptr_t socket);
+
+    //Packets and bytes sent, and packets dropped
+    long long getSent() const;
+    long long getBytes() const;
+    long long getDropped() const;
+
+private:
+    SendBatch(const SendBatch&);
+    SendBatch& operator=(const SendBatch&);
+
+    int slotSize;
+    int count;
+    std::vector<unsigned char> buffer;
+    std::vector<mmsghdr> messages;
+    std::vector<iovec> pieces;
+    std::vector<sockaddr_in> addresses;
+
+    long long sent;
+    long long bytes;
+    long long dropped;
+};
+
+//Receive batch class
+//Reads waiting datagrams many at a time
+class ReceiveBatch
+{
+public:
+    //Initializes variables; reads up to capacity packets a call
+    explicit ReceiveBatch(int capacity);
+
+    //Reads the packets waiting, returns how many, 0 when there are none
+    int receive(intptr_t socket);
+
+    const unsigned char* data(int index) const;
+    int size(int index) const;
+    NetAddress from(int index) const;
+
+private:
+    ReceiveBatch(const ReceiveBatch&);
+    ReceiveBatch& operator=(const ReceiveBatch&);
+
+    std::vector<unsigned char> buffer;
+    std::vector<mmsghdr> messages;
+    std::vector<iovec> pieces;
+    std::vector<sockaddr_in> addresses;
+};
+
+struct ServerOptions
+{
+    //Initializes variables
+    ServerOptions();
+
+    // Steps a second and worker threads
+    int rate;
+    int workers;
+
+    // Most matches hosted at once over all workers
+    int maxMatches;
+
+    int teamSize;
+
+    // Length of a match
+    int matchSeconds;
+
+    // Match seeds are drawn from this
+    uint64_t seed;
+
+    // Keep each worker on one core
+    bool pin;
+};
+
+// What a worker did since it was last asked
+struct WorkerReport
+{
+    //Initializes variables
+    WorkerReport();
+
+    //Adds another report's figures to these
+    void merge(const WorkerReport& other);
+
+    int matches;
+
+    // Steps run on every match; late wakeups run more than one
+    long long ticks;
+
+    // Ticks skipped because the worker fell too far behind
+    long long missed;
+
+    long long packetsIn;
+    long long packetsOut;
+    long long bytesOut;
+    long long sendDropped;
+
+    // Thread CPU time spent
+    int64_t cpuNanoseconds;
+
+    // Every tick: milliseconds from when it was due until its last packet was
+    // sent, and the CPU milliseconds it took
+    std::vector<float> tickMs;
+    std::vector<float> tickCpuMs;
+};
+
+class ServerWorker;
+
+//Match server class
+//The lobby runs on the thread calling poll, matches on the worker threads
+class MatchServer
+{
+public:
+    //Initializes variables
+    explicit MatchServer(const ServerOptions& options);
+
+    //Stops the workers
+    ~MatchServer();
+
+    //Opens the lobby on port and the workers on the ports after it and
+    //starts the workers
+    bool start(uint16_t port);
+
+    //Pairs up players who said hello, waiting up to timeoutMs for them
+    void poll(int timeoutMs);
+
+    //Stops the workers and waits for them to finish
+    void stop();
+
+    int getWorkers() const;
+
+    //Takes each worker's figures since the last call
+    void collect(std::vector<WorkerReport>& reports);
+
+    //Players joined, and pairs turned away because every worker was full
+    long long getJoins() const;
+    long long getTurnedAway() const;
+
+private:
+    MatchServer(const MatchServer&);
+    MatchServer& operator=(const MatchServer&);
+
+    struct JoinKey
+    {
+        uint32_t host;
+        uint16_t port;
+        uint32_t token;
+
+        bool operator<(const JoinKey& other) const;
+    };
+
+    void handleJoin(const NetAddress& from, uint32_t token);
+    void forget(int64_t now);
+
+    ServerOptions options;
+    UdpSocket lobby;
+    int epoll;
+    std::vector<ServerWorker*> workers;
+    ReceiveBatch received;
+
+    // Player waiting for an opponent, and when it last said hello
+    bool waiting;
+    JoinKey waitingKey;
+    int64_t waitingSince;
+
+    // Players recently given a match, whose repeated hellos are ignored
+    std::map<JoinKey, int64_t> recent;
+    int64_t lastForget;
+
+    uint64_t matchesStarted;
+    long long joins;
+    long long turnedAway;
+};
@@ -0,0 +1,215 @@
+#include "media.h"
+#include <SDL_image.h>
+#include <cstdio>
+#include "simthread.h"
+
+const char* const SPRITE_FILES[SPRITE_FILE_COUNT] = {
+    "assets/img/player1.png",
+    "assets/img/player1GK.png",
+    "assets/img/player2.png",
+    "assets/img/player2GK.png",
+    "assets/img/ball.png"
+};
+
+bool addGameSprites(SpriteAtlas& atlas, Font& font, GameSprites& sprites, SDL_Surface* const* decoded) {
+    // Loading success flag
+    bool success = true;
+
+    // Load player and ball sprites
+    int ids[SPRITE_FILE_COUNT];
+    for (int i = 0; i < SPRITE_FILE_COUNT; i++) {
+        ids[i] = decoded != NULL ? atlas.add(decoded[i]) : atlas.addFile(SPRITE_FILES[i]);
+        if (ids[i] < 0)
+        {
+            printf("Failed to load %s sprite!\n", SPRITE_FILES[i]);
+            success = false;
+        }
+    }
+    for (int side = 0; side < 2; side++) {
+        for (int role = 0; role < 2; role++) {
+            sprites.player[side][role] = ids[side * 2 + role];
+        }
+    }
+    sprites.ball = ids[4];
+
+    // Bake menu and score glyphs into the same atlas
+    if (!font.loadFromFile(atlas, FONT_FILE, FONT_SIZES))
+    {
+        printf("Failed to load font!\n");
+        success = false;
+    }
+
+    return success;
+}
+
+bool loadLooseMedia(SDL_Renderer* renderer, SDL_Texture*& background, SpriteAtlas& atlas, Font& font, GameSprites& sprites) {
+    background = IMG_LoadTexture(renderer, BACKGROUND_FILE);
+    if (background == NULL) {
+        printf("Unable to load texture from %s! SDL Error: %s\n", BACKGROUND_FILE, SDL_GetError());
+        return false;
+    }
+    if (!addGameSprites(atlas, font, sprites) || !atlas.build(renderer)) {
+        printf("Failed to build sprite atlas!\n");
+        return false;
+    }
+    return true;
+}
+
+// Position of a body alpha of the way from the previous step to the current one
+static int blend(const std::vector<int>& previous, const std::vector<int>& current, int i, float alpha) {
+    return previous[i] + (int)((current[i] - previous[i]) * alpha + 0.5f);
+}
+
+MatchView::MatchView(int width, int height) : dirty(width, height) {
+    //Initialize
+    this->width = width;
+    this->height = height;
+    renderer = NULL;
+    background = NULL;
+    atlas = NULL;
+    batch = NULL;
+    font = NULL;
+    sprites = GameSprites();
+    keepsFrame = false;
+    fullRedraw = true;
+    fill = 0;
+}
+
+MatchView::~MatchView() {
+    free();
+}
+
+bool MatchView::create(SDL_Renderer* renderer, SDL_Texture* background, const SpriteAtlas* atlas, SpriteBatch* batch,
+    const Font* font, const GameSprites& sprites, bool keepsFrame) {
+    this->renderer = renderer;
+    this->background = background;
+    this->atlas = atlas;
+    this->batch = batch;
+    this->font = font;
+    this->sprites = sprites;
+    this->keepsFrame = keepsFrame;
+    fullRedraw = true;
+    return stageLayer.create(renderer, width, height);
+}
+
+void MatchView::free() {
+    stageLayer.free();
+}
+
+void MatchView::redrawAll() {
+    fullRedraw = true;
+}
+
+void MatchView::invalidateStage() {
+    stageLayer.invalidate();
+}
+
+int MatchView::getFill() const {
+    return fill;
+}
+
+void MatchView::renderStage() {
+    SDL_RenderCopy(renderer, background, NULL, NULL);
+
+    batch->begin(atlas);
+    score1Label.render(*batch, *font, FONT_LARGE, 500, 30);
+    score2Label.render(*batch, *font, FONT_LARGE, 740, 30);
+    batch->flush(renderer);
+}
+
+void MatchView::render(const MatchSnapshot& shown, float alpha, const SDL_Rect* overlay) {
+    // Redraw the cached stage when a score changed
+    bool scoresChanged = score1Label.setValue(shown.score1);
+    scoresChanged = score2Label.setValue(shown.score2) || scoresChanged;
+    if (scoresChanged) {
+        stageLayer.invalidate();
+    }
+    if (stageLayer.isCreated() && !stageLayer.isValid()) {
+        stageLayer.beginRedraw(renderer);
+        renderStage();
+        stageLayer.endRedraw(renderer);
+        fullRedraw = true;
+    }
+
+    // Where each body is drawn this frame
+    int count = (int)shown.x.size();
+    bodySprites.resize(count);
+    bodyRects.resize(count);
+    std::vector<SDL_Rect>& rects = bodyRects;
+    for (int i = 0; i < count; i++) {
+        bodySprites[i] = i == shown.ball ? sprites.ball : sprites.player[shown.team[i]][shown.role[i]];
+        const SDL_Rect& sprite = atlas->rect(bodySprites[i]);
+        rects[i].x = blend(shown.previousX, shown.x, i, alpha) - sprite.w / 2;
+        rects[i].y = blend(shown.previousY, shown.y, i, alpha) - sprite.h / 2;
+        rects[i].w = sprite.w;
+        rects[i].h = sprite.h;
+    }
+
+    // Only bodies that moved and the overlay change when the screen keeps the last frame
+    dirty.clear();
+    if (!keepsFrame || fullRedraw || !stageLayer.isCreated() || (int)drawnRects.size() != count) {
+        dirty.addAll();
+    }
+    else {
+        for (int i = 0; i < count; i++) {
+            const SDL_Rect& drawn = drawnRects[i];
+            if (drawn.x != rects[i].x || drawn.y != rects[i].y) {
+                dirty.add(drawn);
+                dirty.add(rects[i]);
+            }
+        }
+        if (overlay != NULL) {
+            dirty.add(*overlay);
+        }
+    }
+    fullRedraw = false;
+
+    // Put the stage back under the changed areas
+    fill = 0;
+    if (!stageLayer.isCreated()) {
+        SDL_RenderClear(renderer);
+        renderStage();
+        fill = width * height;
+    }
+    else if (dirty.isFull()) {
+        stageLayer.copy(renderer, NULL);
+        fill = width * height;
+    }
+    else {
+        const std::vector<SDL_Rect>& changed = dirty.getRects();
+        for (size_t r = 0; r < changed.size(); r++) {
+            stageLayer.copy(renderer, &changed[r]);
+        }
+        fill = dirty.area();
+    }
+
+    // Render the players and ball in one batch when everything changed
+    if (dirty.isFull()) {
+        batch->begin(atlas);
+        for (int i = 0; i < count; i++) {
+            batch->draw(bodySprites[i], rects[i].x, rects[i].y);
+            fill += rects[i].w * rects[i].h;
+        }
+        batch->flush(renderer);
+    }
+    // Otherwise once for each changed area, clipped to it: outside it the
+    // last frame still holds the bodies, whose edges would blend twice and
+    // which would end up under one drawn after them
+    else {
+        const std::vector<SDL_Rect>& changed = dirty.getRects();
+        for (size_t r = 0; r < changed.size(); r++) {
+            batch->begin(atlas);
+            for (int i = 0; i < count; i++) {
+                SDL_Rect overlap;
+                if (SDL_IntersectRect(&rects[i], &changed[r], &overlap)) {
+                    batch->draw(bodySprites[i], rects[i].x, rects[i].y);
+                    fill += overlap.w * overlap.h;
+                }
+            }
+            SDL_RenderSetClipRect(renderer, &changed[r]);
+            batch->flush(renderer);
+        }
+        SDL_RenderSetClipRect(renderer, NULL);
+    }
+    drawnRects.swap(rects);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <SDL.h>
+#include <vector>
+#include "layers.h"
+#include "sprites.h"
+#include "text.h"
+
+struct MatchSnapshot;
+
+// Screen the game draws
+const int SCREEN_WIDTH = 1280;
+const int SCREEN_HEIGHT = 960;
+
+// Scratch memory for data that lives one frame, grown if a frame needs more
+const size_t FRAME_ARENA_BYTES = 64 * 1024;
+
+// Game assets, as loose files and as the pack built from them by packassets
+const char* const BACKGROUND_FILE = "assets/img/bg.png";
+const char* const FONT_FILE = "assets/font/font.ttf";
+const char* const ASSET_PACK_FILE = "assets/assets.pack";
+
+// Menu and score font sizes
+const int FONT_SIZES[FONT_FACES] = { 32, 64 };
+
+// Entry names inside the pack
+const char* const PACK_BACKGROUND = "background";
+const char* const PACK_ATLAS = "atlas";
+const char* const PACK_ATLAS_RECTS = "atlas.rects";
+const char* const PACK_FONT = "font";
+const char* const PACK_SPRITES = "sprites";
+
+// Sprites drawn during a match
+struct GameSprites
+{
+    // Outfield player and goal keeper of each side
+    int player[2][2];
+    int ball;
+};
+
+// Match sprite files: outfield player and goal keeper of each side, then the ball
+const int SPRITE_FILE_COUNT = 5;
+extern const char* const SPRITE_FILES[SPRITE_FILE_COUNT];
+
+// Queues the match sprites and the font glyphs
+// decoded holds SPRITE_FILE_COUNT surfaces already loaded from SPRITE_FILES,
+// which the atlas takes; without it the files are loaded here. The atlas
+// still has to be built or composed afterwards
+bool addGameSprites(SpriteAtlas& atlas, Font& font, GameSprites& sprites, SDL_Surface* const* decoded = NULL);
+
+// Loads the background and builds the atlas of the match sprites and glyphs
+// from the loose files, for tools that draw matches; the caller frees them
+bool loadLooseMedia(SDL_Renderer* renderer, SDL_Texture*& background, SpriteAtlas& atlas, Font& font, GameSprites& sprites);
+
+//Match view class
+//Draws a match from its snapshots: the pitch and the scores, cached in a layer
+//when the renderer has render targets, under the players and ball blended
+//between the last two steps. When the screen keeps the last frame, as with
+//the software renderer, only the areas that changed are drawn again
+class MatchView
+{
+public:
+    //Initializes variables for a screen of the given size
+    MatchView(int width, int height);
+
+    //Frees the stage layer
+    ~MatchView();
+
+    //Draws with the given renderer, background, atlas, batch and font from
+    //now on, which must outlive the view, and creates the stage layer
+    //False if there are no render targets, the stage is then drawn every frame
+    bool create(SDL_Renderer* renderer, SDL_Texture* background, const SpriteAtlas* atlas, SpriteBatch* batch, const Font* font,
+        const GameSprites& sprites, bool keepsFrame);
+
+    //Frees the stage layer
+    void free();
+
+    //Draws the whole screen next frame, after the window lost its contents
+    void redrawAll();
+
+    //Draws the stage again next frame, after its render target was lost
+    void invalidateStage();
+
+    //Draws the match alpha of the way from the step before shown to shown
+    //overlay is an area drawn over the match after it, redrawn every frame,
+    //or NULL
+    void render(const MatchSnapshot& shown, float alpha, const SDL_Rect* overlay);
+
+    //Pixels written by the last frame
+    int getFill() const;
+
+private:
+    MatchView(const MatchView&);
+    MatchView& operator=(const MatchView&);
+
+    //Draws everything that does not move: the pitch and the scores
+    void renderStage();
+
+    int width;
+    int height;
+    SDL_Renderer* renderer;
+    SDL_Texture* background;
+    const SpriteAtlas* atlas;
+    SpriteBatch* batch;
+    const Font* font;
+    GameSprites sprites;
+
+    // Background and scores, redrawn only when a score changes
+    CachedLayer stageLayer;
+    NumberLabel score1Label;
+    NumberLabel score2Label;
+
+    // Screen areas to redraw this frame, where each body is drawn this frame
+    // and where it was drawn last frame
+    DirtyRegion dirty;
+    std::vector<int> bodySprites;
+    std::vector<SDL_Rect> bodyRects;
+    std::vector<SDL_Rect> drawnRects;
+
+    bool keepsFrame;
+    bool fullRedraw;
+    int fill;
+};
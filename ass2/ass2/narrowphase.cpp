@@ -0,0 +1,168 @@
+#include "narrowphase.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NARROWPHASE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 code is compiled for this function only and picked at run time
+#if defined(NARROWPHASE_X86) && defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Fills in the contact of a touching pair
+static inline void writeContact(Contact& contact, int a, int b, float dx, float dy, float distance, float radiusSum) {
+    contact.a = a;
+    contact.b = b;
+    if (distance > 0.0f) {
+        contact.nx = dx / distance;
+        contact.ny = dy / distance;
+    }
+    else {
+        contact.nx = 0.0f;
+        contact.ny = 0.0f;
+    }
+    contact.depth = radiusSum - distance;
+}
+
+static int scalarRange(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int begin, int end, Contact* contacts) {
+    int count = 0;
+    for (int p = begin; p < end; p++) {
+        int a = pairs[p].a;
+        int b = pairs[p].b;
+        int dx = x[a] - x[b];
+        int dy = y[a] - y[b];
+        int radiusSum = radius[a] + radius[b];
+        int distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared < radiusSum * radiusSum) {
+            writeContact(contacts[count++], a, b, (float)dx, (float)dy, sqrtf((float)distanceSquared), (float)radiusSum);
+        }
+    }
+    return count;
+}
+
+int findContactsScalar(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int pairCount, Contact* contacts) {
+    return scalarRange(x, y, radius, pairs, 0, pairCount, contacts);
+}
+
+#ifdef NARROWPHASE_X86
+
+// Four pairs at a time
+// Squares stay exact in floats while coordinates are below 2^11
+static int sse2Kernel(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int pairCount, Contact* contacts) {
+    int count = 0;
+    int p = 0;
+    for (; p + 4 <= pairCount; p += 4) {
+        const CandidatePair* q = pairs + p;
+        __m128 dx = _mm_cvtepi32_ps(_mm_setr_epi32(x[q[0].a] - x[q[0].b], x[q[1].a] - x[q[1].b], x[q[2].a] - x[q[2].b], x[q[3].a] - x[q[3].b]));
+        __m128 dy = _mm_cvtepi32_ps(_mm_setr_epi32(y[q[0].a] - y[q[0].b], y[q[1].a] - y[q[1].b], y[q[2].a] - y[q[2].b], y[q[3].a] - y[q[3].b]));
+        __m128 radiusSum = _mm_cvtepi32_ps(_mm_setr_epi32(radius[q[0].a] + radius[q[0].b], radius[q[1].a] + radius[q[1].b], radius[q[2].a] + radius[q[2].b], radius[q[3].a] + radius[q[3].b]));
+
+        __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        int hits = _mm_movemask_ps(_mm_cmplt_ps(distanceSquared, _mm_mul_ps(radiusSum, radiusSum)));
+        if (hits == 0) {
+            continue;
+        }
+
+        float lanes[4][4];
+        _mm_storeu_ps(lanes[0], dx);
+        _mm_storeu_ps(lanes[1], dy);
+        _mm_storeu_ps(lanes[2], _mm_sqrt_ps(distanceSquared));
+        _mm_storeu_ps(lanes[3], radiusSum);
+        for (int i = 0; i < 4; i++) {
+            if (hits & (1 << i)) {
+                writeContact(contacts[count++], q[i].a, q[i].b, lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i]);
+            }
+        }
+    }
+    return count + scalarRange(x, y, radius, pairs, p, pairCount, contacts + count);
+}
+
+// Eight pairs at a time, gathering positions straight from the arrays
+TARGET_AVX2 static int avx2Kernel(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int pairCount, Contact* contacts) {
+    int count = 0;
+    int p = 0;
+
+    // Splits interleaved a, b indices into a 0-3 | b 0-3 in each register
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    for (; p + 8 <= pairCount; p += 8) {
+        const CandidatePair* q = pairs + p;
+        __m256i low = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)q), split);
+        __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(q + 4)), split);
+        __m256i a = _mm256_permute2x128_si256(low, high, 0x20);
+        __m256i b = _mm256_permute2x128_si256(low, high, 0x31);
+
+        __m256 dx = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_i32gather_epi32(x, a, 4), _mm256_i32gather_epi32(x, b, 4)));
+        __m256 dy = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_i32gather_epi32(y, a, 4), _mm256_i32gather_epi32(y, b, 4)));
+        __m256 radiusSum = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_i32gather_epi32(radius, a, 4), _mm256_i32gather_epi32(radius, b, 4)));
+
+        // Multiply and add separately so results match the scalar kernel
+        __m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        int hits = _mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, _mm256_mul_ps(radiusSum, radiusSum), _CMP_LT_OQ));
+        if (hits == 0) {
+            continue;
+        }
+
+        float lanes[4][8];
+        _mm256_storeu_ps(lanes[0], dx);
+        _mm256_storeu_ps(lanes[1], dy);
+        _mm256_storeu_ps(lanes[2], _mm256_sqrt_ps(distanceSquared));
+        _mm256_storeu_ps(lanes[3], radiusSum);
+        for (int i = 0; i < 8; i++) {
+            if (hits & (1 << i)) {
+                writeContact(contacts[count++], q[i].a, q[i].b, lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i]);
+            }
+        }
+    }
+    return count + scalarRange(x, y, radius, pairs, p, pairCount, contacts + count);
+}
+
+static bool hasAvx2() {
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+typedef int (*Kernel)(const int*, const int*, const int*, const CandidatePair*, int, Contact*);
+
+static Kernel pickKernel(const char** name) {
+#ifdef NARROWPHASE_X86
+    if (hasAvx2()) {
+        *name = "avx2";
+        return avx2Kernel;
+    }
+    *name = "sse2";
+    return sse2Kernel;
+#else
+    *name = "scalar";
+    return findContactsScalar;
+#endif
+}
+
+static const char* kernelName = "scalar";
+static const Kernel kernel = pickKernel(&kernelName);
+
+int findContacts(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int pairCount, Contact* contacts) {
+    return kernel(x, y, radius, pairs, pairCount, contacts);
+}
+
+const char* narrowphaseKernel() {
+    return kernelName;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "grid.h"
+
+// Two overlapping bodies
+// The normal points from b to a; depth is how far the circles overlap
+struct Contact
+{
+    int a;
+    int b;
+    float nx;
+    float ny;
+    float depth;
+};
+
+// Batched circle narrowphase
+// Tests every candidate pair against packed position and radius arrays by
+// comparing squared distances, so only touching pairs pay for a square root.
+// Writes one contact per touching pair, in pair order, and returns how many
+// were written; contacts must have room for pairCount entries. Uses AVX2 or
+// SSE2 when the CPU has them. Results match the scalar kernel exactly for
+// coordinates within the pitch.
+int findContacts(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int pairCount, Contact* contacts);
+
+// Same as findContacts without SIMD
+int findContactsScalar(const int* x, const int* y, const int* radius, const CandidatePair* pairs, int pairCount, Contact* contacts);
+
+// Name of the kernel findContacts uses on this machine
+const char* narrowphaseKernel();
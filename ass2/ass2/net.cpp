@@ -0,0 +1,240 @@
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "profiler.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef int socklen_t;
+typedef SOCKET NativeSocket;
+static const intptr_t NO_SOCKET = (intptr_t)INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NativeSocket;
+static const intptr_t NO_SOCKET = -1;
+#endif
+
+// Winsock has to be started once before the first socket
+static bool startSockets() {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            printf("Unable to start Winsock!\n");
+            return false;
+        }
+        started = true;
+    }
+#endif
+    return true;
+}
+
+static sockaddr_in toSockaddr(const NetAddress& address) {
+    sockaddr_in result;
+    memset(&result, 0, sizeof(result));
+    result.sin_family = AF_INET;
+    result.sin_addr.s_addr = htonl(address.host);
+    result.sin_port = htons(address.port);
+    return result;
+}
+
+bool parseAddress(const char* text, NetAddress& address) {
+    std::string host = "127.0.0.1";
+    const char* port = text;
+    const char* colon = strrchr(text, ':');
+    if (colon != NULL) {
+        host.assign(text, colon - text);
+        port = colon + 1;
+    }
+
+    char* end;
+    long number = strtol(port, &end, 10);
+    if (*port == '\0' || *end != '\0' || number <= 0 || number > 65535) {
+        printf("Bad port in %s!\n", text);
+        return false;
+    }
+
+    if (!startSockets()) {
+        return false;
+    }
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = NULL;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &found) != 0 || found == NULL) {
+        printf("Unable to resolve %s!\n", host.c_str());
+        return false;
+    }
+    address.host = ntohl(((sockaddr_in*)found->ai_addr)->sin_addr.s_addr);
+    address.port = (uint16_t)number;
+    freeaddrinfo(found);
+    return true;
+}
+
+bool sameAddress(const NetAddress& a, const NetAddress& b) {
+    return a.host == b.host && a.port == b.port;
+}
+
+UdpSocket::UdpSocket() {
+    //Initialize
+    socketHandle = NO_SOCKET;
+    port = 0;
+}
+
+UdpSocket::~UdpSocket() {
+    close();
+}
+
+bool UdpSocket::open(uint16_t localPort) {
+    //Get rid of preexisting socket
+    close();
+    if (!startSockets()) {
+        return false;
+    }
+
+    socketHandle = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socketHandle == NO_SOCKET) {
+        printf("Unable to create socket!\n");
+        return false;
+    }
+
+    NetAddress any = { INADDR_ANY, localPort };
+    sockaddr_in bound = toSockaddr(any);
+    if (bind((NativeSocket)socketHandle, (sockaddr*)&bound, sizeof(bound)) != 0) {
+        printf("Unable to bind UDP port %d!\n", localPort);
+        close();
+        return false;
+    }
+
+    // Never block the caller, whoever polls decides when to wait
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket((NativeSocket)socketHandle, FIONBIO, &nonBlocking);
+#else
+    fcntl((NativeSocket)socketHandle, F_SETFL, fcntl((NativeSocket)socketHandle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    socklen_t length = sizeof(bound);
+    getsockname((NativeSocket)socketHandle, (sockaddr*)&bound, &length);
+    port = ntohs(bound.sin_port);
+    return true;
+}
+
+void UdpSocket::close() {
+    if (socketHandle != NO_SOCKET) {
+#ifdef _WIN32
+        closesocket((NativeSocket)socketHandle);
+#else
+        ::close((NativeSocket)socketHandle);
+#endif
+        socketHandle = NO_SOCKET;
+        port = 0;
+    }
+}
+
+bool UdpSocket::isOpen() const {
+    return socketHandle != NO_SOCKET;
+}
+
+uint16_t UdpSocket::localPort() const {
+    return port;
+}
+
+bool UdpSocket::send(const NetAddress& to, const void* data, int size) {
+    sockaddr_in address = toSockaddr(to);
+    return sendto((NativeSocket)socketHandle, (const char*)data, size, 0, (sockaddr*)&address, sizeof(address)) == size;
+}
+
+int UdpSocket::receive(void* data, int capacity, NetAddress& from) {
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    int size = (int)recvfrom((NativeSocket)socketHandle, (char*)data, capacity, 0, (sockaddr*)&address, &length);
+    if (size < 0) {
+        return -1;
+    }
+    from.host = ntohl(address.sin_addr.s_addr);
+    from.port = ntohs(address.sin_port);
+    return size;
+}
+
+intptr_t UdpSocket::handle() const {
+    return socketHandle;
+}
+
+NetLink::NetLink(UdpSocket& linkSocket, const NetAddress& linkPeer, const LinkConditions& linkConditions, uint64_t seed) : socket(linkSocket) {
+    //Initialize
+    peer = linkPeer;
+    conditions = linkConditions;
+    seedRng(rng, seed, 0);
+    sent = 0;
+    dropped = 0;
+}
+
+void NetLink::send(const void* data, int size) {
+    sent++;
+    if (conditions.lossPercent > 0 && randomRange(rng, 0, 99) < conditions.lossPercent) {
+        dropped++;
+        return;
+    }
+    if (conditions.delayMs <= 0 && conditions.jitterMs <= 0) {
+        socket.send(peer, data, size);
+        return;
+    }
+
+    int delayMs = conditions.delayMs;
+    if (conditions.jitterMs > 0) {
+        delayMs += randomRange(rng, 0, conditions.jitterMs);
+    }
+    Delayed packet;
+    packet.due = profileNow() + (int64_t)delayMs * 1000000;
+    packet.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    delayed.push_back(packet);
+}
+
+void NetLink::flush(int64_t now) {
+    // Packets due at the same time leave in the order they were sent
+    size_t kept = 0;
+    for (size_t i = 0; i < delayed.size(); i++) {
+        if (delayed[i].due <= now) {
+            socket.send(peer, delayed[i].data.data(), (int)delayed[i].data.size());
+        }
+        else {
+            if (kept != i) {
+                delayed[kept].due = delayed[i].due;
+                delayed[kept].data.swap(delayed[i].data);
+            }
+            kept++;
+        }
+    }
+    delayed.resize(kept);
+}
+
+int NetLink::receive(void* data, int capacity) {
+    NetAddress from;
+    for (;;) {
+        int size = socket.receive(data, capacity, from);
+        if (size < 0 || sameAddress(from, peer)) {
+            return size;
+        }
+        // Strangers are ignored
+    }
+}
+
+long long NetLink::getSent() const {
+    return sent;
+}
+
+long long NetLink::getDropped() const {
+    return dropped;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "rng.h"
+
+// UDP transport
+// Non-blocking sockets plus a link that can delay, reorder and drop outgoing
+// packets, so network play can be tried over loopback under bad conditions
+
+// Largest datagram sent or received
+const int MAX_PACKET = 1200;
+
+// Little endian integers in packets
+inline void putU16(unsigned char* out, uint16_t value) {
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+}
+
+inline uint16_t getU16(const unsigned char* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+inline void putU32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (unsigned char)(value >> (i * 8));
+    }
+}
+
+inline uint32_t getU32(const unsigned char* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+inline void putU64(unsigned char* out, uint64_t value) {
+    putU32(out, (uint32_t)value);
+    putU32(out + 4, (uint32_t)(value >> 32));
+}
+
+inline uint64_t getU64(const unsigned char* in) {
+    return (uint64_t)getU32(in) | ((uint64_t)getU32(in + 4) << 32);
+}
+
+// IPv4 address and port, both in host byte order
+struct NetAddress
+{
+    uint32_t host;
+    uint16_t port;
+};
+
+// Reads "host:port" or a bare port, which means this machine
+bool parseAddress(const char* text, NetAddress& address);
+
+bool sameAddress(const NetAddress& a, const NetAddress& b);
+
+//UDP socket class
+//A non-blocking socket bound to one local port
+class UdpSocket
+{
+public:
+    //Initializes variables
+    UdpSocket();
+
+    //Closes the socket
+    ~UdpSocket();
+
+    //Binds to a port on every interface, 0 picks a free one
+    bool open(uint16_t port);
+
+    void close();
+
+    bool isOpen() const;
+
+    //Port the socket is bound to
+    uint16_t localPort() const;
+
+    //Sends one datagram, false if the system refused it
+    bool send(const NetAddress& to, const void* data, int size);
+
+    //Reads the next waiting datagram, -1 when there is none
+    int receive(void* data, int capacity, NetAddress& from);
+
+    //The system handle, for waiting on several sockets at once
+    intptr_t handle() const;
+
+private:
+    UdpSocket(const UdpSocket&);
+    UdpSocket& operator=(const UdpSocket&);
+
+    intptr_t socketHandle;
+    uint16_t port;
+};
+
+// Conditions a link imposes on the packets it sends
+struct LinkConditions
+{
+    // One-way delay, and how much each packet's delay varies on top of it
+    int delayMs;
+    int jitterMs;
+
+    // Share of packets lost
+    int lossPercent;
+};
+
+//Net link class
+//Talks to one peer over a socket. Outgoing packets can be held back and
+//dropped to imitate a bad connection; jitter can reorder them like a real one.
+class NetLink
+{
+public:
+    //Initializes variables; seed drives which packets are delayed or lost
+    NetLink(UdpSocket& socket, const NetAddress& peer, const LinkConditions& conditions, uint64_t seed);
+
+    //Sends a packet now, later or never, depending on the conditions
+    void send(const void* data, int size);
+
+    //Sends the held back packets that are due, now in profiler clock nanoseconds
+    void flush(int64_t now);
+
+    //Reads the next packet from the peer, -1 when there is none
+    int receive(void* data, int capacity);
+
+    //Packets handed to send, and of those the ones dropped
+    long long getSent() const;
+    long long getDropped() const;
+
+private:
+    struct Delayed
+    {
+        int64_t due;
+        std::vector<unsigned char> data;
+    };
+
+    UdpSocket& socket;
+    NetAddress peer;
+    LinkConditions conditions;
+    Rng rng;
+
+    std::vector<Delayed> delayed;
+    long long sent;
+    long long dropped;
+};
@@ -0,0 +1,260 @@
+// Plays an online match between two bots to try rollback network play
+//
+// Usage: netplay --pair [options]
+//        netplay --host PORT [options]
+//        netplay --join HOST:PORT [options]
+// --pair plays both peers in this process over loopback and checks they end
+// up with the same match; --host and --join play one peer each, for two
+// processes or two machines.
+//
+// Options: --frames N      frames to play (600)
+//          --delay MS      one-way delay added to every packet sent (0)
+//          --jitter MS     up to this much more delay per packet (0)
+//          --loss PERCENT  packets sent that are dropped (0)
+//          --input-delay N frames local input is held back (2)
+//          --team-size S   players a side (2)
+//          --seed X        match seed, from the host
+// The bots change buttons at random, so the peers mispredict each other often.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "rollback.h"
+
+// Steps a second, as in the game
+const int RATE = 60;
+
+// Waits for the other peer
+const int HOST_TIMEOUT_MS = 30000;
+const int JOIN_TIMEOUT_MS = 10000;
+
+// Time allowed after the last frame for the last inputs to get through, and
+// time spent after it in any case
+const int LINGER_MS = 5000;
+const int LINGER_MIN_MS = 500;
+
+// Chance in a hundred that a bot changes its buttons on a frame
+const int BOT_CHANGE_PERCENT = 10;
+
+struct Options
+{
+    int frames;
+    LinkConditions conditions;
+    int inputDelay;
+    int teamSize;
+    uint64_t seed;
+};
+
+// What one peer ended up with
+struct PeerResult
+{
+    bool played;
+    uint64_t checksum;
+    int confirmed;
+};
+
+// Buttons of a bot that holds a direction for a while, then picks another
+static PlayerInput botInput(Rng& rng, PlayerInput& held) {
+    if (randomRange(rng, 0, 99) < BOT_CHANGE_PERCENT) {
+        held.buttons = (unsigned char)randomRange(rng, 0, INPUT_UP | INPUT_DOWN | INPUT_LEFT | INPUT_RIGHT);
+        if (randomRange(rng, 0, 3) == 0) {
+            held.buttons |= INPUT_SWITCH;
+        }
+    }
+    PlayerInput input = held;
+    held.buttons &= ~INPUT_SWITCH;
+    return input;
+}
+
+// Plays one side of the match on an open socket already talking to peer
+static PeerResult playPeer(UdpSocket& socket, const NetAddress& peer, const ReplayHeader& setup, int side, const Options& options, bool host) {
+    PeerResult result = { false, 0, -1 };
+    MatchState match;
+    initMatch(match, setup.control[0], setup.control[1], setup.teamSize, setup.seed);
+    NetLink link(socket, peer, options.conditions, mixSeed(setup.seed) + side);
+    RollbackSession session(match, side, options.inputDelay, link);
+    if (host) {
+        session.setWelcome(setup);
+    }
+
+    Rng rng;
+    seedRng(rng, setup.seed, 100 + side);
+    PlayerInput held = { 0 };
+    PlayerInput input = botInput(rng, held);
+
+    // Step at the game's rate, polling the network in between
+    const int64_t interval = 1000000000LL / RATE;
+    int64_t start = profileNow();
+    int64_t due = start;
+    while (session.getFrame() < options.frames) {
+        session.poll();
+        int64_t now = profileNow();
+        if (now < due) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        due += interval;
+
+        // A frame held back keeps the bot's input for the next try
+        if (session.advance(input)) {
+            input = botInput(rng, held);
+        }
+    }
+
+    // Keep talking until both sides have every input, or give up; a little
+    // longer in any case so the peer hears the last acknowledgements too
+    int64_t lingerMin = profileNow() + (int64_t)LINGER_MIN_MS * 1000000;
+    int64_t lingerEnd = profileNow() + (int64_t)LINGER_MS * 1000000;
+    while ((session.getConfirmedFrame() < options.frames - 1 || !session.peerHasInputsUpTo(options.frames - 1) || profileNow() < lingerMin)
+        && profileNow() < lingerEnd) {
+        session.poll();
+        if (profileNow() >= due) {
+            session.sendInputs();
+            due += interval;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = (profileNow() - start) / 1e9;
+
+    result.confirmed = session.getConfirmedFrame();
+    result.played = result.confirmed >= options.frames - 1;
+    result.checksum = checksumState(session.confirmedState());
+
+    printf("side %d: %d frames in %.1f s, %lld packets sent, %lld dropped, final state %016llx\n", side, session.getFrame(), seconds,
+        link.getSent(), link.getDropped(), (unsigned long long)result.checksum);
+    printRollbackStats(session.getStats(), 1000.0 / RATE);
+    if (!result.played) {
+        printf("side %d: only confirmed up to frame %d of %d\n", side, result.confirmed, options.frames);
+    }
+    return result;
+}
+
+static ReplayHeader setupFor(const Options& options) {
+    ReplayHeader setup;
+    setup.seed = options.seed;
+    setup.teamSize = options.teamSize;
+    setup.control[0] = CONTROL_HUMAN;
+    setup.control[1] = CONTROL_HUMAN;
+    return setup;
+}
+
+static PeerResult host(uint16_t port, const Options& options) {
+    PeerResult failed = { false, 0, -1 };
+    UdpSocket socket;
+    NetAddress peer;
+    ReplayHeader setup = setupFor(options);
+    if (!socket.open(port) || !hostMatch(socket, setup, HOST_TIMEOUT_MS, peer)) {
+        return failed;
+    }
+    return playPeer(socket, peer, setup, 0, options, true);
+}
+
+static PeerResult join(const NetAddress& address, const Options& options) {
+    PeerResult failed = { false, 0, -1 };
+    UdpSocket socket;
+    ReplayHeader setup;
+    if (!socket.open(0) || !joinMatch(socket, address, JOIN_TIMEOUT_MS, setup)) {
+        return failed;
+    }
+    return playPeer(socket, address, setup, 1, options, false);
+}
+
+int main(int argc, char* args[]) {
+    Options options;
+    options.frames = 600;
+    options.conditions.delayMs = 0;
+    options.conditions.jitterMs = 0;
+    options.conditions.lossPercent = 0;
+    options.inputDelay = 2;
+    options.teamSize = DEFAULT_TEAM_SIZE;
+    options.seed = randomSeed();
+
+    bool pair = false;
+    int hostPort = 0;
+    const char* joinAddress = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--pair") == 0) {
+            pair = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            break;
+        }
+        if (strcmp(args[i], "--host") == 0) {
+            hostPort = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--join") == 0) {
+            joinAddress = args[++i];
+        }
+        else if (strcmp(args[i], "--frames") == 0) {
+            options.frames = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--delay") == 0) {
+            options.conditions.delayMs = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--jitter") == 0) {
+            options.conditions.jitterMs = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--loss") == 0) {
+            options.conditions.lossPercent = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--input-delay") == 0) {
+            options.inputDelay = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--team-size") == 0) {
+            options.teamSize = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--seed") == 0) {
+            options.seed = strtoull(args[++i], NULL, 10);
+        }
+    }
+
+    if (hostPort > 0) {
+        return host((uint16_t)hostPort, options).played ? 0 : -1;
+    }
+    if (joinAddress != NULL) {
+        NetAddress address;
+        if (!parseAddress(joinAddress, address)) {
+            return -1;
+        }
+        return join(address, options).played ? 0 : -1;
+    }
+    if (!pair) {
+        printf("Usage: netplay --pair | --host PORT | --join HOST:PORT [--frames N] [--delay MS] [--jitter MS] [--loss PERCENT] [--input-delay N] [--team-size S] [--seed X]\n");
+        return -1;
+    }
+
+    // Both peers in this process, the host on a free loopback port
+    UdpSocket hostSocket;
+    if (!hostSocket.open(0)) {
+        return -1;
+    }
+    NetAddress hostAddress = { 0x7F000001, hostSocket.localPort() };
+    ReplayHeader setup = setupFor(options);
+    printf("Match seed %llu, %d ms delay, %d ms jitter, %d%% loss, %d frames input delay\n", (unsigned long long)options.seed,
+        options.conditions.delayMs, options.conditions.jitterMs, options.conditions.lossPercent, options.inputDelay);
+
+    PeerResult joined = { false, 0, -1 };
+    std::thread joiner([&hostAddress, &options, &joined]() {
+        joined = join(hostAddress, options);
+    });
+    PeerResult hosted = { false, 0, -1 };
+    NetAddress peer;
+    if (hostMatch(hostSocket, setup, HOST_TIMEOUT_MS, peer)) {
+        hosted = playPeer(hostSocket, peer, setup, 0, options, true);
+    }
+    joiner.join();
+
+    if (!hosted.played || !joined.played) {
+        printf("The match did not finish\n");
+        return -1;
+    }
+    if (hosted.checksum != joined.checksum) {
+        printf("Peers disagree on the final state: %016llx and %016llx\n", (unsigned long long)hosted.checksum, (unsigned long long)joined.checksum);
+        return -1;
+    }
+    printf("Both peers ended on state %016llx\n", (unsigned long long)hosted.checksum);
+    return 0;
+}
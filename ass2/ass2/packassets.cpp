@@ -0,0 +1,95 @@
+// Builds the asset pack the game loads at startup
+//
+// Usage: packassets [--out FILE]
+// Run from the directory holding assets/. Decodes the background, packs the
+// sprites and font glyphs into the atlas and writes both as ARGB8888 pixels,
+// the format SDL's renderers take without conversion, along with the atlas
+// rectangles, the font metrics and the match sprite ids.
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include <cstdio>
+#include <cstring>
+#include "assetpack.h"
+#include "media.h"
+
+// Adds a surface to the pack as ARGB8888
+static bool addSurface(AssetPackWriter& writer, const char* name, SDL_Surface* surface) {
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (converted == NULL) {
+        printf("Unable to convert %s! SDL Error: %s\n", name, SDL_GetError());
+        return false;
+    }
+    SDL_LockSurface(converted);
+    writer.addImage(name, SDL_PIXELFORMAT_ARGB8888, converted->w, converted->h, converted->pitch, converted->pixels);
+    SDL_UnlockSurface(converted);
+    printf("%-12s %4dx%-4d %8d bytes\n", name, converted->w, converted->h, converted->pitch * converted->h);
+    SDL_FreeSurface(converted);
+    return true;
+}
+
+int main(int argc, char* args[]) {
+    const char* outPath = ASSET_PACK_FILE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--out") == 0 && i + 1 < argc) {
+            outPath = args[++i];
+        }
+        else {
+            printf("Usage: packassets [--out FILE]\n");
+            return 1;
+        }
+    }
+
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) || TTF_Init() == -1)
+    {
+        printf("SDL_image or SDL_ttf could not initialize!\n");
+        return 1;
+    }
+
+    AssetPackWriter writer;
+    bool success = true;
+
+    SDL_Surface* background = IMG_Load(BACKGROUND_FILE);
+    if (background == NULL) {
+        printf("Unable to load image %s! SDL_image Error: %s\n", BACKGROUND_FILE, IMG_GetError());
+        success = false;
+    }
+    else {
+        success = addSurface(writer, PACK_BACKGROUND, background);
+        SDL_FreeSurface(background);
+    }
+
+    SpriteAtlas atlas;
+    Font font;
+    GameSprites sprites;
+    if (success && addGameSprites(atlas, font, sprites)) {
+        SDL_Surface* packed = atlas.compose();
+        if (packed == NULL) {
+            success = false;
+        }
+        else {
+            success = addSurface(writer, PACK_ATLAS, packed);
+            SDL_FreeSurface(packed);
+        }
+
+        const std::vector<SDL_Rect>& rects = atlas.getRects();
+        writer.addBlob(PACK_ATLAS_RECTS, rects.data(), rects.size() * sizeof(SDL_Rect));
+        writer.addBlob(PACK_FONT, &font.getMetrics(), sizeof(FontMetrics));
+        writer.addBlob(PACK_SPRITES, &sprites, sizeof(GameSprites));
+    }
+    else {
+        success = false;
+    }
+
+    if (success) {
+        success = writer.write(outPath);
+    }
+    if (success) {
+        printf("Wrote %s\n", outPath);
+    }
+
+    TTF_Quit();
+    IMG_Quit();
+    return success ? 0 : 1;
+}
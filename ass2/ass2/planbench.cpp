@@ -0,0 +1,145 @@
+// Plays the Monte Carlo planner against a computer policy at several budgets
+//
+// Usage: planbench [--budgets MS,MS,...] [--matches N] [--frames F] [--team-size S]
+//                  [--threads T] [--seed X] [--opponent POLICY]
+// For each budget (0.25,0.5,1,2 by default) the planner plays the left side
+// of N matches (4) of F frames (1800) against POLICY (chase) on the right.
+// Budget 0 plays the plain chasing computer instead, for comparison. Steps
+// wait for the search to use its whole budget, so a run plays as the game
+// would but faster. Prints the goals, the rollouts behind each step, how long
+// plan held up the step and how far the search ran past its budget.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "planner.h"
+#include "policies.h"
+#include "sim.h"
+
+static void usage() {
+    printf("Usage: planbench [--budgets MS,MS,...] [--matches N] [--frames F] [--team-size S] [--threads T] [--seed X] [--opponent POLICY]\n");
+}
+
+// Parses a comma separated list of budgets
+static bool parseBudgets(const char* text, std::vector<double>& budgets) {
+    budgets.clear();
+    while (*text != '\0') {
+        char* end;
+        double budget = strtod(text, &end);
+        if (end == text || budget < 0) {
+            return false;
+        }
+        budgets.push_back(budget);
+        text = *end == ',' ? end + 1 : end;
+    }
+    return !budgets.empty();
+}
+
+int main(int argc, char* args[]) {
+    std::vector<double> budgets;
+    parseBudgets("0,0.25,0.5,1,2", budgets);
+    int matches = 4;
+    int frames = 1800;
+    int teamSize = DEFAULT_TEAM_SIZE;
+    int threads = 0;
+    uint64_t seed = 1;
+    const PolicyEntry* opponent = findPolicy("chase");
+    for (int i = 1; i < argc; i += 2) {
+        // Every option takes a value
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        if (strcmp(args[i], "--budgets") == 0) {
+            if (!parseBudgets(args[i + 1], budgets)) {
+                usage();
+                return 1;
+            }
+        }
+        else if (strcmp(args[i], "--matches") == 0) {
+            matches = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--frames") == 0) {
+            frames = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--team-size") == 0) {
+            teamSize = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--threads") == 0) {
+            threads = atoi(args[i + 1]);
+        }
+        else if (strcmp(args[i], "--seed") == 0) {
+            seed = strtoull(args[i + 1], NULL, 10);
+        }
+        else if (strcmp(args[i], "--opponent") == 0) {
+            opponent = findPolicy(args[i + 1]);
+            if (opponent == NULL) {
+                printf("Unknown policy %s!\n", args[i + 1]);
+                return 1;
+            }
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (matches < 1 || frames < 1 || teamSize < 1) {
+        usage();
+        return 1;
+    }
+
+    printf("%d matches of %d frames, %d a side, against %s\n", matches, frames, teamSize, opponent->name);
+    printf("%9s %7s %7s %6s %10s %9s %10s %10s\n",
+        "budget ms", "for", "against", "wins", "rollouts", "changes", "plan p99", "over p99");
+    for (size_t b = 0; b < budgets.size(); b++) {
+        PlannerOptions options;
+        options.budgetMs = budgets[b];
+        options.threads = threads;
+        bool planned = options.budgetMs > 0;
+
+        long long scored = 0;
+        long long conceded = 0;
+        int wins = 0;
+        long long rollouts = 0;
+        long long changes = 0;
+        double planP99 = 0;
+        double overrunP99 = 0;
+        for (int m = 0; m < matches; m++) {
+            // The same kickoffs for every budget
+            MatchState match;
+            initMatch(match, planned ? CONTROL_PLANNED : CONTROL_AI, CONTROL_AI, teamSize, mixSeed(seed + m));
+            match.policy[1] = opponent->policy;
+            options.seed = mixSeed(seed + m) + b;
+            MonteCarloPlanner planner(0, options);
+
+            Inputs inputs = {};
+            for (int f = 0; f < frames; f++) {
+                if (planned) {
+                    inputs.player[0] = planner.plan(match, inputs.player[1]);
+                    planner.waitForSearch();
+                }
+                step(match, inputs);
+            }
+
+            scored += match.score1;
+            conceded += match.score2;
+            wins += match.score1 > match.score2 ? 1 : 0;
+            if (planned) {
+                PlannerStats stats = planner.getStats();
+                double p50, p99, max;
+                rollouts += stats.rollouts;
+                changes += stats.changes;
+                stats.planMs.summary(p50, p99, max);
+                planP99 = p99 > planP99 ? p99 : planP99;
+                stats.overrunMs.summary(p50, p99, max);
+                overrunP99 = p99 > overrunP99 ? p99 : overrunP99;
+            }
+        }
+
+        long long steps = (long long)matches * frames;
+        printf("%9.2f %7lld %7lld %3d/%-2d %10.1f %9lld %10.4f %10.4f\n", budgets[b], scored, conceded, wins, matches,
+            (double)rollouts / steps, changes, planP99, overrunP99);
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include "planner.h"
+
+// Share of the scores that carries over into the next decision
+const double SCORE_CARRY = 0.5;
+
+// Rollouts check the clock this often, in steps
+const int DEADLINE_CHECK_STEPS = 8;
+
+// A rollout without a goal scores how far the ball got, at most this much
+const double PROGRESS_WEIGHT = 0.5;
+
+PlannerOptions::PlannerOptions() {
+    //Initialize
+    budgetMs = 2.0;
+    threads = 0;
+    horizon = 90;
+    decisionFrames = 6;
+    seed = 0;
+}
+
+PlannerStats::PlannerStats() {
+    //Initialize
+    frames = 0;
+    rollouts = 0;
+    abandoned = 0;
+    decisions = 0;
+    changes = 0;
+}
+
+MonteCarloPlanner::MonteCarloPlanner(int plannedSide, const PlannerOptions& plannerOptions)
+    : frame(0), totals(PLAN_TACTIC_COUNT, 0.0), weights(PLAN_TACTIC_COUNT, 0.0) {
+    //Initialize
+    side = plannedSide;
+    options = plannerOptions;
+    if (options.horizon < 1) {
+        options.horizon = 1;
+    }
+    if (options.decisionFrames < 1) {
+        options.decisionFrames = 1;
+    }
+    opponent.buttons = 0;
+    deadline = 0;
+    finished = 0;
+    stopping = false;
+    tactic = 0;
+    framesLeft = 0;
+
+    int count = options.threads;
+    if (count <= 0) {
+        count = (int)std::thread::hardware_concurrency();
+    }
+    if (count <= 0) {
+        count = 1;
+    }
+    for (int i = 0; i < count; i++) {
+        threads.push_back(std::thread(&MonteCarloPlanner::work, this, i));
+    }
+}
+
+MonteCarloPlanner::~MonteCarloPlanner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    searchReady.notify_all();
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+int MonteCarloPlanner::getSide() const {
+    return side;
+}
+
+int MonteCarloPlanner::getThreads() const {
+    return (int)threads.size();
+}
+
+PlayerInput MonteCarloPlanner::plan(const MatchState& state, PlayerInput opponentInput) {
+    int64_t start = profileNow();
+    PlayerInput input;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--framesLeft <= 0) {
+            decide();
+            framesLeft = options.decisionFrames;
+        }
+        input.buttons = (unsigned char)tactic;
+
+        // Threads still busy with the last frame give up on it and move on
+        if (options.budgetMs > 0) {
+            root = state;
+            opponent = opponentInput;
+            deadline = start + (int64_t)(options.budgetMs * 1e6);
+            finished = 0;
+            frame.fetch_add(1);
+        }
+        stats.frames++;
+        stats.planMs.add((profileNow() - start) / 1e6);
+    }
+    searchReady.notify_all();
+    return input;
+}
+
+void MonteCarloPlanner::waitForSearch() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (options.budgetMs <= 0) {
+        return;
+    }
+    searchDone.wait(lock, [this] { return finished >= (int)threads.size(); });
+}
+
+PlannerStats MonteCarloPlanner::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void MonteCarloPlanner::decide() {
+    int best = -1;
+    double bestMean = 0;
+    for (int i = 0; i < PLAN_TACTIC_COUNT; i++) {
+        if (weights[i] <= 0) {
+            continue;
+        }
+        double mean = totals[i] / weights[i];
+        if (best < 0 || mean > bestMean) {
+            best = i;
+            bestMean = mean;
+        }
+    }
+    if (best >= 0 && best != tactic) {
+        tactic = best;
+        stats.changes++;
+    }
+    stats.decisions++;
+
+    for (int i = 0; i < PLAN_TACTIC_COUNT; i++) {
+        totals[i] *= SCORE_CARRY;
+        weights[i] *= SCORE_CARRY;
+    }
+}
+
+void MonteCarloPlanner::work(int thread) {
+    // Scratch matches are reused, so after the first frames a rollout only
+    // copies into storage it already has
+    MatchState start;
+    MatchState scratch;
+    Rng rng;
+    seedRng(rng, mixSeed(options.seed) + thread, STREAM_AI);
+    std::vector<double> sums(PLAN_TACTIC_COUNT);
+    std::vector<double> counts(PLAN_TACTIC_COUNT);
+    long long searched = 0;
+    int next = thread;
+
+    for (;;) {
+        PlayerInput opponentInput;
+        int64_t until;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            searchReady.wait(lock, [&] { return stopping || frame.load() != searched; });
+            if (stopping) {
+                return;
+            }
+            searched = frame.load();
+            start = root;
+            opponentInput = opponent;
+            until = deadline;
+        }
+
+        // Candidates take turns so each gets its share of a short budget
+        long long done = 0;
+        long long abandoned = 0;
+        while (profileNow() < until && frame.load(std::memory_order_relaxed) == searched) {
+            int candidate = next++ % PLAN_TACTIC_COUNT;
+            double score;
+            if (!rollout(start, candidate, opponentInput, searched, until, scratch, rng, score)) {
+                abandoned++;
+                break;
+            }
+            sums[candidate] += score;
+            counts[candidate] += 1;
+            done++;
+        }
+
+        // Finished rollouts count even when a newer frame has arrived, the
+        // match has only moved on by a step
+        int64_t now = profileNow();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < PLAN_TACTIC_COUNT; i++) {
+                totals[i] += sums[i];
+                weights[i] += counts[i];
+                sums[i] = 0;
+                counts[i] = 0;
+            }
+            stats.rollouts += done;
+            stats.abandoned += abandoned;
+            if (frame.load() == searched) {
+                stats.overrunMs.add(now > until ? (now - until) / 1e6 : 0.0);
+                finished++;
+            }
+        }
+        searchDone.notify_all();
+    }
+}
+
+bool MonteCarloPlanner::rollout(const MatchState& start, int candidate, PlayerInput opponentInput, long long searched,
+    int64_t until, MatchState& scratch, Rng& rng, double& score) {
+    scratch = start;
+    int other = 1 - side;
+    scratch.control[side] = CONTROL_AI;
+    scratch.policy[side] = PLAN_TACTICS[candidate];
+
+    // Another planner on the other side is played as the plain computer, a
+    // human keeps pressing what they pressed and now and then something else
+    if (scratch.control[other] == CONTROL_PLANNED) {
+        scratch.control[other] = CONTROL_AI;
+        scratch.policy[other] = chaseBall;
+    }
+    Inputs inputs;
+    inputs.player[side].buttons = 0;
+    inputs.player[other] = opponentInput;
+
+    // Kickoffs after a goal differ from rollout to rollout
+    seedRng(scratch.rng[STREAM_KICKOFF], nextRandom(rng), STREAM_KICKOFF);
+
+    int scored = side == 0 ? start.score1 : start.score2;
+    int conceded = side == 0 ? start.score2 : start.score1;
+    for (int i = 0; i < options.horizon; i++) {
+        if (i % DEADLINE_CHECK_STEPS == 0
+            && (profileNow() >= until || frame.load(std::memory_order_relaxed) != searched)) {
+            return false;
+        }
+        if (i > 0 && i % options.decisionFrames == 0) {
+            scratch.policy[side] = PLAN_TACTICS[randomRange(rng, 0, PLAN_TACTIC_COUNT - 1)];
+        }
+        if (i == 1) {
+            inputs.player[other].buttons &= (unsigned char)~INPUT_SWITCH;
+        }
+        if (scratch.control[other] == CONTROL_HUMAN && randomRange(rng, 0, 7) == 0) {
+            inputs.player[other].buttons = (unsigned char)randomRange(rng, 0, INPUT_SWITCH - 1);
+        }
+
+        step(scratch, inputs);
+        if ((side == 0 ? scratch.score1 : scratch.score2) != scored) {
+            score = 1;
+            return true;
+        }
+        if ((side == 0 ? scratch.score2 : scratch.score1) != conceded) {
+            score = -1;
+            return true;
+        }
+    }
+
+    double progress = (double)(scratch.bodies.x[scratch.ball] - LEFT) / (RIGHT - LEFT);
+    if (side == 1) {
+        progress = 1 - progress;
+    }
+    score = PROGRESS_WEIGHT * (progress - 0.5);
+    return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "profiler.h"
+#include "rng.h"
+#include "sim.h"
+
+// Monte Carlo planner
+//
+// Steers a CONTROL_PLANNED side. Every frame its threads play out random
+// continuations of the match for a fixed slice of wall time: a rollout holds
+// one of the PLAN_TACTICS for a decision period, then picks tactics at random,
+// and scores what happened by goals and by how far up the pitch the ball got.
+// The scores pile up over the frames of a decision period and half of them
+// carry over into the next, so every frame's rollouts count toward a choice.
+//
+// The search runs beside the simulation and never holds up a step: plan hands
+// over the match and returns at once with the tactic the earlier searches
+// chose. Rollouts stop when the budget is used up or a newer frame arrives.
+// More budget means more rollouts behind each choice and a stronger opponent.
+
+struct PlannerOptions
+{
+    //Initializes variables
+    PlannerOptions();
+
+    // Wall time the search gets each frame in milliseconds
+    double budgetMs;
+
+    // Search threads, 0 for one per core
+    int threads;
+
+    // Frames a rollout plays out and frames a tactic is kept
+    int horizon;
+    int decisionFrames;
+
+    uint64_t seed;
+};
+
+struct PlannerStats
+{
+    //Initializes variables
+    PlannerStats();
+
+    long long frames;
+    long long rollouts;
+
+    // Rollouts cut short by the deadline or a newer frame
+    long long abandoned;
+
+    long long decisions;
+    long long changes;
+
+    // Milliseconds plan took and milliseconds the search ran past its
+    // deadline, for the recent frames
+    FrameTimes planMs;
+    FrameTimes overrunMs;
+};
+
+//Monte Carlo planner class
+class MonteCarloPlanner
+{
+public:
+    //Initializes variables and starts the search threads
+    MonteCarloPlanner(int side, const PlannerOptions& options);
+
+    //Stops the search threads
+    ~MonteCarloPlanner();
+
+    //Side the planner plays
+    int getSide() const;
+
+    //Search threads
+    int getThreads() const;
+
+    //Starts this frame's search from state and returns the input for the
+    //step about to run from it; opponent is what the other side pressed
+    PlayerInput plan(const MatchState& state, PlayerInput opponent);
+
+    //Blocks until every thread has used up this frame's budget, for running
+    //matches faster than real time
+    void waitForSearch();
+
+    //Copy of the counters
+    PlannerStats getStats() const;
+
+private:
+    MonteCarloPlanner(const MonteCarloPlanner&);
+    MonteCarloPlanner& operator=(const MonteCarloPlanner&);
+
+    void work(int thread);
+
+    //Plays one rollout of a tactic from start, false if it was cut short
+    bool rollout(const MatchState& start, int tactic, PlayerInput opponent, long long frame,
+        int64_t deadline, MatchState& scratch, Rng& rng, double& score);
+
+    //Picks the tactic with the best average score and ages the scores
+    void decide();
+
+    int side;
+    PlannerOptions options;
+    std::vector<std::thread> threads;
+
+    mutable std::mutex mutex;
+    std::condition_variable searchReady;
+    std::condition_variable searchDone;
+
+    // The frame being searched, guarded by mutex
+    MatchState root;
+    PlayerInput opponent;
+    int64_t deadline;
+    std::atomic<long long> frame;
+    int finished;
+    bool stopping;
+
+    // Summed scores and rollouts of each tactic, guarded by mutex
+    std::vector<double> totals;
+    std::vector<double> weights;
+
+    // Tactic being played and frames until the next choice
+    int tactic;
+    int framesLeft;
+
+    PlannerStats stats;
+};
@@ -0,0 +1,130 @@
+#include "policies.h"
+#include <cstring>
+
+// Sets the velocity that moves a body toward a point
+static void moveToward(Bodies& bodies, int i, int x, int y) {
+    if (x < bodies.x[i] - PLAYER_SPEED) {
+        bodies.vx[i] = -PLAYER_SPEED;
+    }
+    else if (x > bodies.x[i] + PLAYER_SPEED) {
+        bodies.vx[i] = +PLAYER_SPEED;
+    }
+    else {
+        bodies.vx[i] = 0;
+    }
+    if (y < bodies.y[i] - PLAYER_SPEED) {
+        bodies.vy[i] = -PLAYER_SPEED;
+    }
+    else if (y > bodies.y[i] + PLAYER_SPEED) {
+        bodies.vy[i] = +PLAYER_SPEED;
+    }
+    else {
+        bodies.vy[i] = 0;
+    }
+}
+
+// The goal keeper stays inside the goal mouth at the ball's height
+static void keepGoal(MatchState& state, int side) {
+    Bodies& bodies = state.bodies;
+    int keeper = keeperIndex(state, side);
+    int keeperY = bodies.y[state.ball];
+    if (keeperY < GTOP) {
+        keeperY = GTOP;
+    }
+    else if (keeperY > GBOTTOM) {
+        keeperY = GBOTTOM;
+    }
+    moveToward(bodies, keeper, bodies.x[keeper], keeperY);
+}
+
+void standStill(MatchState& state, int side) {
+    for (int i = teamBegin(state, side); i < teamEnd(state, side); i++) {
+        state.bodies.vx[i] = 0;
+        state.bodies.vy[i] = 0;
+    }
+}
+
+void defendGoal(MatchState& state, int side) {
+    Bodies& bodies = state.bodies;
+    int ballX = bodies.x[state.ball];
+    int ballY = bodies.y[state.ball];
+    int first = teamBegin(state, side);
+    int keeper = keeperIndex(state, side);
+
+    int ownGoal = side == 0 ? LEFT : RIGHT;
+    int middle = (LEFT + RIGHT) / 2;
+    bool ballInOwnHalf = side == 0 ? ballX < middle : ballX > middle;
+
+    // Go for the ball in our half, otherwise cover the goal side by side
+    for (int i = first; i < keeper; i++) {
+        if (ballInOwnHalf) {
+            moveToward(bodies, i, ballX, ballY);
+        }
+        else {
+            int offset = (2 * (i - first) - (keeper - first - 1)) * PLAYER_SIZE / 2;
+            moveToward(bodies, i, (ownGoal + ballX) / 2, (ballY + (GTOP + GBOTTOM) / 2) / 2 + offset);
+        }
+    }
+
+    keepGoal(state, side);
+}
+
+void attackGoal(MatchState& state, int side) {
+    Bodies& bodies = state.bodies;
+    int ballX = bodies.x[state.ball];
+    int ballY = bodies.y[state.ball];
+    int first = teamBegin(state, side);
+    int keeper = keeperIndex(state, side);
+
+    // The spot just behind the ball on the line from the goal through it
+    int goalX = side == 0 ? RIGHT : LEFT;
+    int goalY = (GTOP + GBOTTOM) / 2;
+    int dx = goalX - ballX;
+    int dy = goalY - ballY;
+    int length = (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+    if (length == 0) {
+        length = 1;
+    }
+    int reach = (PLAYER_SIZE + BALL_SIZE) / 2;
+    int behindX = ballX - dx * reach / length;
+    int behindY = ballY - dy * reach / length;
+
+    // Players on the far side of the ball from the goal run through it, the
+    // others go round to the spot first
+    for (int i = first; i < keeper; i++) {
+        bool behind = side == 0 ? bodies.x[i] < ballX - reach / 2 : bodies.x[i] > ballX + reach / 2;
+        int offY = bodies.y[i] - behindY;
+        if (behind && offY < reach && offY > -reach) {
+            moveToward(bodies, i, ballX, ballY);
+        }
+        else {
+            moveToward(bodies, i, behindX, behindY);
+        }
+    }
+
+    keepGoal(state, side);
+}
+
+const PolicyEntry POLICIES[] = {
+    { "chase", chaseBall },
+    { "defend", defendGoal },
+    { "attack", attackGoal },
+    { "idle", standStill },
+};
+const int POLICY_COUNT = sizeof(POLICIES) / sizeof(POLICIES[0]);
+
+const Policy PLAN_TACTICS[] = {
+    chaseBall,
+    defendGoal,
+    attackGoal,
+};
+const int PLAN_TACTIC_COUNT = sizeof(PLAN_TACTICS) / sizeof(PLAN_TACTICS[0]);
+
+const PolicyEntry* findPolicy(const char* name) {
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        if (strcmp(POLICIES[i].name, name) == 0) {
+            return &POLICIES[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "sim.h"
+
+// A named computer player
+struct PolicyEntry
+{
+    const char* name;
+    Policy policy;
+};
+
+// Stands still
+void standStill(MatchState& state, int side);
+
+// Keeps the player between the ball and its own goal until the ball crosses into its half
+void defendGoal(MatchState& state, int side);
+
+// Gets the players behind the ball and pushes it toward the other goal
+void attackGoal(MatchState& state, int side);
+
+// All policies that can be picked by name
+extern const PolicyEntry POLICIES[];
+extern const int POLICY_COUNT;
+
+// Looks a policy up by name, returns NULL if there is none
+const PolicyEntry* findPolicy(const char* name);
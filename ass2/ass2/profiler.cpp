@@ -0,0 +1,158 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+std::atomic<bool> profiling(false);
+
+// Ring buffer slot
+// sequence is the event number plus one once the event is complete and 0 while
+// it is being written, so readers can tell complete events from torn ones
+struct ProfileSlot
+{
+    std::atomic<uint64_t> sequence;
+    std::atomic<const char*> name;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> duration;
+    std::atomic<int> thread;
+};
+
+static ProfileSlot slots[PROFILE_CAPACITY];
+static std::atomic<uint64_t> head(0);
+
+// Small ids for the trace's thread lanes
+static std::atomic<int> nextThread(0);
+static thread_local int threadId = nextThread.fetch_add(1, std::memory_order_relaxed);
+
+int64_t profileNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void setProfiling(bool enabled) {
+    profiling.store(enabled, std::memory_order_relaxed);
+}
+
+void recordEvent(const char* name, int64_t start, int64_t end) {
+    uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    ProfileSlot& slot = slots[index & (PROFILE_CAPACITY - 1)];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(end - start, std::memory_order_relaxed);
+    slot.thread.store(threadId, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void collectEvents(std::vector<ProfileEvent>& events) {
+    events.clear();
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > (uint64_t)PROFILE_CAPACITY ? end - PROFILE_CAPACITY : 0;
+    for (uint64_t index = begin; index < end; index++) {
+        const ProfileSlot& slot = slots[index & (PROFILE_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+            continue;
+        }
+        ProfileEvent event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.start = slot.start.load(std::memory_order_relaxed);
+        event.duration = slot.duration.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+        events.push_back(event);
+    }
+}
+
+bool writeChromeTrace(const char* path) {
+    std::vector<ProfileEvent> events;
+    collectEvents(events);
+
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Unable to create trace %s!\n", path);
+        return false;
+    }
+
+    // Timestamps are microseconds from the first event
+    int64_t origin = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        if (i == 0 || events[i].start < origin) {
+            origin = events[i].start;
+        }
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); i++) {
+        const ProfileEvent& event = events[i];
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            event.name, event.thread, (event.start - origin) / 1000.0, event.duration / 1000.0,
+            i + 1 < events.size() ? "," : "");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+
+    printf("Wrote %d events to %s\n", (int)events.size(), path);
+    return true;
+}
+
+size_t percentileIndex(size_t count, int percent) {
+    return count == 0 ? 0 : (count - 1) * percent / 100;
+}
+
+void percentiles(std::vector<float>& values, double& p50, double& p99, double& max) {
+    p50 = 0;
+    p99 = 0;
+    max = 0;
+    if (values.empty()) {
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    p50 = values[percentileIndex(values.size(), 50)];
+    p99 = values[percentileIndex(values.size(), 99)];
+    max = values.back();
+}
+
+FrameTimes::FrameTimes() {
+    //Initialize
+    next = 0;
+    filled = 0;
+    sorted.reserve(FRAME_HISTORY);
+}
+
+void FrameTimes::add(double milliseconds) {
+    times[next] = milliseconds;
+    next = (next + 1) % FRAME_HISTORY;
+    if (filled < FRAME_HISTORY) {
+        filled++;
+    }
+}
+
+int FrameTimes::count() const {
+    return filled;
+}
+
+void FrameTimes::summary(double& p50, double& p99, double& max) const {
+    if (filled == 0) {
+        p50 = p99 = max = 0;
+        return;
+    }
+    sorted.assign(times, times + filled);
+    std::sort(sorted.begin(), sorted.end());
+    p50 = sorted[percentileIndex(filled, 50)];
+    p99 = sorted[percentileIndex(filled, 99)];
+    max = sorted[filled - 1];
+}
+
+void FrameTimes::histogram(int* buckets, int bucketCount, double bucketMs) const {
+    for (int b = 0; b < bucketCount; b++) {
+        buckets[b] = 0;
+    }
+    for (int i = 0; i < filled; i++) {
+        int b = (int)(times[i] / bucketMs);
+        buckets[std::min(std::max(b, 0), bucketCount - 1)]++;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Frame profiler
+// PROFILE_SCOPE times the rest of the enclosing block and stores it in a ring
+// buffer that can be saved as a Chrome trace (chrome://tracing or Perfetto).
+// Without ENABLE_PROFILER the scopes compile to nothing; with it they cost one
+// relaxed load while profiling is switched off.
+
+// Events kept, the oldest are overwritten once the buffer is full
+const int PROFILE_CAPACITY = 1 << 16;
+
+// A timed scope, times in nanoseconds on the profiler clock
+struct ProfileEvent
+{
+    const char* name;
+    int64_t start;
+    int64_t duration;
+    int thread;
+};
+
+// Nanoseconds on a steady clock
+int64_t profileNow();
+
+// Whether scopes are currently recorded
+extern std::atomic<bool> profiling;
+
+inline bool isProfiling() {
+    return profiling.load(std::memory_order_relaxed);
+}
+
+void setProfiling(bool enabled);
+
+// Adds a finished scope to the ring buffer, safe to call from any thread
+// name must outlive the profiler, string literals are expected
+void recordEvent(const char* name, int64_t start, int64_t end);
+
+// Copies the events still in the buffer, oldest first
+// Events being written while copying are skipped
+void collectEvents(std::vector<ProfileEvent>& events);
+
+// Saves the events still in the buffer as Chrome trace JSON
+bool writeChromeTrace(const char* path);
+
+//Profile scope class
+//Records the time between its construction and destruction
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name(name), start(isProfiling() ? profileNow() : -1) {
+    }
+
+    ~ProfileScope() {
+        if (start >= 0) {
+            recordEvent(name, start, profileNow());
+        }
+    }
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+// Position of the percent-th percentile among count sorted values, the
+// nearest rank at or below it: the median of an even count is the lower middle
+// one and 100 gives the largest. Every percentile here is taken this way.
+size_t percentileIndex(size_t count, int percent);
+
+// Median, 99th percentile and largest of values, sorting them in place
+void percentiles(std::vector<float>& values, double& p50, double& p99, double& max);
+
+// Frames kept for frame time statistics
+const int FRAME_HISTORY = 256;
+
+//Frame times class
+//Keeps the durations of the most recent frames for percentiles and histograms
+class FrameTimes
+{
+public:
+    //Initializes variables
+    FrameTimes();
+
+    //Adds the duration of one frame
+    void add(double milliseconds);
+
+    //Frames currently kept
+    int count() const;
+
+    //Median, 99th percentile and longest frame in milliseconds
+    void summary(double& p50, double& p99, double& max) const;
+
+    //Counts frames into buckets bucketMs wide, the last bucket also holds
+    //every longer frame
+    void histogram(int* buckets, int bucketCount, double bucketMs) const;
+
+private:
+    double times[FRAME_HISTORY];
+    int next;
+    int filled;
+
+    // Sorting space for summary, reserved once
+    mutable std::vector<double> sorted;
+};
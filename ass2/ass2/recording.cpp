@@ -0,0 +1,274 @@
+#include "recording.h"
+#include <string.h>
+
+static const char REPLAY_MAGIC[4] = { 'S', 'R', 'P', 'L' };
+
+ReplayHeader replayHeaderFor(const MatchState& state) {
+    ReplayHeader header;
+    header.seed = state.seed;
+    header.teamSize = state.teamSize;
+    header.control[0] = state.control[0];
+    header.control[1] = state.control[1];
+    return header;
+}
+
+// FNV-1a over 32 bit values
+static void hashValue(uint64_t& hash, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 1099511628211ULL;
+    }
+}
+
+uint64_t checksumState(const MatchState& state) {
+    uint64_t hash = 14695981039346656037ULL;
+    const Bodies& bodies = state.bodies;
+    for (int i = 0; i < bodies.count; i++) {
+        hashValue(hash, (uint32_t)bodies.x[i]);
+        hashValue(hash, (uint32_t)bodies.y[i]);
+        hashValue(hash, (uint32_t)bodies.vx[i]);
+        hashValue(hash, (uint32_t)bodies.vy[i]);
+    }
+    hashValue(hash, (uint32_t)state.score1);
+    hashValue(hash, (uint32_t)state.score2);
+    hashValue(hash, (uint32_t)state.frame);
+    return hash;
+}
+
+static bool sameInputs(const Inputs& a, const Inputs& b) {
+    return a.player[0].buttons == b.player[0].buttons && a.player[1].buttons == b.player[1].buttons;
+}
+
+ReplayWriter::ReplayWriter() {
+    //Initialize
+    file = NULL;
+    runLength = 0;
+    memset(&current, 0, sizeof(current));
+    memset(&written, 0, sizeof(written));
+}
+
+ReplayWriter::~ReplayWriter() {
+    if (file != NULL) {
+        writeRun();
+        fclose(file);
+    }
+}
+
+bool ReplayWriter::open(const char* path, const ReplayHeader& header) {
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Unable to create recording %s!\n", path);
+        return false;
+    }
+
+    runLength = 0;
+    memset(&current, 0, sizeof(current));
+    memset(&written, 0, sizeof(written));
+
+    fwrite(REPLAY_MAGIC, 1, sizeof(REPLAY_MAGIC), file);
+    fputc(REPLAY_VERSION, file);
+    writeVarint(header.seed);
+    writeVarint((uint64_t)header.teamSize);
+    writeVarint((uint64_t)header.control[0]);
+    writeVarint((uint64_t)header.control[1]);
+    return true;
+}
+
+bool ReplayWriter::isOpen() const {
+    return file != NULL;
+}
+
+void ReplayWriter::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
+
+void ReplayWriter::writeRun() {
+    if (runLength == 0) {
+        return;
+    }
+
+    // Only the sides whose buttons changed since the last run are stored
+    int changed = 0;
+    if (current.player[0].buttons != written.player[0].buttons) {
+        changed |= 1;
+    }
+    if (current.player[1].buttons != written.player[1].buttons) {
+        changed |= 2;
+    }
+    writeVarint(runLength << 2 | (uint64_t)changed);
+    if (changed & 1) {
+        fputc(current.player[0].buttons, file);
+    }
+    if (changed & 2) {
+        fputc(current.player[1].buttons, file);
+    }
+
+    written = current;
+    runLength = 0;
+}
+
+void ReplayWriter::record(const Inputs& inputs) {
+    if (file == NULL) {
+        return;
+    }
+    if (runLength > 0 && !sameInputs(inputs, current)) {
+        writeRun();
+    }
+    current = inputs;
+    runLength++;
+}
+
+void ReplayWriter::close(const MatchState& state) {
+    if (file == NULL) {
+        return;
+    }
+    writeRun();
+
+    writeVarint(0);
+    uint64_t checksum = checksumState(state);
+    for (int i = 0; i < 8; i++) {
+        fputc((int)((checksum >> (i * 8)) & 0xFF), file);
+    }
+
+    fclose(file);
+    file = NULL;
+}
+
+ReplayReader::ReplayReader() {
+    //Initialize
+    position = 0;
+    memset(&replayHeader, 0, sizeof(replayHeader));
+    memset(&current, 0, sizeof(current));
+    stepsLeft = 0;
+    finished = true;
+    ended = false;
+    finalChecksum = 0;
+}
+
+bool ReplayReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position >= data.size()) {
+            return false;
+        }
+        unsigned char byte = data[position++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ReplayReader::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Unable to open recording %s!\n", path);
+        return false;
+    }
+    data.clear();
+    unsigned char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+
+    if (data.size() < sizeof(REPLAY_MAGIC) + 1 || memcmp(data.data(), REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0) {
+        printf("%s is not a recording!\n", path);
+        return false;
+    }
+    if (data[sizeof(REPLAY_MAGIC)] != REPLAY_VERSION) {
+        printf("Recording %s has version %d, expected %d!\n", path, data[sizeof(REPLAY_MAGIC)], REPLAY_VERSION);
+        return false;
+    }
+    position = sizeof(REPLAY_MAGIC) + 1;
+
+    uint64_t teamSize, control1, control2;
+    if (!readVarint(replayHeader.seed) || !readVarint(teamSize) || !readVarint(control1) || !readVarint(control2)) {
+        printf("Recording %s has a truncated header!\n", path);
+        return false;
+    }
+    // Team sizes travel in one byte when a recorded setup is played online
+    if (teamSize > 255) {
+        printf("Recording %s has %llu players a side!\n", path, (unsigned long long)teamSize);
+        return false;
+    }
+    replayHeader.teamSize = (int)teamSize;
+    replayHeader.control[0] = (int)control1;
+    replayHeader.control[1] = (int)control2;
+
+    memset(&current, 0, sizeof(current));
+    stepsLeft = 0;
+    finished = false;
+    ended = false;
+    finalChecksum = 0;
+    return true;
+}
+
+const ReplayHeader& ReplayReader::header() const {
+    return replayHeader;
+}
+
+bool ReplayReader::readRun() {
+    uint64_t record;
+    if (!readVarint(record)) {
+        // Cut off, play what is there
+        return false;
+    }
+
+    if (record == 0) {
+        if (position + 8 <= data.size()) {
+            finalChecksum = 0;
+            for (int i = 0; i < 8; i++) {
+                finalChecksum |= (uint64_t)data[position + i] << (i * 8);
+            }
+            position += 8;
+            ended = true;
+        }
+        return false;
+    }
+
+    // A run of no steps is never written, the file is corrupt
+    if ((record >> 2) == 0) {
+        return false;
+    }
+
+    int changed = (int)(record & 3);
+    if (((changed & 1) && position >= data.size()) || ((changed & 2) && position + ((changed & 1) ? 1 : 0) >= data.size())) {
+        return false;
+    }
+    if (changed & 1) {
+        current.player[0].buttons = data[position++];
+    }
+    if (changed & 2) {
+        current.player[1].buttons = data[position++];
+    }
+    stepsLeft = record >> 2;
+    return true;
+}
+
+bool ReplayReader::next(Inputs& inputs) {
+    if (finished) {
+        return false;
+    }
+    if (stepsLeft == 0 && !readRun()) {
+        finished = true;
+        return false;
+    }
+    stepsLeft--;
+    inputs = current;
+    return true;
+}
+
+bool ReplayReader::hasChecksum() const {
+    return ended;
+}
+
+uint64_t ReplayReader::checksum() const {
+    return finalChecksum;
+}
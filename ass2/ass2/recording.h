@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "sim.h"
+
+// Input recordings
+//
+// A recording holds the match setup and the buttons both sides held on every
+// step, which is all it takes to play the match again exactly.
+//
+// Layout, all integers unsigned LEB128 varints unless noted:
+//   "SRPL"                  magic
+//   version                 1 byte
+//   seed, teamSize, control1, control2
+//   runs                    varint(length << 2 | changed), then one byte of
+//                           buttons for side 0 if changed & 1 and side 1 if
+//                           changed & 2; the inputs hold for length steps
+//   end                     varint(0), then the checksum of the final state as
+//                           8 bytes little endian
+// Runs are written as they finish, so a recording cut off by a crash still
+// plays up to its last complete run.
+
+const int REPLAY_VERSION = 1;
+
+// How a recorded match was set up
+struct ReplayHeader
+{
+    uint64_t seed;
+    int teamSize;
+    int control[2];
+};
+
+// Header matching a match that is about to be recorded
+ReplayHeader replayHeaderFor(const MatchState& state);
+
+// Fingerprint of the bodies, scores and frame of a match
+uint64_t checksumState(const MatchState& state);
+
+//Replay writer class
+//Streams the inputs of a match to a file as it is played
+class ReplayWriter
+{
+public:
+    //Initializes variables
+    ReplayWriter();
+
+    //Closes the file without an end marker if still open
+    ~ReplayWriter();
+
+    //Creates the file and writes the header
+    bool open(const char* path, const ReplayHeader& header);
+
+    //Adds the inputs of one step
+    void record(const Inputs& inputs);
+
+    //Writes the last run and the end marker with the final state's checksum
+    void close(const MatchState& state);
+
+    bool isOpen() const;
+
+private:
+    void writeVarint(uint64_t value);
+    void writeRun();
+
+    FILE* file;
+
+    // Inputs of the run in progress, how many steps it has lasted and the
+    // inputs of the last run written
+    Inputs current;
+    uint64_t runLength;
+    Inputs written;
+};
+
+//Replay reader class
+//Hands the recorded inputs back one step at a time
+class ReplayReader
+{
+public:
+    //Initializes variables
+    ReplayReader();
+
+    //Reads a whole recording into memory and checks its header
+    bool load(const char* path);
+
+    const ReplayHeader& header() const;
+
+    //Inputs of the next step, false once the recording is over
+    bool next(Inputs& inputs);
+
+    //Whether the recording ended cleanly and its final checksum
+    bool hasChecksum() const;
+    uint64_t checksum() const;
+
+private:
+    bool readVarint(uint64_t& value);
+    bool readRun();
+
+    std::vector<unsigned char> data;
+    size_t position;
+    ReplayHeader replayHeader;
+
+    Inputs current;
+    uint64_t stepsLeft;
+    bool finished;
+    bool ended;
+    uint64_t finalChecksum;
+};
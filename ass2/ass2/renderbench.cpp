@@ -0,0 +1,230 @@
+// Benchmarks for text and frame drawing, on the software renderer
+//
+// Usage: renderbench [--csv FILE] [--baseline FILE] [--tolerance PCT] [name ...]
+// Options as for bench. Runs from the directory holding assets/ and loads the
+// loose files. Uses SDL's dummy video driver unless SDL_VIDEODRIVER names
+// another one, so it runs without a display. Frames show an 11 a side
+// computer match drawn by the game's own match view and presented, all of it
+// each frame for frame/full and only what moved, as the game does on the
+// software renderer, for frame/changed. Before timing anything it checks that
+// drawing frames stops allocating on the heap, SDL's allocations included,
+// once warmed up.
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "alloctrack.h"
+#include "arena.h"
+#include "benchreport.h"
+#include "media.h"
+#include "sdlalloc.h"
+#include "sim.h"
+#include "simthread.h"
+
+// Lines of text drawn in one text batch
+const int TEXT_LINES = 16;
+const char* const TEXT_LINE = "p50 16.67  p99 18.25  max 33.10 ms";
+
+// Frames before the match behind the frames starts over
+const int MATCH_FRAMES = 60 * 90;
+
+// Frames drawn in one frame batch, each this far from one step to the next
+const int FRAME_BATCH = 10;
+const float FRAME_ALPHA = 0.5f;
+
+// Allocation check: frames of warm-up and frames that must not allocate
+const int ALLOC_WARMUP_FRAMES = 60;
+const int ALLOC_CHECK_FRAMES = 300;
+
+SDL_Window* window = NULL;
+SDL_Renderer* renderer = NULL;
+SDL_Texture* background = NULL;
+FrameArena frameArena(FRAME_ARENA_BYTES);
+SpriteAtlas spriteAtlas;
+SpriteBatch spriteBatch;
+Font font;
+GameSprites sprites;
+MatchView fullView(SCREEN_WIDTH, SCREEN_HEIGHT);
+MatchView changedView(SCREEN_WIDTH, SCREEN_HEIGHT);
+MatchState match;
+MatchSnapshot shown;
+std::vector<int> previousX;
+std::vector<int> previousY;
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile long long sink;
+
+static bool init() {
+    // The dummy driver keeps the window off screen; an explicit choice wins
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
+        return false;
+    }
+    if (TTF_Init() == -1) {
+        printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+        return false;
+    }
+
+    window = SDL_CreateWindow("renderbench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_HIDDEN);
+    if (window == NULL) {
+        printf("Window could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    if (renderer == NULL) {
+        printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+
+    // The same sprites and glyphs the game draws, from the loose files
+    if (!loadLooseMedia(renderer, background, spriteAtlas, font, sprites)
+        || !fullView.create(renderer, background, &spriteAtlas, &spriteBatch, &font, sprites, false)
+        || !changedView.create(renderer, background, &spriteAtlas, &spriteBatch, &font, sprites, true)) {
+        return false;
+    }
+    spriteBatch.setArena(&frameArena);
+    initMatch(match, CONTROL_AI, CONTROL_AI, 11, 31);
+    return true;
+}
+
+static void close() {
+    fullView.free();
+    changedView.free();
+    spriteAtlas.free();
+    SDL_DestroyTexture(background);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
+}
+
+static long long measureBatch() {
+    long long width = 0;
+    for (int l = 0; l < TEXT_LINES; l++) {
+        width += font.measure(FONT_SMALL, TEXT_LINE);
+    }
+    sink = width;
+    return TEXT_LINES;
+}
+
+static long long textBatch() {
+    frameArena.reset();
+    spriteBatch.begin(&spriteAtlas);
+    int lineHeight = font.lineHeight(FONT_SMALL);
+    for (int l = 0; l < TEXT_LINES; l++) {
+        font.render(spriteBatch, FONT_SMALL, TEXT_LINE, 20, 15 + l * lineHeight);
+    }
+    spriteBatch.flush(renderer);
+    return TEXT_LINES * (long long)strlen(TEXT_LINE);
+}
+
+// Steps the match and draws it with a view, as the game draws a frame
+static void drawFrame(MatchView& view) {
+    Inputs inputs = { { { 0 }, { 0 } } };
+    frameArena.reset();
+    if (match.frame >= MATCH_FRAMES) {
+        initMatch(match, CONTROL_AI, CONTROL_AI, 11, 31);
+    }
+    previousX = match.bodies.x;
+    previousY = match.bodies.y;
+    step(match, inputs);
+    snapshotMatch(shown, match, previousX, previousY);
+
+    view.render(shown, FRAME_ALPHA, NULL);
+    SDL_RenderPresent(renderer);
+}
+
+static long long fullBatch() {
+    for (int f = 0; f < FRAME_BATCH; f++) {
+        drawFrame(fullView);
+    }
+    return FRAME_BATCH;
+}
+
+static long long changedBatch() {
+    for (int f = 0; f < FRAME_BATCH; f++) {
+        drawFrame(changedView);
+    }
+    return FRAME_BATCH;
+}
+
+// Checks frames drawn with a view stop allocating once warmed up
+static bool checkFrameAllocations(MatchView& view, const char* name) {
+    AllocationWatch watch(ALLOC_WARMUP_FRAMES);
+    setAllocationTracking(true);
+    for (int f = 0; f < ALLOC_WARMUP_FRAMES + ALLOC_CHECK_FRAMES; f++) {
+        watch.beginFrame();
+        drawFrame(view);
+        watch.endFrame();
+    }
+    setAllocationTracking(false);
+
+    watch.printReport(name);
+    if (watch.getFramesAllocating() > 0) {
+        printf("drawing frames allocated on the heap\n");
+        return false;
+    }
+    return true;
+}
+
+struct Benchmark
+{
+    const char* name;
+    const char* unit;
+    BatchFunction batch;
+};
+
+static const Benchmark BENCHMARKS[] = {
+    { "text/measure", "lines", measureBatch },
+    { "text/render", "glyphs", textBatch },
+    { "frame/full", "frames", fullBatch },
+    { "frame/changed", "frames", changedBatch },
+};
+static const int BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+static void usage() {
+    printf("Usage: renderbench [--csv FILE] [--baseline FILE] [--tolerance PCT] [name ...]\n");
+}
+
+int main(int argc, char* args[]) {
+    BenchOptions options;
+    if (!parseBenchOptions(argc, args, options)) {
+        usage();
+        return 1;
+    }
+    if (!trackSdlAllocations() || !init()) {
+        close();
+        return -1;
+    }
+
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        printf("video driver %s, renderer %s\n", SDL_GetCurrentVideoDriver(), info.name);
+    }
+
+    if (!checkFrameAllocations(fullView, "alloc/frame-full") || !checkFrameAllocations(changedView, "alloc/frame-changed")) {
+        close();
+        return -1;
+    }
+
+    BenchReport report;
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        const Benchmark& benchmark = BENCHMARKS[i];
+        if (benchSelected(options, benchmark.name)) {
+            report.add(benchmark.name, benchmark.unit, measureRate(benchmark.batch));
+        }
+    }
+
+    close();
+    return report.finish(options) ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+// Plays a recorded match again without a window, as fast as the simulation goes
+//
+// Usage: replay [--repeat N] [--profile TRACE] FILE
+// The recording is played N times (once by default) so real sessions can be
+// used as benchmarks; --profile saves a Chrome trace of the last steps. The
+// final state is checked against the checksum stored when the recording was
+// closed, which tells whether the match was reproduced.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "profiler.h"
+#include "recording.h"
+#include "sim.h"
+
+// Steps a second the game runs at
+const int GAME_FPS = 60;
+
+// Who drove a side, as printed
+static const char* controlName(int control) {
+    if (control == CONTROL_AI) {
+        return "computer";
+    }
+    return control == CONTROL_PLANNED ? "planner" : "human";
+}
+
+static void usage() {
+    printf("Usage: replay [--repeat N] [--profile TRACE] FILE\n");
+}
+
+int main(int argc, char* args[]) {
+    int repeat = 1;
+    const char* path = NULL;
+    const char* tracePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--profile") == 0 && i + 1 < argc) {
+            tracePath = args[++i];
+            setProfiling(true);
+        }
+        else if (args[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else {
+            path = args[i];
+        }
+    }
+    if (path == NULL || repeat < 1) {
+        usage();
+        return 1;
+    }
+
+    ReplayReader reader;
+    if (!reader.load(path)) {
+        return 1;
+    }
+    const ReplayHeader& header = reader.header();
+    if (header.teamSize < 1 || header.control[0] > CONTROL_PLANNED || header.control[1] > CONTROL_PLANNED) {
+        printf("Recording %s has an invalid match setup!\n", path);
+        return 1;
+    }
+    printf("Seed %llu, %d a side, side 1 %s, side 2 %s\n", (unsigned long long)header.seed, header.teamSize,
+        controlName(header.control[0]), controlName(header.control[1]));
+
+    MatchState match;
+    ReplayReader playback;
+    long long steps = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        playback = reader;
+        initMatch(match, header.control[0], header.control[1], header.teamSize, header.seed);
+        Inputs inputs;
+        while (playback.next(inputs)) {
+            step(match, inputs);
+            steps++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long matchSteps = steps / repeat;
+    printf("%lld steps (%.1f s of play), final score %d - %d\n", matchSteps, (double)matchSteps / GAME_FPS, match.score1, match.score2);
+    printf("Replayed %d times in %.3f s: %.0f steps/s, %.0fx real time\n", repeat, seconds, steps / seconds, steps / seconds / GAME_FPS);
+
+    if (tracePath != NULL) {
+        writeChromeTrace(tracePath);
+    }
+
+    if (!playback.hasChecksum()) {
+        printf("Recording has no end marker, the game did not close it\n");
+        return 0;
+    }
+    if (playback.checksum() != checksumState(match)) {
+        printf("Final state differs from the recorded match!\n");
+        return 1;
+    }
+    printf("Final state matches the recorded match\n");
+    return 0;
+}
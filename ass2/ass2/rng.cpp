@@ -0,0 +1,10 @@
+#include "rng.h"
+#include <chrono>
+#include <random>
+
+uint64_t randomSeed() {
+    // Only called once per match, so the cost of random_device does not matter
+    std::random_device rand_dev;
+    uint64_t seed = ((uint64_t)rand_dev() << 32) | rand_dev();
+    return mixSeed(seed ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+}
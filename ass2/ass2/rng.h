@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// Small, fast random number generator (PCG32)
+// 16 bytes of state; generators seeded with the same seed but different
+// streams produce independent sequences
+struct Rng
+{
+    uint64_t state;
+    uint64_t increment;
+};
+
+// Next 32 random bits
+inline uint32_t nextRandom(Rng& rng) {
+    uint64_t old = rng.state;
+    rng.state = old * 6364136223846793005ULL + rng.increment;
+    uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rotation = (uint32_t)(old >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31));
+}
+
+// Starts a generator on one of its streams
+inline void seedRng(Rng& rng, uint64_t seed, uint64_t stream) {
+    rng.state = 0;
+    rng.increment = (stream << 1) | 1;
+    nextRandom(rng);
+    rng.state += seed;
+    nextRandom(rng);
+}
+
+// Uniform integer in [range_from, range_to], without modulo bias
+inline int randomRange(Rng& rng, int range_from, int range_to) {
+    uint32_t range = (uint32_t)(range_to - range_from) + 1;
+    if (range == 0) {
+        return (int)nextRandom(rng);
+    }
+    uint64_t product = (uint64_t)nextRandom(rng) * range;
+    uint32_t low = (uint32_t)product;
+    if (low < range) {
+        uint32_t threshold = (0u - range) % range;
+        while (low < threshold) {
+            product = (uint64_t)nextRandom(rng) * range;
+            low = (uint32_t)product;
+        }
+    }
+    return range_from + (int)(product >> 32);
+}
+
+// Scrambles a seed (SplitMix64), used to derive many seeds from one
+inline uint64_t mixSeed(uint64_t seed) {
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    return seed ^ (seed >> 31);
+}
+
+// A seed that differs from run to run, for matches nobody asked to repeat
+uint64_t randomSeed();
@@ -0,0 +1,368 @@
+#include "rollback.h"
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+// Hellos are repeated this often until the host answers
+const int HELLO_INTERVAL_MS = 100;
+
+// Fewest frames between two frames held back to fall in step with the peer,
+// and how much further ahead of the peer than it is of us this side has to be
+const int SYNC_STALL_SPACING = 10;
+const int SYNC_STALL_ADVANTAGE = 3;
+
+static void sleepMs(int milliseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+// Writes a welcome carrying the match setup, returns its size
+static int writeWelcome(unsigned char* out, const ReplayHeader& setup) {
+    out[0] = NET_WELCOME;
+    out[1] = NET_VERSION;
+    putU64(out + 2, setup.seed);
+    out[10] = (unsigned char)setup.teamSize;
+    out[11] = (unsigned char)setup.control[0];
+    out[12] = (unsigned char)setup.control[1];
+    return 13;
+}
+
+bool hostMatch(UdpSocket& socket, const ReplayHeader& setup, int timeoutMs, NetAddress& peer) {
+    unsigned char packet[MAX_PACKET];
+    int64_t deadline = profileNow() + (int64_t)timeoutMs * 1000000;
+    while (profileNow() < deadline) {
+        int size = socket.receive(packet, sizeof(packet), peer);
+        if (size < 0) {
+            sleepMs(1);
+            continue;
+        }
+        if (size >= 2 && packet[0] == NET_HELLO) {
+            if (packet[1] != NET_VERSION) {
+                printf("Peer speaks network version %d, not %d!\n", packet[1], NET_VERSION);
+                continue;
+            }
+            socket.send(peer, packet, writeWelcome(packet, setup));
+            return true;
+        }
+    }
+    printf("Nobody joined within %d ms!\n", timeoutMs);
+    return false;
+}
+
+bool joinMatch(UdpSocket& socket, const NetAddress& host, int timeoutMs, ReplayHeader& setup) {
+    unsigned char packet[MAX_PACKET];
+    unsigned char hello[2] = { NET_HELLO, NET_VERSION };
+    int64_t deadline = profileNow() + (int64_t)timeoutMs * 1000000;
+    int64_t nextHello = 0;
+    while (profileNow() < deadline) {
+        if (profileNow() >= nextHello) {
+            socket.send(host, hello, sizeof(hello));
+            nextHello = profileNow() + (int64_t)HELLO_INTERVAL_MS * 1000000;
+        }
+
+        NetAddress from;
+        int size = socket.receive(packet, sizeof(packet), from);
+        if (size < 0) {
+            sleepMs(1);
+            continue;
+        }
+        if (sameAddress(from, host) && size >= 13 && packet[0] == NET_WELCOME && packet[1] == NET_VERSION) {
+            setup.seed = getU64(packet + 2);
+            setup.teamSize = packet[10];
+            setup.control[0] = packet[11];
+            setup.control[1] = packet[12];
+            return true;
+        }
+    }
+    printf("No answer from the host within %d ms!\n", timeoutMs);
+    return false;
+}
+
+RollbackStats::RollbackStats() {
+    //Initialize
+    frames = 0;
+    stalls = 0;
+    rollbacks = 0;
+    resimulated = 0;
+    deepest = 0;
+    packetsReceived = 0;
+    checksums = 0;
+    desyncs = 0;
+}
+
+RollbackSession::RollbackSession(MatchState& state, int side, int delay, NetLink& netLink) : match(state), link(netLink) {
+    //Initialize
+    localSide = side;
+    inputDelay = delay < 0 ? 0 : (delay > ROLLBACK_WINDOW ? ROLLBACK_WINDOW : delay);
+    recording = NULL;
+    welcomeSize = 0;
+    current = 0;
+
+    // Neither side gives input for the frames the delay skips, both know them as nothing
+    PlayerInput none = { 0 };
+    for (int f = 0; f < ROLLBACK_HISTORY; f++) {
+        localInputs[f] = none;
+        remoteInputs[f] = none;
+        predicted[f] = none;
+    }
+    localLast = inputDelay - 1;
+    remoteLast = inputDelay - 1;
+    peerAck = inputDelay - 1;
+
+    rollbackFrom = -1;
+    recorded = -1;
+    remoteFrame = 0;
+    remoteAdvantage = 0;
+    lastSyncStall = 0;
+    for (int i = 0; i < 4; i++) {
+        checksumFrames[i] = -1;
+        checksums[i] = 0;
+    }
+    latestChecksum = 0;
+}
+
+void RollbackSession::setWelcome(const ReplayHeader& setup) {
+    welcomeSize = writeWelcome(welcome, setup);
+}
+
+void RollbackSession::recordTo(ReplayWriter* writer) {
+    recording = writer;
+}
+
+void RollbackSession::poll() {
+    link.flush(profileNow());
+
+    unsigned char packet[MAX_PACKET];
+    int size;
+    while ((size = link.receive(packet, sizeof(packet))) >= 0) {
+        handlePacket(packet, size);
+    }
+}
+
+void RollbackSession::handlePacket(const unsigned char* data, int size) {
+    // The joiner says hello until it hears the welcome
+    if (size >= 1 && data[0] == NET_HELLO) {
+        if (welcomeSize > 0) {
+            link.send(welcome, welcomeSize);
+        }
+        return;
+    }
+    if (size < 27 || data[0] != NET_INPUT) {
+        return;
+    }
+    stats.packetsReceived++;
+
+    int frame = (int)getU32(data + 1);
+    int advantage = (signed char)data[5];
+    int ack = (int)getU32(data + 6);
+    int checksumFrame = (int)getU32(data + 10);
+    uint64_t checksum = getU64(data + 14);
+    int first = (int)getU32(data + 22);
+    int count = data[26];
+    if (size < 27 + count) {
+        return;
+    }
+
+    if (frame > remoteFrame) {
+        remoteFrame = frame;
+        remoteAdvantage = advantage;
+    }
+    if (ack > peerAck) {
+        peerAck = ack;
+    }
+
+    // Inputs arrive in order from the first one not acknowledged yet
+    for (int i = 0; i < count; i++) {
+        int f = first + i;
+        if (f <= remoteLast) {
+            continue;
+        }
+        // A gap, or frames so far ahead they would overwrite ones still needed
+        if (f != remoteLast + 1 || f >= current + ROLLBACK_HISTORY / 2) {
+            break;
+        }
+        PlayerInput input = { data[27 + i] };
+        remoteInputs[f % ROLLBACK_HISTORY] = input;
+        remoteLast = f;
+
+        // Frames already stepped with a different guess have to be stepped again
+        if (f < current && predicted[f % ROLLBACK_HISTORY].buttons != input.buttons && (rollbackFrom < 0 || f < rollbackFrom)) {
+            rollbackFrom = f;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (checksumFrame >= 0 && checksumFrames[i] == checksumFrame) {
+            stats.checksums++;
+            if (checksums[i] != checksum) {
+                if (stats.desyncs == 0) {
+                    printf("Out of sync with the peer at frame %d!\n", checksumFrame);
+                }
+                stats.desyncs++;
+            }
+            checksumFrames[i] = -1;
+        }
+    }
+}
+
+PlayerInput RollbackSession::predictRemote() const {
+    // The peer most likely keeps holding the same buttons, a switch is a one-off
+    PlayerInput guess = remoteInputs[remoteLast >= 0 ? remoteLast % ROLLBACK_HISTORY : 0];
+    guess.buttons &= ~INPUT_SWITCH;
+    return guess;
+}
+
+Inputs RollbackSession::inputsFor(int frame, PlayerInput remote) const {
+    Inputs inputs;
+    inputs.player[localSide] = localInputs[frame % ROLLBACK_HISTORY];
+    inputs.player[1 - localSide] = remote;
+    return inputs;
+}
+
+void RollbackSession::synchronize() {
+    if (rollbackFrom < 0) {
+        return;
+    }
+
+    int64_t start = profileNow();
+    match = states[rollbackFrom % ROLLBACK_HISTORY];
+    PlayerInput guess = predictRemote();
+    for (int f = rollbackFrom; f < current; f++) {
+        PlayerInput remote = f <= remoteLast ? remoteInputs[f % ROLLBACK_HISTORY] : guess;
+        predicted[f % ROLLBACK_HISTORY] = remote;
+        if (f > rollbackFrom) {
+            states[f % ROLLBACK_HISTORY] = match;
+        }
+        step(match, inputsFor(f, remote));
+    }
+
+    int depth = current - rollbackFrom;
+    stats.rollbacks++;
+    stats.resimulated += depth;
+    if (depth > stats.deepest) {
+        stats.deepest = depth;
+    }
+    stats.resimulateMs.add((profileNow() - start) / 1e6);
+    rollbackFrom = -1;
+}
+
+bool RollbackSession::advance(PlayerInput local) {
+    synchronize();
+
+    // Never run further ahead than the saved states can roll back
+    bool stall = current - remoteLast > ROLLBACK_WINDOW;
+
+    // Peers that started apart fall into step: when this side is further
+    // ahead of the other than the other is of it, hold back one frame
+    int advantage = current - remoteFrame;
+    if (!stall && advantage - remoteAdvantage >= SYNC_STALL_ADVANTAGE && current - lastSyncStall >= SYNC_STALL_SPACING) {
+        stall = true;
+        lastSyncStall = current;
+    }
+    if (stall) {
+        stats.stalls++;
+        sendInputs();
+        return false;
+    }
+
+    // Local input takes effect after the input delay
+    localLast = current + inputDelay;
+    localInputs[localLast % ROLLBACK_HISTORY] = local;
+    sendInputs();
+
+    PlayerInput remote = current <= remoteLast ? remoteInputs[current % ROLLBACK_HISTORY] : predictRemote();
+    predicted[current % ROLLBACK_HISTORY] = remote;
+    states[current % ROLLBACK_HISTORY] = match;
+    step(match, inputsFor(current, remote));
+    current++;
+    stats.frames++;
+
+    // Frames both sides agree on go to the recording in order
+    int confirmed = getConfirmedFrame();
+    if (recording != NULL) {
+        while (recorded < confirmed) {
+            recorded++;
+            recording->record(inputsFor(recorded, remoteInputs[recorded % ROLLBACK_HISTORY]));
+        }
+    }
+    saveChecksum();
+    return true;
+}
+
+void RollbackSession::saveChecksum() {
+    // Start of the newest checksum frame whose state every confirmed input led to
+    int frame = (getConfirmedFrame() + 1) / CHECKSUM_INTERVAL * CHECKSUM_INTERVAL;
+    if (frame <= 0 || frame == latestChecksum || rollbackFrom >= 0) {
+        return;
+    }
+    const MatchState& state = frame == current ? match : states[frame % ROLLBACK_HISTORY];
+
+    int slot = (frame / CHECKSUM_INTERVAL) % 4;
+    checksumFrames[slot] = frame;
+    checksums[slot] = checksumState(state);
+    latestChecksum = frame;
+}
+
+void RollbackSession::sendInputs() {
+    unsigned char packet[MAX_PACKET];
+    int first = peerAck + 1;
+    if (localLast - first + 1 > MAX_SENT_INPUTS) {
+        first = localLast - MAX_SENT_INPUTS + 1;
+    }
+    int count = localLast - first + 1;
+    if (count < 0) {
+        count = 0;
+    }
+
+    // Advantage is how far this side is ahead of what it last heard from the peer
+    int advantage = current - remoteFrame;
+    advantage = advantage < -127 ? -127 : (advantage > 127 ? 127 : advantage);
+    int slot = (latestChecksum / CHECKSUM_INTERVAL) % 4;
+
+    packet[0] = NET_INPUT;
+    putU32(packet + 1, (uint32_t)current);
+    packet[5] = (unsigned char)(signed char)advantage;
+    putU32(packet + 6, (uint32_t)remoteLast);
+    putU32(packet + 10, (uint32_t)(latestChecksum > 0 ? latestChecksum : -1));
+    putU64(packet + 14, latestChecksum > 0 ? checksums[slot] : 0);
+    putU32(packet + 22, (uint32_t)first);
+    packet[26] = (unsigned char)count;
+    for (int i = 0; i < count; i++) {
+        packet[27 + i] = localInputs[(first + i) % ROLLBACK_HISTORY].buttons;
+    }
+    link.send(packet, 27 + count);
+}
+
+int RollbackSession::getFrame() const {
+    return current;
+}
+
+int RollbackSession::getConfirmedFrame() const {
+    return remoteLast < current - 1 ? remoteLast : current - 1;
+}
+
+bool RollbackSession::peerHasInputsUpTo(int frame) const {
+    return peerAck >= frame;
+}
+
+const MatchState& RollbackSession::confirmedState() {
+    synchronize();
+    int next = getConfirmedFrame() + 1;
+    return next == current ? match : states[next % ROLLBACK_HISTORY];
+}
+
+const RollbackStats& RollbackSession::getStats() const {
+    return stats;
+}
+
+void printRollbackStats(const RollbackStats& stats, double stepMs) {
+    double p50, p99, max;
+    stats.resimulateMs.summary(p50, p99, max);
+    double perHundred = stats.frames > 0 ? 100.0 * stats.rollbacks / stats.frames : 0;
+    double average = stats.rollbacks > 0 ? (double)stats.resimulated / stats.rollbacks : 0;
+    printf("Rollback: %lld frames, %lld rollbacks (%.1f per 100 frames), %lld frames stepped again (%.1f each, deepest %d)\n",
+        stats.frames, stats.rollbacks, perHundred, stats.resimulated, average, stats.deepest);
+    printf("Re-simulation: p50 %.3f  p99 %.3f  max %.3f ms per rollback, p99 is %.1f%% of a step\n",
+        p50, p99, max, 100.0 * p99 / stepMs);
+    printf("Stalled %lld frames, received %lld packets, compared %lld checksums, %lld out of sync\n",
+        stats.stalls, stats.packetsReceived, stats.checksums, stats.desyncs);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <stdint.h>
+#include "net.h"
+#include "profiler.h"
+#include "recording.h"
+#include "sim.h"
+
+// Rollback network play
+//
+// Each peer steps the whole match itself as soon as its own input is known,
+// predicting that the other side keeps holding what it held last. When the
+// real input arrives and differs, the match is put back to the state saved at
+// that frame and stepped forward again with the corrected inputs. Every input
+// packet repeats the inputs the peer has not acknowledged yet, so a lost
+// packet is covered by the next one.
+//
+// Packets, integers little endian:
+//   hello     type, version
+//   welcome   type, version, seed (8 bytes), team size, control of each side
+//   input     type, sender's frame (4), sender's frame advantage (1, signed),
+//             newest frame of the receiver's input the sender has (4),
+//             frame of the checksum and checksum (4 + 8),
+//             first frame (4), count (1), one byte of buttons per frame
+
+// Frames a peer may run ahead of the newest input it has from the other
+const int ROLLBACK_WINDOW = 8;
+
+// Frames of inputs and saved states kept, a power of two
+const int ROLLBACK_HISTORY = 64;
+
+// Most inputs a packet carries
+const int MAX_SENT_INPUTS = 32;
+
+// Peers compare checksums of the state at the start of every this many frames
+const int CHECKSUM_INTERVAL = 60;
+
+const int NET_VERSION = 1;
+
+// Packet types
+enum NetMessage
+{
+    NET_HELLO = 1,
+    NET_WELCOME = 2,
+    NET_INPUT = 3
+};
+
+// Waits up to timeoutMs for a peer to say hello and answers with the match setup
+bool hostMatch(UdpSocket& socket, const ReplayHeader& setup, int timeoutMs, NetAddress& peer);
+
+// Says hello to a host until it answers with the match setup or timeoutMs pass
+bool joinMatch(UdpSocket& socket, const NetAddress& host, int timeoutMs, ReplayHeader& setup);
+
+// Counters of a rollback session
+struct RollbackStats
+{
+    //Initializes variables
+    RollbackStats();
+
+    // Frames advanced and frames held back to let the peer catch up
+    long long frames;
+    long long stalls;
+
+    // Rollbacks, the frames stepped again because of them and the most
+    // frames a single rollback went back
+    long long rollbacks;
+    long long resimulated;
+    int deepest;
+
+    // Milliseconds each recent rollback took to restore and step again
+    FrameTimes resimulateMs;
+
+    long long packetsReceived;
+
+    // Checksums compared with the peer and how many differed
+    long long checksums;
+    long long desyncs;
+};
+
+//Rollback session class
+//Plays one side of a match against a peer on a net link. The match passed in
+//is the live state; the session saves a copy of it every frame.
+class RollbackSession
+{
+public:
+    //Initializes variables; local input is applied inputDelay frames after it is given
+    RollbackSession(MatchState& match, int localSide, int inputDelay, NetLink& link);
+
+    //Answers repeated hellos with this setup, for the host whose welcome got lost
+    void setWelcome(const ReplayHeader& setup);
+
+    //Saves every confirmed frame's inputs as it becomes known
+    void recordTo(ReplayWriter* writer);
+
+    //Sends held back packets that are due and takes in the peer's
+    void poll();
+
+    //Gives the local input for this frame and steps the match once, rolling
+    //back first if the peer's input proved a prediction wrong
+    //Returns false without stepping while too far ahead of the peer
+    bool advance(PlayerInput local);
+
+    //Sends the unacknowledged inputs again, for when nothing is advancing
+    void sendInputs();
+
+    //Rolls back now if a prediction turned out wrong
+    void synchronize();
+
+    //Next frame to be stepped
+    int getFrame() const;
+
+    //Newest frame stepped with both sides' real input, along with every one before it
+    int getConfirmedFrame() const;
+
+    //Whether the peer has acknowledged the local inputs of every frame up to this one
+    bool peerHasInputsUpTo(int frame) const;
+
+    //State after the last confirmed frame
+    const MatchState& confirmedState();
+
+    const RollbackStats& getStats() const;
+
+private:
+    void handlePacket(const unsigned char* data, int size);
+    PlayerInput predictRemote() const;
+    Inputs inputsFor(int frame, PlayerInput remote) const;
+    void saveChecksum();
+
+    MatchState& match;
+    NetLink& link;
+    int localSide;
+    int inputDelay;
+    ReplayWriter* recording;
+    unsigned char welcome[16];
+    int welcomeSize;
+
+    // Next frame to step
+    int current;
+
+    // Ring buffers indexed by frame: the state at the start of the frame,
+    // both sides' inputs and the remote input the last stepping assumed
+    MatchState states[ROLLBACK_HISTORY];
+    PlayerInput localInputs[ROLLBACK_HISTORY];
+    PlayerInput remoteInputs[ROLLBACK_HISTORY];
+    PlayerInput predicted[ROLLBACK_HISTORY];
+
+    // Newest local input given, newest remote input received with all before
+    // it, and newest local input the peer acknowledged
+    int localLast;
+    int remoteLast;
+    int peerAck;
+
+    // Earliest frame stepped with a wrong prediction, -1 if none
+    int rollbackFrom;
+
+    // Newest frame recorded
+    int recorded;
+
+    // The peer's frame when it last sent, and its frame advantage over us
+    int remoteFrame;
+    int remoteAdvantage;
+    int lastSyncStall;
+
+    // Recent checksums of our own, and the newest one to send
+    int checksumFrames[4];
+    uint64_t checksums[4];
+    int latestChecksum;
+
+    RollbackStats stats;
+};
+
+// Prints rollback frequency and cost, stepMs being the time one step may take
+void printRollbackStats(const RollbackStats& stats, double stepMs);
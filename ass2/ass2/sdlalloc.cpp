@@ -0,0 +1,32 @@
+#include "sdlalloc.h"
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "alloctrack.h"
+
+static void* SDLCALL trackedMalloc(size_t size) {
+    countAllocation(size, 1);
+    return malloc(size);
+}
+
+static void* SDLCALL trackedCalloc(size_t count, size_t size) {
+    countAllocation(count * size, 1);
+    return calloc(count, size);
+}
+
+static void* SDLCALL trackedRealloc(void* memory, size_t size) {
+    countAllocation(size, 1);
+    return realloc(memory, size);
+}
+
+static void SDLCALL trackedFree(void* memory) {
+    free(memory);
+}
+
+bool trackSdlAllocations() {
+    if (SDL_SetMemoryFunctions(trackedMalloc, trackedCalloc, trackedRealloc, trackedFree) != 0) {
+        printf("Unable to count SDL's allocations! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Sends SDL's allocations through functions that count them with the others
+// of the allocation tracker, while tracking is on
+// Has to be called before SDL allocates anything, ahead of SDL_Init
+bool trackSdlAllocations();
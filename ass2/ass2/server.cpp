@@ -0,0 +1,132 @@
+// Dedicated server hosting many online matches at once
+//
+// Usage: server [--port P] [--workers W] [--rate HZ] [--max-matches N] [--team-size S]
+//               [--match-seconds S] [--seconds S] [--seed X] [--no-pin]
+// Players join on port P (7777) and play on one of the W worker threads (one
+// a core) listening on the ports after it. Matches step HZ (60) times a second
+// and last S seconds (120). Runs for --seconds, or until Ctrl+C when 0.
+// Once a second and for the whole run at the end it prints the matches
+// hosted, the CPU time of a tick, how long after it was due each tick sent
+// its last packet, and how many matches one core could host at that cost.
+// loadbot plays against it on loopback.
+
+#include <signal.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "matchserver.h"
+#include "profiler.h"
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onInterrupt(int) {
+    interrupted = 1;
+}
+
+// Prints a report covering seconds of wall time in which matches were hosted
+// for matchSeconds in all
+static void printReport(const char* label, WorkerReport& total, double seconds, double matchSeconds, int workers) {
+    double cpuP50, cpuP99, cpuMax, tickP50, tickP99, tickMax;
+    percentiles(total.tickCpuMs, cpuP50, cpuP99, cpuMax);
+    percentiles(total.tickMs, tickP50, tickP99, tickMax);
+
+    // The cores kept busy, and so the matches one core could carry
+    double cpuSeconds = total.cpuNanoseconds / 1e9;
+    double cores = cpuSeconds / seconds;
+    double perCore = cpuSeconds > 0 ? matchSeconds / cpuSeconds : 0;
+    printf("%s: %d matches on %d workers, %lld ticks (%lld missed), %.0f packets in and %.0f out a second (%.1f KB/s, %lld dropped)\n",
+        label, total.matches, workers, total.ticks, total.missed, total.packetsIn / seconds, total.packetsOut / seconds,
+        total.bytesOut / seconds / 1024, total.sendDropped);
+    printf("%s: tick cpu p50 %.3f  p99 %.3f  max %.3f ms, tick latency p50 %.3f  p99 %.3f  max %.3f ms, %.2f cores busy, %.0f matches a core\n",
+        label, cpuP50, cpuP99, cpuMax, tickP50, tickP99, tickMax, cores, perCore);
+}
+
+int main(int argc, char* args[]) {
+    ServerOptions options;
+    int port = DEFAULT_SERVER_PORT;
+    int seconds = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--no-pin") == 0) {
+            options.pin = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            break;
+        }
+        if (strcmp(args[i], "--port") == 0) {
+            port = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--workers") == 0) {
+            options.workers = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--rate") == 0) {
+            options.rate = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--max-matches") == 0) {
+            options.maxMatches = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--team-size") == 0) {
+            options.teamSize = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--match-seconds") == 0) {
+            options.matchSeconds = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--seconds") == 0) {
+            seconds = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--seed") == 0) {
+            options.seed = strtoull(args[++i], NULL, 10);
+        }
+    }
+
+    MatchServer server(options);
+    if (!server.start((uint16_t)port)) {
+        return -1;
+    }
+    printf("Lobby on port %d, %d workers on ports %d to %d, %d steps a second\n",
+        port, server.getWorkers(), port + 1, port + server.getWorkers(), options.rate);
+    signal(SIGINT, onInterrupt);
+
+    // The lobby runs here between reports
+    std::vector<WorkerReport> reports;
+    WorkerReport run;
+    int64_t start = profileNow();
+    int64_t lastReport = start;
+    int busiest = 0;
+    double matchSeconds = 0;
+    while (!interrupted && (seconds <= 0 || profileNow() - start < (int64_t)seconds * 1000000000)) {
+        server.poll(100);
+        int64_t now = profileNow();
+        if (now - lastReport < 1000000000LL) {
+            continue;
+        }
+
+        server.collect(reports);
+        WorkerReport second;
+        for (size_t i = 0; i < reports.size(); i++) {
+            second.merge(reports[i]);
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "%4.0f s", (now - start) / 1e9);
+        double elapsed = (now - lastReport) / 1e9;
+        printReport(label, second, elapsed, second.matches * elapsed, server.getWorkers());
+        busiest = std::max(busiest, second.matches);
+        matchSeconds += second.matches * elapsed;
+        second.matches = 0;
+        run.merge(second);
+        lastReport = now;
+    }
+
+    server.stop();
+    server.collect(reports);
+    for (size_t i = 0; i < reports.size(); i++) {
+        reports[i].matches = 0;
+        run.merge(reports[i]);
+    }
+    run.matches = busiest;
+    printf("%lld players joined, %lld pairs turned away, at most %d matches at once\n", server.getJoins(), server.getTurnedAway(), busiest);
+    printReport("run", run, (profileNow() - start) / 1e9, matchSeconds, server.getWorkers());
+    return 0;
+}
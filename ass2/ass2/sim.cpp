@@ -0,0 +1,613 @@
+#include "sim.h"
+#include <algorithm>
+#include <cmath>
+#include "grid.h"
+#include "narrowphase.h"
+#include "profiler.h"
+
+// Broadphase cells are a little wider than a player, so players pushed apart
+// during a step still only meet bodies from neighbouring cells
+const int GRID_CELL = PLAYER_SIZE + 8;
+
+// Below this many players checking every pair is cheaper than binning them
+const int GRID_MIN_PLAYERS = 24;
+
+// Broadphase scratch, one per thread so matches can be stepped in parallel
+struct CollisionScratch
+{
+    CollisionScratch() {
+        allPairsFor = -1;
+        grid.setup(LEFT, TOP, RIGHT, BOTTOM, GRID_CELL);
+    }
+
+    UniformGrid grid;
+    std::vector<CandidatePair> pairs;
+    std::vector<Contact> contacts;
+
+    // Player count the every-pair list in pairs was built for
+    int allPairsFor;
+};
+static thread_local CollisionScratch scratch;
+
+
+// How fast the ball and a player can close in on each other, in pixels a frame
+const int CLOSING_SPEED = 2 * (BALL_MAX_SPEED + PLAYER_SPEED);
+
+bool isColliding(const Bodies& bodies, int a, int b) {
+	// Use circle collision detection on squared distances
+	int dx = bodies.x[a] - bodies.x[b];
+	int dy = bodies.y[a] - bodies.y[b];
+	int radiusSum = bodies.radius[a] + bodies.radius[b];
+	return dx * dx + dy * dy < radiusSum * radiusSum;
+}
+
+// Sizes the arrays and works out the role, size and allowed area of every body
+static void setupBodies(MatchState& state) {
+    Bodies& bodies = state.bodies;
+    int count = state.playerCount + 1;
+
+    bodies.count = count;
+    bodies.x.assign(count, 0);
+    bodies.y.assign(count, 0);
+    bodies.vx.assign(count, 0);
+    bodies.vy.assign(count, 0);
+    bodies.radius.resize(count);
+    bodies.minX.resize(count);
+    bodies.maxX.resize(count);
+    bodies.minY.resize(count);
+    bodies.maxY.resize(count);
+    bodies.team.resize(count);
+    bodies.role.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        int left = LEFT, right = RIGHT;
+        if (i == state.ball) {
+            bodies.team[i] = NO_TEAM;
+            bodies.role[i] = ROLE_BALL;
+            bodies.radius[i] = BALL_SIZE / 2;
+        }
+        else {
+            int side = i / state.teamSize;
+            bodies.team[i] = (unsigned char)side;
+            bodies.role[i] = i == keeperIndex(state, side) ? ROLE_KEEPER : ROLE_OUTFIELD;
+            bodies.radius[i] = PLAYER_SIZE / 2;
+
+            // Goal keepers stay in their own box
+            if (bodies.role[i] == ROLE_KEEPER) {
+                if (side == 0) {
+                    right = GKLEFT;
+                }
+                else {
+                    left = GKRIGHT;
+                }
+            }
+        }
+        bodies.minX[i] = left + bodies.radius[i];
+        bodies.maxX[i] = right - bodies.radius[i];
+        bodies.minY[i] = TOP + bodies.radius[i];
+        bodies.maxY[i] = BOTTOM - bodies.radius[i];
+    }
+}
+
+void initMatch(MatchState& state, int control1, int control2, int teamSize, uint64_t seed) {
+    if (teamSize < 2) {
+        teamSize = 2;
+    }
+    state.teamSize = teamSize;
+    state.playerCount = 2 * teamSize;
+    state.ball = state.playerCount;
+    setupBodies(state);
+
+    state.selected[0] = teamBegin(state, 0);
+    state.selected[1] = teamBegin(state, 1);
+    state.control[0] = control1;
+    state.control[1] = control2;
+    state.policy[0] = chaseBall;
+    state.policy[1] = chaseBall;
+    state.score1 = 0;
+    state.score2 = 0;
+    state.win1 = false;
+    state.win2 = false;
+    state.frame = 0;
+
+    state.seed = seed;
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        seedRng(state.rng[stream], seed, stream);
+    }
+
+    reset(state);
+}
+
+void reset(MatchState& state) {
+    Bodies& bodies = state.bodies;
+
+    // Reset player positions
+    // Outfield players stand in columns of up to four in their own half
+    int outfield = state.teamSize - 1;
+    int columns = (outfield + 3) / 4;
+    for (int side = 0; side < 2; side++) {
+        int first = teamBegin(state, side);
+        for (int n = 0; n < outfield; n++) {
+            int column = n / 4;
+            int rows = column < columns - 1 ? 4 : outfield - column * 4;
+            int row = n % 4;
+            int x = 400 + (2 * column - (columns - 1)) * 60;
+            int y = 480 + (2 * row - (rows - 1)) * 75;
+
+            // Side 1 is a mirror image of side 0
+            bodies.x[first + n] = side == 0 ? x : LEFT + RIGHT - x;
+            bodies.y[first + n] = y;
+        }
+
+        int keeper = keeperIndex(state, side);
+        bodies.x[keeper] = side == 0 ? 200 : 1080;
+        bodies.y[keeper] = 480;
+    }
+
+    // Reset ball position
+    bodies.x[state.ball] = 640;
+    bodies.y[state.ball] = randomRange(state.rng[STREAM_KICKOFF], 410, 550);
+
+    // Reset ball velocity
+    bodies.vx[state.ball] = 0;
+    bodies.vy[state.ball] = 0;
+}
+
+// Moves the selected player of a human side from held buttons
+static void applyInput(MatchState& state, int side, PlayerInput input) {
+    Bodies& bodies = state.bodies;
+
+    // Switching stops the player that is let go and selects the next one
+    if (input.buttons & INPUT_SWITCH) {
+        int current = state.selected[side];
+        bodies.vx[current] = 0;
+        bodies.vy[current] = 0;
+        state.selected[side] = current + 1 < teamEnd(state, side) ? current + 1 : teamBegin(state, side);
+    }
+
+    int i = state.selected[side];
+    bodies.vx[i] = 0;
+    bodies.vy[i] = 0;
+    if (input.buttons & INPUT_UP) {
+        bodies.vy[i] = -PLAYER_SPEED;
+    }
+    if (input.buttons & INPUT_LEFT) {
+        bodies.vx[i] = -PLAYER_SPEED;
+    }
+    if (input.buttons & INPUT_DOWN) {
+        bodies.vy[i] = +PLAYER_SPEED;
+    }
+    if (input.buttons & INPUT_RIGHT) {
+        bodies.vx[i] = +PLAYER_SPEED;
+    }
+}
+
+void chaseBall(MatchState& state, int side) {
+    Bodies& bodies = state.bodies;
+    int ballX = bodies.x[state.ball];
+    int ballY = bodies.y[state.ball];
+    int keeper = keeperIndex(state, side);
+
+    // handle outfield players
+    for (int i = teamBegin(state, side); i < keeper; i++) {
+        if (ballY < bodies.y[i]) {
+            bodies.vy[i] = -PLAYER_SPEED;
+        }
+        else if (ballY > bodies.y[i]) {
+            bodies.vy[i] = +PLAYER_SPEED;
+        }
+        if (ballX < bodies.x[i]) {
+            bodies.vx[i] = -PLAYER_SPEED;
+        }
+        else if (ballX > bodies.x[i]) {
+            bodies.vx[i] = +PLAYER_SPEED;
+        }
+    }
+
+    // handle goal keeper
+    if (ballY < bodies.y[keeper]) {
+        bodies.vy[keeper] = -PLAYER_SPEED;
+    }
+    else if (ballY > bodies.y[keeper]) {
+        bodies.vy[keeper] = +PLAYER_SPEED;
+    }
+}
+
+// Kicks the ball away from every player touching it, returns whether any was
+static bool kickBall(MatchState& state) {
+    Bodies& bodies = state.bodies;
+    int ball = state.ball;
+    int players = state.playerCount;
+
+    int* x = bodies.x.data();
+    int* y = bodies.y.data();
+    int* vx = bodies.vx.data();
+    int* vy = bodies.vy.data();
+
+    // Check ball collision with players
+    int kickX = 0, kickY = 0;
+    bool touching = false;
+    for (int i = 0; i < players; i++) {
+        if (isColliding(bodies, i, ball)) {
+            kickX += (x[ball] - x[i]) / B;
+            kickY += (y[ball] - y[i]) / B;
+            touching = true;
+        }
+    }
+    vx[ball] += kickX;
+    vy[ball] += kickY;
+
+    if (vx[ball] > BALL_MAX_SPEED) {
+        vx[ball] = BALL_MAX_SPEED;
+    }
+    else if (vx[ball] < -BALL_MAX_SPEED) {
+        vx[ball] = -BALL_MAX_SPEED;
+    }
+    if (vy[ball] > BALL_MAX_SPEED) {
+        vy[ball] = BALL_MAX_SPEED;
+    }
+    else if (vy[ball] < -BALL_MAX_SPEED) {
+        vy[ball] = -BALL_MAX_SPEED;
+    }
+    return touching;
+}
+
+static void updateVelocity(MatchState& state, int frames) {
+    Bodies& bodies = state.bodies;
+    int ball = state.ball;
+    int players = state.playerCount;
+
+    int* x = bodies.x.data();
+    int* y = bodies.y.data();
+    int* vx = bodies.vx.data();
+    int* vy = bodies.vy.data();
+
+    // Check ball collision with walls
+    if (x[ball] < bodies.minX[ball]) {
+        vx[ball] = -vx[ball];
+        x[ball] = bodies.minX[ball];
+    }
+    else if (x[ball] > bodies.maxX[ball]) {
+        vx[ball] = -vx[ball];
+        x[ball] = bodies.maxX[ball];
+    }
+    if (y[ball] < bodies.minY[ball]) {
+        vy[ball] = -vy[ball];
+        y[ball] = bodies.minY[ball];
+    }
+    else if (y[ball] > bodies.maxY[ball]) {
+        vy[ball] = -vy[ball];
+        y[ball] = bodies.maxY[ball];
+    }
+
+    kickBall(state);
+
+    // Once every 300 frames, or once in a step that covers such a frame
+    if (state.frame % 300 == 0 || state.frame / 300 != (state.frame + frames - 1) / 300) {
+        vx[ball] = vx[ball] >= 0 ? -BALL_MAX_SPEED : BALL_MAX_SPEED;
+        vy[ball] = vy[ball] >= 0 ? -BALL_MAX_SPEED : BALL_MAX_SPEED;
+    }
+
+    // Check player collision with walls
+    const int* minX = bodies.minX.data();
+    const int* maxX = bodies.maxX.data();
+    const int* minY = bodies.minY.data();
+    const int* maxY = bodies.maxY.data();
+    for (int i = 0; i < players; i++) {
+        if (x[i] < minX[i]) {
+            vx[i] = 0;
+            x[i] = minX[i];
+        }
+        else if (x[i] > maxX[i]) {
+            vx[i] = 0;
+            x[i] = maxX[i];
+        }
+        if (y[i] < minY[i]) {
+            vy[i] = 0;
+            y[i] = minY[i];
+        }
+        else if (y[i] > maxY[i]) {
+            vy[i] = 0;
+            y[i] = maxY[i];
+        }
+    }
+}
+
+// Largest root with root * root <= value
+static int64_t squareRoot(int64_t value) {
+    int64_t root = (int64_t)std::sqrt((double)value);
+    while (root * root > value) {
+        root--;
+    }
+    while ((root + 1) * (root + 1) <= value) {
+        root++;
+    }
+    return root;
+}
+
+// Whether the ball touches any player
+static bool touchesPlayer(const MatchState& state) {
+    for (int i = 0; i < state.playerCount; i++) {
+        if (isColliding(state.bodies, i, state.ball)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves the ball for a step of frames and returns the frames it took, fewer
+// when it scored. While the ball touches a player it moves a frame at a time,
+// as a frame by frame step does. Once it is free its path is swept for the
+// first frame that takes it past a wall or into a player. At the end of every
+// frame with something in it, a ball past the goal line between the posts
+// scores, one past any other wall bounces back from it and one touching
+// players is kicked. So it never passes through anything however long the
+// step, and a ball on its own ends up exactly where single frames would take
+// it
+// updateVelocity has already bounced and kicked it for the first frame
+static int sweepBall(MatchState& state, int frames) {
+    Bodies& bodies = state.bodies;
+    int ball = state.ball;
+    int players = state.playerCount;
+    int* x = bodies.x.data();
+    int* y = bodies.y.data();
+    int* vx = bodies.vx.data();
+    int* vy = bodies.vy.data();
+    int minX = bodies.minX[ball];
+    int maxX = bodies.maxX[ball];
+    int minY = bodies.minY[ball];
+    int maxY = bodies.maxY[ball];
+
+    bool touching = touchesPlayer(state);
+    int framesLeft = frames;
+    while (framesLeft > 0) {
+        int first = 1;
+        if (!touching) {
+            // First frame that ends with the ball past a wall
+            first = framesLeft + 1;
+            if (vx[ball] < 0 && x[ball] + vx[ball] * framesLeft < minX) {
+                first = std::min(first, (x[ball] - minX) / -vx[ball] + 1);
+            }
+            else if (vx[ball] > 0 && x[ball] + vx[ball] * framesLeft > maxX) {
+                first = std::min(first, (maxX - x[ball]) / vx[ball] + 1);
+            }
+            if (vy[ball] < 0 && y[ball] + vy[ball] * framesLeft < minY) {
+                first = std::min(first, (y[ball] - minY) / -vy[ball] + 1);
+            }
+            else if (vy[ball] > 0 && y[ball] + vy[ball] * framesLeft > maxY) {
+                first = std::min(first, (maxY - y[ball]) / vy[ball] + 1);
+            }
+
+            // First frame that ends with the ball touching a player, from the
+            // smaller root t of |f + t v| = r; a free ball has c >= 0. The
+            // root is rounded down, so at worst the sweep stops a frame early
+            // and sweeps again
+            int64_t a = (int64_t)vx[ball] * vx[ball] + (int64_t)vy[ball] * vy[ball];
+            for (int i = 0; i < players && a > 0; i++) {
+                int64_t fx = x[ball] - x[i];
+                int64_t fy = y[ball] - y[i];
+                int64_t radiusSum = bodies.radius[ball] + bodies.radius[i];
+                int64_t c = fx * fx + fy * fy - radiusSum * radiusSum;
+                int64_t b = fx * vx[ball] + fy * vy[ball];
+                if (b >= 0) {
+                    continue;
+                }
+                int64_t discriminant = b * b - a * c;
+                if (discriminant < 0) {
+                    continue;
+                }
+                int64_t root = squareRoot(discriminant);
+                root += root * root < discriminant ? 1 : 0;
+                int64_t frame = (-b - root) / a + 1;
+                if (frame < first) {
+                    first = (int)frame;
+                }
+            }
+        }
+
+        int moved = std::max(1, std::min(first, framesLeft));
+        x[ball] += vx[ball] * moved;
+        y[ball] += vy[ball] * moved;
+        framesLeft -= moved;
+        if (first > moved) {
+            break;
+        }
+
+        // Past the goal line between the posts
+        if (y[ball] > GTOP && y[ball] < GBOTTOM) {
+            if (x[ball] < minX) {
+                state.win2 = true;
+                return frames - framesLeft;
+            }
+            if (x[ball] > maxX) {
+                state.win1 = true;
+                return frames - framesLeft;
+            }
+        }
+
+        // The next step's updateVelocity bounces and kicks after the last frame
+        if (framesLeft == 0) {
+            break;
+        }
+
+        // Back from the walls and kicked, as updateVelocity would in the next frame
+        if (x[ball] < minX || x[ball] > maxX) {
+            vx[ball] = -vx[ball];
+            x[ball] = x[ball] < minX ? minX : maxX;
+        }
+        if (y[ball] < minY || y[ball] > maxY) {
+            vy[ball] = -vy[ball];
+            y[ball] = y[ball] < minY ? minY : maxY;
+        }
+        touching = kickBall(state);
+    }
+    return frames;
+}
+
+// Returns the frames the step took, fewer when the ball scored early in it
+static int updatePosition(MatchState& state, int frames) {
+    Bodies& bodies = state.bodies;
+    int ball = state.ball;
+    int players = state.playerCount;
+
+    int* x = bodies.x.data();
+    int* y = bodies.y.data();
+    const int* vx = bodies.vx.data();
+    const int* vy = bodies.vy.data();
+
+    // Update player position
+    for (int i = 0; i < players; i++) {
+        x[i] += vx[i] * frames;
+        y[i] += vy[i] * frames;
+    }
+
+    // Players stop at the walls, a frame by frame step waits for updateVelocity
+    if (frames > 1) {
+        for (int i = 0; i < players; i++) {
+            x[i] = x[i] < bodies.minX[i] ? bodies.minX[i] : (x[i] > bodies.maxX[i] ? bodies.maxX[i] : x[i]);
+            y[i] = y[i] < bodies.minY[i] ? bodies.minY[i] : (y[i] > bodies.maxY[i] ? bodies.maxY[i] : y[i]);
+        }
+    }
+
+    // Check player collision with each other
+    // Only players in neighbouring grid cells can touch
+    PROFILE_SCOPE("collisions");
+    std::vector<CandidatePair>& pairs = scratch.pairs;
+    if (players < GRID_MIN_PLAYERS) {
+        // Small teams check every pair, the list only depends on the player count
+        if (scratch.allPairsFor != players) {
+            pairs.clear();
+            for (int a = 0; a < players; a++) {
+                for (int b = a + 1; b < players; b++) {
+                    CandidatePair pair = { a, b };
+                    pairs.push_back(pair);
+                }
+            }
+            scratch.allPairsFor = players;
+        }
+    }
+    else {
+        scratch.allPairsFor = -1;
+        scratch.grid.build(x, y, players);
+        scratch.grid.findPairs(pairs);
+    }
+
+    // Find every overlap first, then push each touching pair 2 pixels apart on each axis
+    if (scratch.contacts.size() < pairs.size()) {
+        scratch.contacts.resize(pairs.size());
+    }
+    Contact* contacts = scratch.contacts.data();
+    int touching = findContacts(x, y, bodies.radius.data(), pairs.data(), (int)pairs.size(), contacts);
+    for (int c = 0; c < touching; c++) {
+        int pushX = contacts[c].nx > 0 ? 2 : -2;
+        int pushY = contacts[c].ny > 0 ? 2 : -2;
+        x[contacts[c].a] += pushX;
+        x[contacts[c].b] -= pushX;
+        y[contacts[c].a] += pushY;
+        y[contacts[c].b] -= pushY;
+    }
+
+    // Update ball position
+    // A single frame moves the ball less than it takes to pass through
+    // anything, longer steps sweep its path
+    if (frames > 1) {
+        return sweepBall(state, frames);
+    }
+    x[ball] += vx[ball];
+    y[ball] += vy[ball];
+
+    // Check goal
+    if (y[ball] > GTOP && y[ball] < GBOTTOM) {
+        if (x[ball] < bodies.minX[ball]) {
+            state.win2 = true;
+        }
+        else if (x[ball] > bodies.maxX[ball]) {
+            state.win1 = true;
+        }
+    }
+    return 1;
+}
+
+void step(MatchState& state, const Inputs& inputs) {
+    stepFrames(state, inputs, 1);
+}
+
+int stepFrames(MatchState& state, const Inputs& inputs, int frames) {
+    if (frames < 1) {
+        frames = 1;
+    }
+    else if (frames > MAX_STEP_FRAMES) {
+        frames = MAX_STEP_FRAMES;
+    }
+    state.win1 = false;
+    state.win2 = false;
+
+    {
+        PROFILE_SCOPE("control");
+        for (int side = 0; side < 2; side++) {
+            if (state.control[side] == CONTROL_AI) {
+                state.policy[side](state, side);
+            }
+            else if (state.control[side] == CONTROL_PLANNED) {
+                PLAN_TACTICS[inputs.player[side].buttons % PLAN_TACTIC_COUNT](state, side);
+            }
+            else {
+                applyInput(state, side, inputs.player[side]);
+            }
+        }
+    }
+
+    {
+        PROFILE_SCOPE("velocity");
+        updateVelocity(state, frames);
+    }
+    {
+        PROFILE_SCOPE("position");
+        frames = updatePosition(state, frames);
+    }
+
+    // The frame with a goal in it does not count
+    if (state.win1 || state.win2) {
+        state.frame += frames - 1;
+        if (state.win1) {
+            state.score1++;
+        }
+        else {
+            state.score2++;
+        }
+        reset(state);
+        return frames;
+    }
+
+    state.frame += frames;
+    return frames;
+}
+
+int fastForward(MatchState& state, const Inputs& inputs, int frames, int maxStepFrames) {
+    const Bodies& bodies = state.bodies;
+    int ball = state.ball;
+    Inputs held = inputs;
+    int steps = 0;
+    while (frames > 0) {
+        // Long steps only while every player is too far away to reach the ball
+        int gap = RIGHT - LEFT;
+        for (int i = 0; i < state.playerCount; i++) {
+            int64_t dx = bodies.x[ball] - bodies.x[i];
+            int64_t dy = bodies.y[ball] - bodies.y[i];
+            int distance = (int)squareRoot(dx * dx + dy * dy) - bodies.radius[ball] - bodies.radius[i];
+            gap = distance < gap ? distance : gap;
+        }
+        // and never past the ball's next kick, which comes at the start of a step
+        int untilKick = 300 - state.frame % 300;
+        int length = std::min(std::min(gap / CLOSING_SPEED, maxStepFrames), std::min(frames, untilKick));
+        length = length < 1 ? 1 : length;
+
+        frames -= stepFrames(state, held, length);
+        steps++;
+
+        // A switch is one press, not one per step
+        held.player[0].buttons &= (unsigned char)~INPUT_SWITCH;
+        held.player[1].buttons &= (unsigned char)~INPUT_SWITCH;
+    }
+    return steps;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <vector>
+#include "rng.h"
+
+// Headless match simulation
+// Has no SDL dependency so matches can be stepped without a window
+
+// Constants
+const int P = 22;
+const int B = 7;
+const int LEFT = 140;
+const int RIGHT = 1140;
+const int TOP = 105;
+const int BOTTOM = 855;
+const int GTOP = 330;
+const int GBOTTOM = 630;
+const int GKLEFT = 490;
+const int GKRIGHT = 790;
+
+// Sprite sizes used for collisions
+const int PLAYER_SIZE = 90;
+const int BALL_SIZE = 50;
+
+// Movement
+const int PLAYER_SPEED = 4;
+const int BALL_MAX_SPEED = 10;
+
+// Longest step stepFrames takes
+const int MAX_STEP_FRAMES = 32;
+
+// Players per side, goal keeper included
+const int DEFAULT_TEAM_SIZE = 2;
+
+// Body roles
+const unsigned char ROLE_OUTFIELD = 0;
+const unsigned char ROLE_KEEPER = 1;
+const unsigned char ROLE_BALL = 2;
+
+// Team of the ball
+const unsigned char NO_TEAM = 2;
+
+// Random number streams, one per subsystem so each draws the same numbers
+// for the same match seed no matter what the others do
+enum RngStream
+{
+    STREAM_KICKOFF,
+    STREAM_AI,
+    STREAM_COUNT
+};
+
+// Who drives a team
+// A planned side plays whichever of the PLAN_TACTICS its buttons pick, so a
+// planner outside the simulation can steer it and still be recorded as input
+enum Control
+{
+    CONTROL_HUMAN,
+    CONTROL_AI,
+    CONTROL_PLANNED
+};
+
+// Input buttons
+const unsigned char INPUT_UP = 1 << 0;
+const unsigned char INPUT_DOWN = 1 << 1;
+const unsigned char INPUT_LEFT = 1 << 2;
+const unsigned char INPUT_RIGHT = 1 << 3;
+const unsigned char INPUT_SWITCH = 1 << 4;
+
+// Buttons held by one side during a step
+struct PlayerInput
+{
+    unsigned char buttons;
+};
+
+// Inputs for both sides during a step
+struct Inputs
+{
+    PlayerInput player[2];
+};
+
+// Moving circles on the pitch, stored as structure of arrays
+// Side 0 comes first, then side 1, each with its outfield players followed by
+// its goal keeper. The ball is the last body.
+struct Bodies
+{
+    int count;
+
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> vx;
+    std::vector<int> vy;
+    std::vector<int> radius;
+
+    // Range the centre of each body is kept in
+    std::vector<int> minX;
+    std::vector<int> maxX;
+    std::vector<int> minY;
+    std::vector<int> maxY;
+
+    std::vector<unsigned char> team;
+    std::vector<unsigned char> role;
+};
+
+struct MatchState;
+
+// Computer player logic, sets the velocities of one side's players
+typedef void (*Policy)(MatchState& state, int side);
+
+// Policies a planned side picks from, defined with the other policies
+extern const Policy PLAN_TACTICS[];
+extern const int PLAN_TACTIC_COUNT;
+
+// Complete state of a match
+struct MatchState
+{
+    int teamSize;
+    int playerCount;
+    int ball;
+
+    Bodies bodies;
+
+    // Body each human side controls
+    int selected[2];
+    int control[2];
+
+    // Used by sides under CONTROL_AI
+    Policy policy[2];
+
+    int score1;
+    int score2;
+
+    // Set by the step in which a goal was scored
+    bool win1;
+    bool win2;
+
+    int frame;
+
+    // Everything random in the match comes from these, seeded from seed
+    uint64_t seed;
+    Rng rng[STREAM_COUNT];
+};
+
+// First body of a side
+inline int teamBegin(const MatchState& state, int side) {
+    return side * state.teamSize;
+}
+
+// One past the last body of a side
+inline int teamEnd(const MatchState& state, int side) {
+    return (side + 1) * state.teamSize;
+}
+
+// Goal keeper of a side
+inline int keeperIndex(const MatchState& state, int side) {
+    return teamEnd(state, side) - 1;
+}
+
+// Sets up a new match with teamSize players a side and places them for kickoff
+// Matches with the same seed and inputs play out exactly the same
+void initMatch(MatchState& state, int control1, int control2, int teamSize = DEFAULT_TEAM_SIZE, uint64_t seed = 0);
+
+// Puts players and ball back in kickoff position
+void reset(MatchState& state);
+
+// Advances the match by one frame
+void step(MatchState& state, const Inputs& inputs);
+
+// Advances the match by up to MAX_STEP_FRAMES frames in one step, for headless
+// runs that trade accuracy for speed, and returns the frames it took, fewer
+// when a goal ended the step early. Players move in a straight line for the
+// whole step. The ball's path is swept, so it bounces, is kicked or scores in
+// the frame it first reaches a wall, a player or the goal line and never
+// passes through any of them
+int stepFrames(MatchState& state, const Inputs& inputs, int frames);
+
+// Advances the match by frames frames of the same inputs, in steps of up to
+// maxStepFrames while no player can reach the ball and single frames
+// otherwise; returns the steps taken. A ball nobody reaches moves exactly as
+// it would frame by frame
+int fastForward(MatchState& state, const Inputs& inputs, int frames, int maxStepFrames);
+
+// The players chase the ball and the goal keeper follows its height
+void chaseBall(MatchState& state, int side);
+
+// Circle collision between two bodies
+bool isColliding(const Bodies& bodies, int a, int b);
@@ -0,0 +1,256 @@
+#include "simthread.h"
+#include <chrono>
+
+// Sleeping can overshoot, the last part of a wait spins instead
+const int64_t SPIN_NANOSECONDS = 2000000;
+
+// Online, the network is polled this often between steps
+const int POLL_MILLISECONDS = 1;
+
+MatchSnapshot::MatchSnapshot() {
+    //Initialize
+    frame = -1;
+    ball = -1;
+    score1 = 0;
+    score2 = 0;
+    due = 0;
+    inputChanged = -1;
+}
+
+void snapshotMatch(MatchSnapshot& snapshot, const MatchState& match, const std::vector<int>& previousX, const std::vector<int>& previousY) {
+    snapshot.frame = match.frame;
+    snapshot.ball = match.ball;
+    snapshot.score1 = match.score1;
+    snapshot.score2 = match.score2;
+    snapshot.x = match.bodies.x;
+    snapshot.y = match.bodies.y;
+    snapshot.previousX = previousX;
+    snapshot.previousY = previousY;
+    snapshot.team = match.bodies.team;
+    snapshot.role = match.bodies.role;
+}
+
+SimThread::SimThread(MatchState& state, int stepsPerSecond, int maxCatchUp, ReplayWriter* writer)
+    : match(state), inputs(INPUT_QUEUE_CAPACITY), steps(0), dropped(0), heldBack(0), running(false) {
+    //Initialize
+    recording = writer;
+    session = NULL;
+    planner = NULL;
+    interval = 1000000000LL / stepsPerSecond;
+    maxCatchUpSteps = maxCatchUp;
+    for (int side = 0; side < 2; side++) {
+        held[side] = 0;
+        pressed[side] = 0;
+    }
+    changed = -1;
+    usedChanged = -1;
+}
+
+SimThread::~SimThread() {
+    stop();
+}
+
+void SimThread::setSession(RollbackSession* rollback) {
+    session = rollback;
+}
+
+void SimThread::setPlanner(MonteCarloPlanner* matchPlanner) {
+    planner = matchPlanner;
+}
+
+void SimThread::start() {
+    if (running.load()) {
+        return;
+    }
+
+    // Readers see the starting positions until the first step
+    previousX = match.bodies.x;
+    previousY = match.bodies.y;
+    int64_t now = profileNow();
+    publish(now);
+
+    // Every slot gets its storage now rather than when the simulation thread
+    // first writes to it
+    snapshots.update();
+    snapshots.fill(snapshots.readSlot());
+
+    running.store(true);
+    thread = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool SimThread::sendInput(const InputSnapshot& input) {
+    return inputs.push(input);
+}
+
+bool SimThread::inputFull() const {
+    return inputs.full();
+}
+
+const MatchSnapshot& SimThread::latest() {
+    snapshots.update();
+    return snapshots.readSlot();
+}
+
+int64_t SimThread::stepInterval() const {
+    return interval;
+}
+
+long long SimThread::getSteps() const {
+    return steps.load();
+}
+
+long long SimThread::getDroppedSteps() const {
+    return dropped.load();
+}
+
+long long SimThread::getHeldSteps() const {
+    return heldBack.load();
+}
+
+const FrameTimes& SimThread::getLateness() const {
+    return lateness;
+}
+
+void SimThread::run() {
+    int64_t due = profileNow() + interval;
+    while (running.load(std::memory_order_relaxed)) {
+        // Sleep most of the way to the next step, then spin for the rest
+        int64_t now = profileNow();
+        if (now < due) {
+            if (session != NULL) {
+                session->poll();
+                if (due - now > SPIN_NANOSECONDS) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+                    continue;
+                }
+            }
+            else if (due - now > SPIN_NANOSECONDS) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - SPIN_NANOSECONDS));
+            }
+            while (profileNow() < due) {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+
+        // Run every step that is due, up to the catch-up limit
+        int64_t lastDue = due;
+        int ran = 0;
+        while (due <= now && ran < maxCatchUpSteps) {
+            lateness.add((profileNow() - due) / 1e6);
+            stepOnce();
+            lastDue = due;
+            due += interval;
+            ran++;
+        }
+
+        // Still behind after a long stall: skip the backlog instead of rushing
+        if (due <= now) {
+            int64_t behind = (now - due) / interval + 1;
+            dropped.fetch_add(behind, std::memory_order_relaxed);
+            due += behind * interval;
+        }
+
+        publish(lastDue);
+    }
+}
+
+void SimThread::stepOnce() {
+    PROFILE_SCOPE("step");
+
+    // Presses and taps from every queued frame are used by the next step,
+    // the buttons held come from the newest frame
+    InputSnapshot received;
+    while (inputs.pop(received)) {
+        for (int side = 0; side < 2; side++) {
+            pressed[side] |= received.first.player[side].buttons;
+            held[side] = received.held.player[side].buttons;
+        }
+        if (received.changed >= 0 && (changed < 0 || received.changed < changed)) {
+            changed = received.changed;
+        }
+    }
+
+    if (session != NULL) {
+        stepOnline();
+        return;
+    }
+
+    Inputs stepInputs;
+    for (int side = 0; side < 2; side++) {
+        stepInputs.player[side].buttons = held[side] | pressed[side];
+        pressed[side] = 0;
+
+        // Keys held on the computer's side do nothing, keep them out of the recording
+        if (match.control[side] != CONTROL_HUMAN) {
+            stepInputs.player[side].buttons = 0;
+        }
+    }
+    if (planner != NULL) {
+        int side = planner->getSide();
+        stepInputs.player[side] = planner->plan(match, stepInputs.player[1 - side]);
+    }
+    if (recording != NULL) {
+        recording->record(stepInputs);
+    }
+    useInput();
+
+    previousX = match.bodies.x;
+    previousY = match.bodies.y;
+    step(match, stepInputs);
+
+    // Kickoff after a goal is a jump, not a movement to blend
+    if (match.win1 || match.win2) {
+        previousX = match.bodies.x;
+        previousY = match.bodies.y;
+    }
+    steps.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SimThread::stepOnline() {
+    session->poll();
+    PlayerInput local = { (unsigned char)(held[0] | held[1] | pressed[0] | pressed[1]) };
+
+    previousX = match.bodies.x;
+    previousY = match.bodies.y;
+    // A step held back for the peer keeps the presses, and when they
+    // changed, for the next one
+    if (!session->advance(local)) {
+        heldBack.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    pressed[0] = 0;
+    pressed[1] = 0;
+    useInput();
+
+    if (match.win1 || match.win2) {
+        previousX = match.bodies.x;
+        previousY = match.bodies.y;
+    }
+    steps.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SimThread::useInput() {
+    if (changed >= 0 && (usedChanged < 0 || changed < usedChanged)) {
+        usedChanged = changed;
+    }
+    changed = -1;
+}
+
+void SimThread::publish(int64_t due) {
+    // Vectors keep their storage from the last time this slot was written
+    MatchSnapshot& snapshot = snapshots.writeSlot();
+    snapshotMatch(snapshot, match, previousX, previousY);
+    snapshot.frame = (int)steps.load(std::memory_order_relaxed);
+    snapshot.due = due;
+    snapshot.inputChanged = usedChanged;
+    usedChanged = -1;
+    snapshots.publish();
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "lockfree.h"
+#include "planner.h"
+#include "profiler.h"
+#include "recording.h"
+#include "rollback.h"
+#include "sim.h"
+
+// Game input of one frame, times in nanoseconds on the profiler clock
+struct InputSnapshot
+{
+    // Inputs for the first step after sampling: the buttons held, those
+    // tapped and released since the last sample, and switch presses
+    Inputs first;
+
+    // Inputs for any further steps
+    Inputs held;
+
+    // When the snapshot was taken
+    int64_t sampled;
+
+    // When the oldest key change it carries happened, -1 if nothing changed
+    int64_t changed;
+};
+
+// Frames of input the simulation thread can fall behind on
+const int INPUT_QUEUE_CAPACITY = 64;
+
+// Everything needed to draw a match after one step
+struct MatchSnapshot
+{
+    //Initializes variables
+    MatchSnapshot();
+
+    // Step the snapshot was taken after
+    int frame;
+
+    int ball;
+    int score1;
+    int score2;
+
+    // Positions after the step and before it, drawing blends between them
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> previousX;
+    std::vector<int> previousY;
+
+    std::vector<unsigned char> team;
+    std::vector<unsigned char> role;
+
+    // When the step was due on the profiler clock
+    int64_t due;
+
+    // When the oldest key change used by the steps since the last snapshot
+    // happened, -1 if they used none
+    int64_t inputChanged;
+};
+
+// Copies the scores and bodies of a match into a snapshot, with the positions
+// the bodies had before the step; the snapshot keeps its storage
+void snapshotMatch(MatchSnapshot& snapshot, const MatchState& match, const std::vector<int>& previousX, const std::vector<int>& previousY);
+
+//Simulation thread class
+//Steps a match at a fixed rate on its own thread and publishes a snapshot
+//after every step through a triple buffer, so drawing always has the newest
+//complete step and never holds up the simulation. Input arrives over a
+//single producer single consumer queue.
+class SimThread
+{
+public:
+    //Initializes variables; steps are saved to recording unless it is NULL
+    //The thread owns the match from start until stop
+    SimThread(MatchState& match, int stepsPerSecond, int maxCatchUpSteps, ReplayWriter* recording);
+
+    //Stops the thread
+    ~SimThread();
+
+    //Plays online through a rollback session instead of stepping the match
+    //directly; the keys of both sides drive the local player. Set before start
+    void setSession(RollbackSession* session);
+
+    //Lets a planner pick the input of the side it plays each step, the
+    //picks are recorded like keys. Set before start
+    void setPlanner(MonteCarloPlanner* planner);
+
+    //Starts stepping, with the first step due one interval from now
+    void start();
+
+    //Stops stepping and waits for the thread to finish
+    void stop();
+
+    //Queues one frame of input for the next step, false when the queue is full
+    bool sendInput(const InputSnapshot& input);
+
+    //Whether sendInput would fail
+    bool inputFull() const;
+
+    //Moves to the newest snapshot and returns it, valid until the next call
+    //Only one thread may read snapshots
+    const MatchSnapshot& latest();
+
+    //Nanoseconds between steps
+    int64_t stepInterval() const;
+
+    //Steps run, steps skipped to catch up after a stall and, online, steps
+    //held back waiting for the peer
+    long long getSteps() const;
+    long long getDroppedSteps() const;
+    long long getHeldSteps() const;
+
+    //Milliseconds the recent steps started after they were due, only read after stop
+    const FrameTimes& getLateness() const;
+
+private:
+    void run();
+
+    //Steps once with the queued input
+    void stepOnce();
+    void stepOnline();
+
+    //Hands the key change waiting for a step to the next snapshot
+    void useInput();
+
+    //Copies the match into the free snapshot and publishes it
+    void publish(int64_t due);
+
+    MatchState& match;
+    ReplayWriter* recording;
+    RollbackSession* session;
+    MonteCarloPlanner* planner;
+    int64_t interval;
+    int maxCatchUpSteps;
+
+    TripleBuffer<MatchSnapshot> snapshots;
+    SpscQueue<InputSnapshot> inputs;
+
+    // Simulation thread state: input merged from the queue, when the oldest
+    // key change no step has used yet happened and the oldest one used since
+    // the last snapshot, -1 for none, positions before the last step and
+    // timing statistics
+    unsigned char held[2];
+    unsigned char pressed[2];
+    int64_t changed;
+    int64_t usedChanged;
+    std::vector<int> previousX;
+    std::vector<int> previousY;
+    FrameTimes lateness;
+
+    std::atomic<long long> steps;
+    std::atomic<long long> dropped;
+    std::atomic<long long> heldBack;
+    std::atomic<bool> running;
+    std::thread thread;
+};
@@ -0,0 +1,245 @@
+#include "snapshot.h"
+#include <stddef.h>
+
+BitWriter::BitWriter(unsigned char* buffer, int bufferCapacity) {
+    //Initialize
+    out = buffer;
+    capacity = bufferCapacity;
+    used = 0;
+    pending = 0;
+    pendingBits = 0;
+    overflowed = false;
+}
+
+void BitWriter::write(uint32_t value, int bits) {
+    if (bits < 32) {
+        value &= (1u << bits) - 1;
+    }
+    pending |= (uint64_t)value << pendingBits;
+    pendingBits += bits;
+    while (pendingBits >= 8) {
+        if (used < capacity) {
+            out[used] = (unsigned char)pending;
+        }
+        else {
+            overflowed = true;
+        }
+        used++;
+        pending >>= 8;
+        pendingBits -= 8;
+    }
+}
+
+int BitWriter::finish() {
+    if (pendingBits > 0) {
+        write(0, 8 - pendingBits);
+    }
+    return overflowed ? 0 : used;
+}
+
+BitReader::BitReader(const unsigned char* buffer, int bufferSize) {
+    //Initialize
+    in = buffer;
+    size = bufferSize;
+    position = 0;
+    pending = 0;
+    pendingBits = 0;
+    overran = false;
+}
+
+uint32_t BitReader::read(int bits) {
+    while (pendingBits < bits) {
+        if (position < size) {
+            pending |= (uint64_t)in[position] << pendingBits;
+        }
+        else {
+            overran = true;
+        }
+        position++;
+        pendingBits += 8;
+    }
+    uint32_t value = (uint32_t)(pending & ((bits < 32 ? (1ull << bits) : 0x100000000ull) - 1));
+    pending >>= bits;
+    pendingBits -= bits;
+    return overran ? 0 : value;
+}
+
+bool BitReader::failed() const {
+    return overran;
+}
+
+Snapshot::Snapshot() {
+    //Initialize
+    frame = -1;
+    score1 = 0;
+    score2 = 0;
+    selected[0] = 0;
+    selected[1] = 0;
+}
+
+void takeSnapshot(const MatchState& state, int frame, Snapshot& out) {
+    out.frame = frame;
+    out.score1 = state.score1;
+    out.score2 = state.score2;
+    out.selected[0] = state.selected[0];
+    out.selected[1] = state.selected[1];
+    out.x.assign(state.bodies.x.begin(), state.bodies.x.begin() + state.bodies.count);
+    out.y.assign(state.bodies.y.begin(), state.bodies.y.begin() + state.bodies.count);
+    out.vx.assign(state.bodies.vx.begin(), state.bodies.vx.begin() + state.bodies.count);
+    out.vy.assign(state.bodies.vy.begin(), state.bodies.vy.begin() + state.bodies.count);
+}
+
+bool sameSnapshot(const Snapshot& a, const Snapshot& b) {
+    return a.frame == b.frame && a.score1 == b.score1 && a.score2 == b.score2
+        && a.selected[0] == b.selected[0] && a.selected[1] == b.selected[1]
+        && a.x == b.x && a.y == b.y && a.vx == b.vx && a.vy == b.vy;
+}
+
+// Differences wrap around, so even the largest ones decode exactly
+static void writeValue(BitWriter& writer, int value, int base) {
+    uint32_t difference = (uint32_t)value - (uint32_t)base;
+    uint32_t zigzag = (difference << 1) ^ (uint32_t)((int32_t)difference >> 31);
+    if (zigzag == 0) {
+        writer.write(0, 1);
+    }
+    else if (zigzag < 16) {
+        writer.write(1, 2);
+        writer.write(zigzag, 4);
+    }
+    else if (zigzag < 256) {
+        writer.write(3, 3);
+        writer.write(zigzag, 8);
+    }
+    else if (zigzag < 4096) {
+        writer.write(7, 4);
+        writer.write(zigzag, 12);
+    }
+    else {
+        writer.write(15, 4);
+        writer.write((uint32_t)value, 32);
+    }
+}
+
+static int readValue(BitReader& reader, int base) {
+    uint32_t zigzag;
+    if (reader.read(1) == 0) {
+        return base;
+    }
+    if (reader.read(1) == 0) {
+        zigzag = reader.read(4);
+    }
+    else if (reader.read(1) == 0) {
+        zigzag = reader.read(8);
+    }
+    else if (reader.read(1) == 0) {
+        zigzag = reader.read(12);
+    }
+    else {
+        return (int)reader.read(32);
+    }
+    uint32_t difference = (zigzag >> 1) ^ (0u - (zigzag & 1));
+    return (int)((uint32_t)base + difference);
+}
+
+int encodeSnapshot(const Snapshot& current, const Snapshot* baseline, unsigned char* out, int capacity) {
+    int count = (int)current.x.size();
+    int age = baseline != NULL ? current.frame - baseline->frame : 0;
+    if (age <= 0 || age > MAX_BASELINE_AGE || (int)baseline->x.size() != count) {
+        baseline = NULL;
+        age = 0;
+    }
+
+    BitWriter writer(out, capacity);
+    writer.write((uint32_t)current.frame, 32);
+    writer.write((uint32_t)age, 8);
+    if (baseline == NULL) {
+        writer.write((uint32_t)count, 8);
+    }
+
+    writeValue(writer, current.score1, baseline != NULL ? baseline->score1 : 0);
+    writeValue(writer, current.score2, baseline != NULL ? baseline->score2 : 0);
+    writeValue(writer, current.selected[0], baseline != NULL ? baseline->selected[0] : 0);
+    writeValue(writer, current.selected[1], baseline != NULL ? baseline->selected[1] : 0);
+
+    for (int i = 0; i < count; i++) {
+        if (baseline != NULL && current.x[i] == baseline->x[i] && current.y[i] == baseline->y[i]
+            && current.vx[i] == baseline->vx[i] && current.vy[i] == baseline->vy[i]) {
+            writer.write(1, 1);
+            continue;
+        }
+        writer.write(0, 1);
+        writeValue(writer, current.x[i], baseline != NULL ? baseline->x[i] : 0);
+        writeValue(writer, current.y[i], baseline != NULL ? baseline->y[i] : 0);
+        writeValue(writer, current.vx[i], baseline != NULL ? baseline->vx[i] : 0);
+        writeValue(writer, current.vy[i], baseline != NULL ? baseline->vy[i] : 0);
+    }
+    return writer.finish();
+}
+
+bool snapshotFrames(const unsigned char* in, int size, int& frame, int& baselineFrame) {
+    if (size < SNAPSHOT_HEADER_BYTES) {
+        return false;
+    }
+    BitReader reader(in, size);
+    frame = (int)reader.read(32);
+    int age = (int)reader.read(8);
+    baselineFrame = age > 0 ? frame - age : -1;
+    return true;
+}
+
+bool decodeSnapshot(const unsigned char* in, int size, const Snapshot* baseline, Snapshot& out) {
+    BitReader reader(in, size);
+    out.frame = (int)reader.read(32);
+    int age = (int)reader.read(8);
+    if ((age > 0) != (baseline != NULL) || (baseline != NULL && baseline->frame != out.frame - age)) {
+        return false;
+    }
+    int count = baseline != NULL ? (int)baseline->x.size() : (int)reader.read(8);
+
+    out.score1 = readValue(reader, baseline != NULL ? baseline->score1 : 0);
+    out.score2 = readValue(reader, baseline != NULL ? baseline->score2 : 0);
+    out.selected[0] = readValue(reader, baseline != NULL ? baseline->selected[0] : 0);
+    out.selected[1] = readValue(reader, baseline != NULL ? baseline->selected[1] : 0);
+
+    out.x.resize(count);
+    out.y.resize(count);
+    out.vx.resize(count);
+    out.vy.resize(count);
+    for (int i = 0; i < count; i++) {
+        if (reader.read(1) != 0 && baseline != NULL) {
+            out.x[i] = baseline->x[i];
+            out.y[i] = baseline->y[i];
+            out.vx[i] = baseline->vx[i];
+            out.vy[i] = baseline->vy[i];
+            continue;
+        }
+        out.x[i] = readValue(reader, baseline != NULL ? baseline->x[i] : 0);
+        out.y[i] = readValue(reader, baseline != NULL ? baseline->y[i] : 0);
+        out.vx[i] = readValue(reader, baseline != NULL ? baseline->vx[i] : 0);
+        out.vy[i] = readValue(reader, baseline != NULL ? baseline->vy[i] : 0);
+    }
+    return !reader.failed();
+}
+
+SnapshotHistory::SnapshotHistory(int capacity) : snapshots(capacity) {
+}
+
+Snapshot& SnapshotHistory::add(int frame) {
+    Snapshot& slot = snapshots[(unsigned)frame % snapshots.size()];
+    slot.frame = frame;
+    return slot;
+}
+
+const Snapshot* SnapshotHistory::find(int frame) const {
+    if (frame < 0) {
+        return NULL;
+    }
+    const Snapshot& slot = snapshots[(unsigned)frame % snapshots.size()];
+    return slot.frame == frame ? &slot : NULL;
+}
+
+void SnapshotHistory::clear() {
+    for (size_t i = 0; i < snapshots.size(); i++) {
+        snapshots[i].frame = -1;
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "sim.h"
+
+// Snapshot codec
+//
+// A snapshot is what a viewer needs of a match: the position and velocity of
+// every body, the scores and the players each side controls. It is encoded as
+// the difference from a baseline snapshot the receiver already has, usually
+// the newest one it acknowledged, and packed to the bit. Values are the
+// simulation's own integers, so decoding gives back exactly what was encoded.
+//
+// Layout, fields least significant bit first:
+//   frame (32), age of the baseline in frames (8), 0 when there is none
+//   body count (8), only without a baseline
+//   score of each side and selected body of each side, as values
+//   per body: unchanged (1), then unless set x, y, vx and vy as values
+// A value is its difference from the baseline, or from 0 without one,
+// zigzagged so small differences of either sign come out small:
+//   0                     no difference
+//   10   + 4 bits         below 16
+//   110  + 8 bits         below 256
+//   1110 + 12 bits        below 4096
+//   1111 + 32 bits        anything else, the value itself
+
+// Oldest baseline a snapshot can be encoded against
+const int MAX_BASELINE_AGE = 255;
+
+// Snapshots kept by a history, enough to cover a round trip
+const int SNAPSHOT_HISTORY = 32;
+
+// Size of the fixed part of an encoded snapshot
+const int SNAPSHOT_HEADER_BYTES = 5;
+
+//Bit writer class
+//Packs fields of up to 32 bits into a buffer
+class BitWriter
+{
+public:
+    //Initializes variables; writes to out, never past capacity bytes
+    BitWriter(unsigned char* out, int capacity);
+
+    //Writes the low bits of value
+    void write(uint32_t value, int bits);
+
+    //Writes out the last partial byte and returns the bytes used, 0 if
+    //they did not fit
+    int finish();
+
+private:
+    unsigned char* out;
+    int capacity;
+    int used;
+    uint64_t pending;
+    int pendingBits;
+    bool overflowed;
+};
+
+//Bit reader class
+//Reads back what a bit writer wrote
+class BitReader
+{
+public:
+    //Initializes variables; reads up to size bytes of in
+    BitReader(const unsigned char* in, int size);
+
+    //Reads bits of a field, 0 once past the end
+    uint32_t read(int bits);
+
+    //Whether a read went past the end
+    bool failed() const;
+
+private:
+    const unsigned char* in;
+    int size;
+    int position;
+    uint64_t pending;
+    int pendingBits;
+    bool overran;
+};
+
+struct Snapshot
+{
+    //Initializes variables
+    Snapshot();
+
+    // Frame the snapshot was taken at, counted by whoever takes them; every
+    // snapshot of a stream needs its own
+    int frame;
+
+    int score1;
+    int score2;
+    int selected[2];
+
+    // Bodies in the simulation's order
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> vx;
+    std::vector<int> vy;
+};
+
+// Copies what a viewer needs of a match into out
+void takeSnapshot(const MatchState& state, int frame, Snapshot& out);
+
+bool sameSnapshot(const Snapshot& a, const Snapshot& b);
+
+// Encodes current against baseline, or whole when baseline is NULL, too old
+// or has a different number of bodies; returns the bytes written, 0 if they
+// did not fit in capacity
+int encodeSnapshot(const Snapshot& current, const Snapshot* baseline, unsigned char* out, int capacity);
+
+// Reads the frame of an encoded snapshot and of its baseline, -1 when it has
+// none; false if it is too short
+bool snapshotFrames(const unsigned char* in, int size, int& frame, int& baselineFrame);
+
+// Decodes a snapshot; baseline must be the snapshot of the frame
+// snapshotFrames gave, NULL when there was none
+// Returns false for a truncated snapshot or the wrong baseline
+bool decodeSnapshot(const unsigned char* in, int size, const Snapshot* baseline, Snapshot& out);
+
+//Snapshot history class
+//Keeps the newest snapshots by frame, for encoding against whichever one the
+//receiver acknowledged and for decoding against whichever one was used
+class SnapshotHistory
+{
+public:
+    //Initializes variables
+    explicit SnapshotHistory(int capacity = SNAPSHOT_HISTORY);
+
+    //Room for the snapshot of a frame, in place of the oldest
+    Snapshot& add(int frame);
+
+    //Snapshot of a frame, NULL if it is not kept
+    const Snapshot* find(int frame) const;
+
+    //Forgets every snapshot
+    void clear();
+
+private:
+    std::vector<Snapshot> snapshots;
+};
@@ -0,0 +1,331 @@
+#include "sprites.h"
+#include <SDL_image.h>
+#include <algorithm>
+#include <cstdio>
+
+ShelfPacker::ShelfPacker(int width) {
+    //Initialize
+    this->width = width;
+    penX = 0;
+    penY = 0;
+    rowHeight = 0;
+}
+
+bool ShelfPacker::insert(int w, int h, SDL_Rect& rect) {
+    if (w > width) {
+        return false;
+    }
+    if (penX + w > width) {
+        penX = 0;
+        penY += rowHeight;
+        rowHeight = 0;
+    }
+    rect = { penX, penY, w, h };
+    penX += w;
+    if (h > rowHeight) {
+        rowHeight = h;
+    }
+    return true;
+}
+
+int ShelfPacker::height() const {
+    return penY + rowHeight;
+}
+
+SpriteAtlas::SpriteAtlas() {
+    //Initialize
+    texture = NULL;
+    width = 0;
+    height = 0;
+}
+
+SpriteAtlas::~SpriteAtlas() {
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i] != NULL) {
+            SDL_FreeSurface(pending[i]);
+        }
+    }
+}
+
+int SpriteAtlas::add(SDL_Surface* surface) {
+    if (surface == NULL) {
+        return -1;
+    }
+    SDL_Rect empty = { 0, 0, surface->w, surface->h };
+    rects.push_back(empty);
+    pending.push_back(surface);
+    return (int)rects.size() - 1;
+}
+
+int SpriteAtlas::addFile(const char* path) {
+    SDL_Surface* surface = IMG_Load(path);
+    if (surface == NULL) {
+        printf("Unable to load image %s! SDL_image Error: %s\n", path, IMG_GetError());
+        return -1;
+    }
+    return add(surface);
+}
+
+// Taller images first keeps the rows tight
+struct TallerFirst
+{
+    const std::vector<SDL_Surface*>* surfaces;
+
+    bool operator()(int a, int b) const {
+        return (*surfaces)[a]->h > (*surfaces)[b]->h;
+    }
+};
+
+SDL_Surface* SpriteAtlas::compose() {
+    std::vector<int> order;
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i] != NULL) {
+            order.push_back((int)i);
+        }
+    }
+    TallerFirst tallerFirst = { &pending };
+    std::stable_sort(order.begin(), order.end(), tallerFirst);
+
+    ShelfPacker packer(ATLAS_WIDTH);
+    bool success = true;
+    for (size_t i = 0; i < order.size(); i++) {
+        SDL_Surface* surface = pending[order[i]];
+        SDL_Rect cell;
+        if (!packer.insert(surface->w + 2 * ATLAS_PADDING, surface->h + 2 * ATLAS_PADDING, cell)) {
+            printf("Sprite of %dx%d does not fit in the atlas!\n", surface->w, surface->h);
+            success = false;
+            break;
+        }
+        rects[order[i]] = { cell.x + ATLAS_PADDING, cell.y + ATLAS_PADDING, surface->w, surface->h };
+    }
+
+    // Copy the images into one surface
+    SDL_Surface* atlas = NULL;
+    if (success) {
+        atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, packer.height(), 32, SDL_PIXELFORMAT_ARGB8888);
+        if (atlas == NULL) {
+            printf("Unable to create sprite atlas! SDL Error: %s\n", SDL_GetError());
+        }
+        else {
+            SDL_FillRect(atlas, NULL, 0);
+            for (size_t i = 0; i < order.size(); i++) {
+                // Copy alpha as is instead of blending onto the empty atlas
+                SDL_SetSurfaceBlendMode(pending[order[i]], SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(pending[order[i]], NULL, atlas, &rects[order[i]]);
+            }
+        }
+    }
+
+    // The pixels live in the atlas now
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i] != NULL) {
+            SDL_FreeSurface(pending[i]);
+            pending[i] = NULL;
+        }
+    }
+
+    return atlas;
+}
+
+bool SpriteAtlas::build(SDL_Renderer* renderer) {
+    //Get rid of preexisting texture
+    free();
+
+    SDL_Surface* atlas = compose();
+    if (atlas == NULL) {
+        return false;
+    }
+
+    texture = SDL_CreateTextureFromSurface(renderer, atlas);
+    if (texture == NULL) {
+        printf("Unable to create sprite atlas texture! SDL Error: %s\n", SDL_GetError());
+    }
+    else {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        width = atlas->w;
+        height = atlas->h;
+    }
+    SDL_FreeSurface(atlas);
+
+    return texture != NULL;
+}
+
+void SpriteAtlas::adopt(SDL_Texture* atlasTexture) {
+    //Get rid of preexisting texture
+    free();
+
+    texture = atlasTexture;
+    if (texture != NULL) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+    }
+}
+
+bool SpriteAtlas::loadPacked(SDL_Renderer* renderer, Uint32 format, const void* pixels, int w, int h, int pitch, const SDL_Rect* sprites, int count) {
+    //Get rid of preexisting texture
+    free();
+
+    // Straight from the caller's pixels to the texture, no surface in between
+    texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, w, h);
+    if (texture == NULL) {
+        printf("Unable to create sprite atlas texture! SDL Error: %s\n", SDL_GetError());
+        return false;
+    }
+    if (SDL_UpdateTexture(texture, NULL, pixels, pitch) != 0) {
+        printf("Unable to upload sprite atlas! SDL Error: %s\n", SDL_GetError());
+        free();
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    width = w;
+    height = h;
+
+    rects.assign(sprites, sprites + count);
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i] != NULL) {
+            SDL_FreeSurface(pending[i]);
+        }
+    }
+    pending.clear();
+    return true;
+}
+
+void SpriteAtlas::free() {
+    //Free texture if it exists
+    if (texture != NULL)
+    {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+        width = 0;
+        height = 0;
+    }
+}
+
+const SDL_Rect& SpriteAtlas::rect(int sprite) const {
+    return rects[sprite];
+}
+
+const std::vector<SDL_Rect>& SpriteAtlas::getRects() const {
+    return rects;
+}
+
+SDL_Texture* SpriteAtlas::getTexture() const {
+    return texture;
+}
+
+int SpriteAtlas::getWidth() const {
+    return width;
+}
+
+int SpriteAtlas::getHeight() const {
+    return height;
+}
+
+SpriteBatch::SpriteBatch() {
+    //Initialize
+    atlas = NULL;
+    arena = NULL;
+    drawCalls = 0;
+    sources.reserve(BATCH_QUADS_RESERVED);
+    destinations.reserve(BATCH_QUADS_RESERVED);
+    indices.reserve(BATCH_QUADS_RESERVED * 6);
+}
+
+void SpriteBatch::begin(const SpriteAtlas* atlas) {
+    this->atlas = atlas;
+    sources.clear();
+    destinations.clear();
+}
+
+void SpriteBatch::draw(int sprite, int x, int y) {
+    if (sprite < 0) {
+        return;
+    }
+    const SDL_Rect& src = atlas->rect(sprite);
+    SDL_Rect dst = { x, y, src.w, src.h };
+    sources.push_back(src);
+    destinations.push_back(dst);
+}
+
+void SpriteBatch::drawCentered(int sprite, int x, int y) {
+    if (sprite < 0) {
+        return;
+    }
+    const SDL_Rect& src = atlas->rect(sprite);
+    draw(sprite, x - src.w / 2, y - src.h / 2);
+}
+
+void SpriteBatch::flush(SDL_Renderer* renderer) {
+    drawCalls = 0;
+    int quads = (int)sources.size();
+    if (quads == 0 || atlas == NULL || atlas->getTexture() == NULL) {
+        sources.clear();
+        destinations.clear();
+        return;
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // Two triangles per quad sharing the corners 0 1 2 3 (top left, top right,
+    // bottom left, bottom right)
+    int indexCount = quads * 6;
+    for (int q = (int)indices.size() / 6; q < quads; q++) {
+        int first = q * 4;
+        indices.push_back(first);
+        indices.push_back(first + 1);
+        indices.push_back(first + 2);
+        indices.push_back(first + 2);
+        indices.push_back(first + 1);
+        indices.push_back(first + 3);
+    }
+
+    // The vertices are only needed until the draw call below
+    SDL_Vertex* geometry;
+    if (arena != NULL) {
+        geometry = arena->allocate<SDL_Vertex>(quads * 4);
+    }
+    else {
+        vertices.resize(quads * 4);
+        geometry = vertices.data();
+    }
+    float scaleU = 1.0f / atlas->getWidth();
+    float scaleV = 1.0f / atlas->getHeight();
+    SDL_Color white = { 255, 255, 255, 255 };
+    for (int q = 0; q < quads; q++) {
+        const SDL_Rect& src = sources[q];
+        const SDL_Rect& dst = destinations[q];
+        float left = (float)dst.x, right = (float)(dst.x + dst.w);
+        float top = (float)dst.y, bottom = (float)(dst.y + dst.h);
+        float u0 = src.x * scaleU, u1 = (src.x + src.w) * scaleU;
+        float v0 = src.y * scaleV, v1 = (src.y + src.h) * scaleV;
+
+        SDL_Vertex* corner = &geometry[q * 4];
+        corner[0] = { { left, top }, white, { u0, v0 } };
+        corner[1] = { { right, top }, white, { u1, v0 } };
+        corner[2] = { { left, bottom }, white, { u0, v1 } };
+        corner[3] = { { right, bottom }, white, { u1, v1 } };
+    }
+
+    if (SDL_RenderGeometry(renderer, atlas->getTexture(), geometry, quads * 4, indices.data(), indexCount) != 0) {
+        printf("Unable to render sprite batch! SDL Error: %s\n", SDL_GetError());
+    }
+    drawCalls = 1;
+#else
+    // Older SDL has no geometry API, copies from one texture still avoid
+    // texture switches
+    for (int q = 0; q < quads; q++) {
+        SDL_RenderCopy(renderer, atlas->getTexture(), &sources[q], &destinations[q]);
+    }
+    drawCalls = quads;
+#endif
+
+    sources.clear();
+    destinations.clear();
+}
+
+void SpriteBatch::setArena(FrameArena* frameArena) {
+    arena = frameArena;
+}
+
+int SpriteBatch::lastDrawCalls() const {
+    return drawCalls;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <SDL.h>
+#include <vector>
+#include "arena.h"
+
+// Atlas rows wrap at this width
+const int ATLAS_WIDTH = 1024;
+
+// Empty pixels around every sprite so filtering never picks up a neighbour
+const int ATLAS_PADDING = 1;
+
+// Quads a sprite batch has room for before it allocates, a full match with
+// the profiler overlay up takes a few hundred
+const int BATCH_QUADS_RESERVED = 1024;
+
+//Shelf packer class
+//Places rectangles in rows left to right, starting a new row below the
+//tallest rectangle of the current one when a row is full
+class ShelfPacker
+{
+public:
+    //Initializes variables
+    explicit ShelfPacker(int width);
+
+    //Finds room for a w by h rectangle, false if it is wider than the atlas
+    bool insert(int w, int h, SDL_Rect& rect);
+
+    //Height used so far
+    int height() const;
+
+private:
+    int width;
+    int penX;
+    int penY;
+    int rowHeight;
+};
+
+//Sprite atlas class
+//Packs many images into one texture so a whole frame can be drawn in one batch
+class SpriteAtlas
+{
+public:
+    //Initializes variables
+    SpriteAtlas();
+
+    //Deallocates texture and pending images
+    ~SpriteAtlas();
+
+    //Queues an image for the next build and takes ownership of the surface
+    //Returns the sprite id, or -1 if the surface is NULL
+    int add(SDL_Surface* surface);
+
+    //Loads an image file and queues it, -1 on failure
+    int addFile(const char* path);
+
+    //Packs every queued image into one ARGB8888 surface, NULL on failure
+    //The caller frees the surface
+    SDL_Surface* compose();
+
+    //Packs every queued image and uploads them as one texture
+    bool build(SDL_Renderer* renderer);
+
+    //Uses a texture made elsewhere from the surface compose returned
+    void adopt(SDL_Texture* texture);
+
+    //Uploads an atlas composed ahead of time, with the rectangles of its sprites
+    bool loadPacked(SDL_Renderer* renderer, Uint32 format, const void* pixels, int w, int h, int pitch, const SDL_Rect* sprites, int count);
+
+    //Deallocates texture
+    void free();
+
+    //Where a sprite is inside the atlas texture
+    const SDL_Rect& rect(int sprite) const;
+    const std::vector<SDL_Rect>& getRects() const;
+
+    SDL_Texture* getTexture() const;
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    SDL_Texture* texture;
+    int width;
+    int height;
+
+    std::vector<SDL_Rect> rects;
+    std::vector<SDL_Surface*> pending;
+};
+
+//Sprite batch class
+//Collects quads from one atlas and draws them together when flushed, with a
+//single SDL_RenderGeometry call where SDL supports it
+class SpriteBatch
+{
+public:
+    //Initializes variables
+    SpriteBatch();
+
+    //Starts collecting quads drawn from the given atlas
+    void begin(const SpriteAtlas* atlas);
+
+    //Queues a sprite with its top left corner at given point
+    void draw(int sprite, int x, int y);
+
+    //Queues a sprite centered at given point
+    void drawCentered(int sprite, int x, int y);
+
+    //Draws every queued quad and empties the batch
+    void flush(SDL_Renderer* renderer);
+
+    //Builds the geometry of every flush in an arena the caller resets each
+    //frame, instead of in storage of its own; NULL goes back to that
+    void setArena(FrameArena* frameArena);
+
+    //Draw calls the last flush made
+    int lastDrawCalls() const;
+
+private:
+    const SpriteAtlas* atlas;
+
+    // Queued quads, source inside the atlas and destination on screen
+    std::vector<SDL_Rect> sources;
+    std::vector<SDL_Rect> destinations;
+
+    // Geometry built on flush, the index pattern only grows
+    FrameArena* arena;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+
+    int drawCalls;
+};
@@ -0,0 +1,96 @@
+#include "text.h"
+#include <cstdio>
+
+Font::Font() {
+    //Initialize
+    for (int face = 0; face < FONT_FACES; face++) {
+        metrics.heights[face] = 0;
+        for (int i = 0; i < GLYPH_COUNT; i++) {
+            metrics.sprites[face][i] = -1;
+            metrics.advances[face][i] = 0;
+        }
+    }
+}
+
+bool Font::loadFromFile(SpriteAtlas& atlas, const char* path, const int sizes[FONT_FACES]) {
+    SDL_Color textColor = { 255, 255, 255, 255 }; // White color
+
+    // Rasterize every glyph once, the atlas packs them with the other sprites
+    for (int face = 0; face < FONT_FACES; face++) {
+        TTF_Font* font = TTF_OpenFont(path, sizes[face]);
+        if (font == NULL) {
+            printf("Unable to load font %s! SDL_ttf Error: %s\n", path, TTF_GetError());
+            return false;
+        }
+        metrics.heights[face] = TTF_FontHeight(font);
+
+        for (int i = 0; i < GLYPH_COUNT; i++) {
+            Uint16 ch = (Uint16)(GLYPH_FIRST + i);
+            int advance = 0;
+            TTF_GlyphMetrics(font, ch, NULL, NULL, NULL, NULL, &advance);
+            metrics.advances[face][i] = advance;
+
+            // Whitespace has nothing to draw, only an advance
+            metrics.sprites[face][i] = atlas.add(TTF_RenderGlyph_Blended(font, ch, textColor));
+        }
+
+        TTF_CloseFont(font);
+    }
+
+    return true;
+}
+
+int Font::measure(int face, const char* text) const {
+    int width = 0;
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c >= GLYPH_FIRST && *c <= GLYPH_LAST) {
+            width += metrics.advances[face][*c - GLYPH_FIRST];
+        }
+    }
+    return width;
+}
+
+int Font::lineHeight(int face) const {
+    return metrics.heights[face];
+}
+
+const FontMetrics& Font::getMetrics() const {
+    return metrics;
+}
+
+void Font::setMetrics(const FontMetrics& newMetrics) {
+    metrics = newMetrics;
+}
+
+void Font::render(SpriteBatch& batch, int face, const char* text, int x, int y) const {
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c < GLYPH_FIRST || *c > GLYPH_LAST) {
+            continue;
+        }
+        int i = *c - GLYPH_FIRST;
+        batch.draw(metrics.sprites[face][i], x, y);
+        x += metrics.advances[face][i];
+    }
+}
+
+NumberLabel::NumberLabel() {
+    //Initialize
+    value = 0;
+    valid = false;
+    text[0] = '\0';
+}
+
+bool NumberLabel::setValue(int newValue) {
+    // Only rebuild the string when the value changes
+    if (valid && newValue == value) {
+        return false;
+    }
+    value = newValue;
+    valid = true;
+    snprintf(text, sizeof(text), "%d", value);
+    return true;
+}
+
+void NumberLabel::render(SpriteBatch& batch, const Font& font, int face, int x, int y) const {
+    font.render(batch, face, text, x, y);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "sprites.h"
+
+// Printable ASCII range baked into the sprite atlas
+const int GLYPH_FIRST = 32;
+const int GLYPH_LAST = 126;
+const int GLYPH_COUNT = GLYPH_LAST - GLYPH_FIRST + 1;
+
+// Font sizes baked into the sprite atlas
+const int FONT_SMALL = 0; // menu text
+const int FONT_LARGE = 1; // scores
+const int FONT_FACES = 2;
+
+// Everything needed to lay out text once the glyphs are in a sprite atlas
+struct FontMetrics
+{
+    //Glyph sprites, -1 for glyphs with nothing to draw, and horizontal advances
+    int sprites[FONT_FACES][GLYPH_COUNT];
+    int advances[FONT_FACES][GLYPH_COUNT];
+    int heights[FONT_FACES];
+};
+
+//Font class
+//Rasterizes every glyph once at every face size into a sprite atlas and keeps
+//the metrics needed to lay out text
+class Font
+{
+public:
+    //Initializes variables
+    Font();
+
+    //Opens the font and adds the glyphs of all faces to the atlas
+    //The atlas has to be built before text is drawn
+    bool loadFromFile(SpriteAtlas& atlas, const char* path, const int sizes[FONT_FACES]);
+
+    //Width in pixels of the text drawn with the given face
+    int measure(int face, const char* text) const;
+
+    //Height in pixels of a line of the given face
+    int lineHeight(int face) const;
+
+    //Queues text with its top left corner at given point
+    void render(SpriteBatch& batch, int face, const char* text, int x, int y) const;
+
+    //Metrics of a font baked ahead of time, used with a prebaked atlas
+    const FontMetrics& getMetrics() const;
+    void setMetrics(const FontMetrics& metrics);
+
+private:
+    FontMetrics metrics;
+};
+
+//Number label class
+//Caches the digits of a value and only rebuilds them when the value changes
+class NumberLabel
+{
+public:
+    //Initializes variables
+    NumberLabel();
+
+    //Sets the value to display, true if the text changed
+    bool setValue(int value);
+
+    //Queues the cached text with its top left corner at given point
+    void render(SpriteBatch& batch, const Font& font, int face, int x, int y) const;
+
+private:
+    int value;
+    bool valid;
+    char text[16];
+};
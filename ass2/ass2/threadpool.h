@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool
+// Each worker owns a queue and takes its newest task first; idle workers steal
+// the oldest task from other queues. Tasks get the index of the worker running
+// them so they can use per-worker state without locking.
+class ThreadPool
+{
+public:
+    typedef std::function<void(int worker)> Task;
+
+    //Starts the workers, 0 uses one per core
+    explicit ThreadPool(int threads);
+
+    //Stops the workers once their queues are empty
+    ~ThreadPool();
+
+    //Number of workers
+    int size() const;
+
+    //Queues a task, spreading tasks over the workers
+    //Safe from any thread, tasks included
+    void submit(Task task);
+
+    //Blocks until every submitted task has finished
+    void wait();
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int worker);
+    bool popOrSteal(int worker, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    // Counts submitted tasks, unsigned so it wraps around cleanly
+    std::atomic<unsigned> nextQueue;
+
+    // Tasks sitting in queues and tasks not yet finished
+    std::atomic<int> queued;
+    std::atomic<int> pending;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+    bool stopping;
+};
@@ -0,0 +1,283 @@
+// Plays computer vs computer matches on every core and reports the results
+//
+// Usage: tournament [--matches N] [--frames F] [--team-size S] [--seed X] [--threads T] [--max-step K] [policy ...]
+// Every ordered pair of the listed policies (all of them by default) plays N
+// matches of F frames each with S players a side. Match seeds are derived from
+// X and the match number, so a run repeats exactly with the same arguments.
+// --max-step K fast-forwards in steps of up to K frames while the ball is
+// clear of the players. The ball's flight stays exact but players decide once
+// a step, so results come quicker and can differ from frame by frame play.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "policies.h"
+#include "sim.h"
+#include "threadpool.h"
+
+// Goal differences beyond this are counted in the outermost bucket
+const int MAX_DIFF = 10;
+
+// Matches handed to a worker at once
+const int BATCH = 16;
+
+// Results of one pairing
+struct PairResult
+{
+    long long matches;
+    long long wins1;
+    long long wins2;
+    long long draws;
+    long long goals1;
+    long long goals2;
+    long long diffs[2 * MAX_DIFF + 1];
+};
+
+// Results gathered by one worker
+// Padded so neighbouring workers never write to the same cache line. Each
+// worker's pairs are allocated separately, and a spare result at either end
+// keeps the ones written away from whatever the heap puts next to them.
+struct WorkerResults
+{
+    // Pairing p is at p + 1
+    std::vector<PairResult> pairs;
+    long long frames;
+    long long steps;
+    char padding[64];
+};
+
+// A pairing of two policies
+struct Pairing
+{
+    int policy1;
+    int policy2;
+};
+
+// Seed of one match, independent of which worker plays it
+static uint64_t matchSeed(uint64_t seed, int pairing, int match) {
+    return mixSeed(mixSeed(seed ^ (uint64_t)pairing) ^ (uint64_t)match);
+}
+
+static void playMatches(const Pairing& pairing, int pairingIndex, int first, int count, int frames, int maxStep, int teamSize, uint64_t seed, PairResult& result, WorkerResults& worker) {
+    // Every worker steps its own match state
+    MatchState state;
+    Inputs inputs = {};
+
+    for (int m = first; m < first + count; m++) {
+        initMatch(state, CONTROL_AI, CONTROL_AI, teamSize, matchSeed(seed, pairingIndex, m));
+        state.policy[0] = POLICIES[pairing.policy1].policy;
+        state.policy[1] = POLICIES[pairing.policy2].policy;
+
+        if (maxStep > 1) {
+            worker.steps += fastForward(state, inputs, frames, maxStep);
+        }
+        else {
+            for (int f = 0; f < frames; f++) {
+                step(state, inputs);
+            }
+            worker.steps += frames;
+        }
+        worker.frames += frames;
+
+        result.matches++;
+        result.goals1 += state.score1;
+        result.goals2 += state.score2;
+        if (state.score1 > state.score2) {
+            result.wins1++;
+        }
+        else if (state.score2 > state.score1) {
+            result.wins2++;
+        }
+        else {
+            result.draws++;
+        }
+
+        int diff = state.score1 - state.score2;
+        if (diff > MAX_DIFF) {
+            diff = MAX_DIFF;
+        }
+        else if (diff < -MAX_DIFF) {
+            diff = -MAX_DIFF;
+        }
+        result.diffs[diff + MAX_DIFF]++;
+    }
+}
+
+static void printUsage() {
+    printf("Usage: tournament [--matches N] [--frames F] [--team-size S] [--seed X] [--threads T] [--max-step K] [policy ...]\n");
+    printf("Policies:");
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        printf(" %s", POLICIES[i].name);
+    }
+    printf("\n");
+}
+
+int main(int argc, char* args[]) {
+    int matches = 1000;
+    int frames = 60 * 90;
+    int teamSize = DEFAULT_TEAM_SIZE;
+    int threads = 0;
+    int maxStep = 1;
+    uint64_t seed = 1;
+    std::vector<int> policies;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--matches") == 0 && i + 1 < argc) {
+            matches = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--team-size") == 0 && i + 1 < argc) {
+            teamSize = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(args[++i], NULL, 10);
+        }
+        else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--max-step") == 0 && i + 1 < argc) {
+            maxStep = atoi(args[++i]);
+        }
+        else {
+            const PolicyEntry* entry = findPolicy(args[i]);
+            if (entry == NULL) {
+                printf("Unknown policy %s!\n", args[i]);
+                printUsage();
+                return -1;
+            }
+            policies.push_back((int)(entry - POLICIES));
+        }
+    }
+    if (matches <= 0 || frames <= 0 || teamSize < 2 || maxStep < 1 || maxStep > MAX_STEP_FRAMES) {
+        printUsage();
+        return -1;
+    }
+    if (policies.empty()) {
+        for (int i = 0; i < POLICY_COUNT; i++) {
+            policies.push_back(i);
+        }
+    }
+
+    // Every ordered pair plays, so both policies get both ends of the pitch
+    std::vector<Pairing> pairings;
+    for (size_t a = 0; a < policies.size(); a++) {
+        for (size_t b = 0; b < policies.size(); b++) {
+            Pairing pairing = { policies[a], policies[b] };
+            pairings.push_back(pairing);
+        }
+    }
+
+    ThreadPool pool(threads);
+    std::vector<WorkerResults> workers(pool.size());
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].pairs.assign(pairings.size() + 2, PairResult());
+        workers[w].frames = 0;
+        workers[w].steps = 0;
+    }
+
+    printf("Playing %d matches of %d frames, %d a side, for %d pairings on %d threads\n", matches, frames, teamSize, (int)pairings.size(), pool.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t p = 0; p < pairings.size(); p++) {
+        for (int first = 0; first < matches; first += BATCH) {
+            int count = matches - first < BATCH ? matches - first : BATCH;
+            pool.submit([&pairings, &workers, p, first, count, frames, maxStep, teamSize, seed](int worker) {
+                WorkerResults& results = workers[worker];
+                playMatches(pairings[p], (int)p, first, count, frames, maxStep, teamSize, seed, results.pairs[p + 1], results);
+            });
+        }
+    }
+    pool.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Merge worker results
+    std::vector<PairResult> totals(pairings.size(), PairResult());
+    long long totalFrames = 0;
+    long long totalSteps = 0;
+    for (size_t w = 0; w < workers.size(); w++) {
+        totalFrames += workers[w].frames;
+        totalSteps += workers[w].steps;
+        for (size_t p = 0; p < pairings.size(); p++) {
+            const PairResult& from = workers[w].pairs[p + 1];
+            PairResult& to = totals[p];
+            to.matches += from.matches;
+            to.wins1 += from.wins1;
+            to.wins2 += from.wins2;
+            to.draws += from.draws;
+            to.goals1 += from.goals1;
+            to.goals2 += from.goals2;
+            for (int d = 0; d <= 2 * MAX_DIFF; d++) {
+                to.diffs[d] += from.diffs[d];
+            }
+        }
+    }
+
+    long long totalMatches = (long long)matches * (long long)pairings.size();
+    printf("\n%lld matches in %.3f s: %.1f matches/s, %.0f frames/s in %.1f frames a step\n", totalMatches, seconds,
+        totalMatches / seconds, totalFrames / seconds, totalSteps > 0 ? (double)totalFrames / totalSteps : 0.0);
+
+    printf("\n%-10s %-10s %8s %8s %8s %8s %8s\n", "side 1", "side 2", "win 1", "draw", "win 2", "goals 1", "goals 2");
+    for (size_t p = 0; p < pairings.size(); p++) {
+        const PairResult& r = totals[p];
+        printf("%-10s %-10s %7.1f%% %7.1f%% %7.1f%% %8.2f %8.2f\n",
+            POLICIES[pairings[p].policy1].name, POLICIES[pairings[p].policy2].name,
+            100.0 * r.wins1 / r.matches, 100.0 * r.draws / r.matches, 100.0 * r.wins2 / r.matches,
+            (double)r.goals1 / r.matches, (double)r.goals2 / r.matches);
+    }
+
+    // Goal difference distribution over all matches
+    long long diffs[2 * MAX_DIFF + 1] = {};
+    for (size_t p = 0; p < totals.size(); p++) {
+        for (int d = 0; d <= 2 * MAX_DIFF; d++) {
+            diffs[d] += totals[p].diffs[d];
+        }
+    }
+    printf("\nGoal difference (side 1 - side 2)\n");
+    for (int d = 0; d <= 2 * MAX_DIFF; d++) {
+        if (diffs[d] == 0) {
+            continue;
+        }
+        int diff = d - MAX_DIFF;
+        const char* prefix = diff == MAX_DIFF ? ">=" : diff == -MAX_DIFF ? "<=" : "  ";
+        printf("%s%+3d %7.2f%% ", prefix, diff, 100.0 * diffs[d] / totalMatches);
+        int bar = (int)(60 * diffs[d] / totalMatches);
+        for (int i = 0; i < bar; i++) {
+            printf("#");
+        }
+        printf("\n");
+    }
+
+    // Win rate of each policy on either side
+    printf("\n%-10s %8s %8s %8s\n", "policy", "win", "draw", "loss");
+    for (size_t a = 0; a < policies.size(); a++) {
+        long long played = 0, won = 0, drawn = 0;
+        for (size_t p = 0; p < pairings.size(); p++) {
+            const PairResult& r = totals[p];
+            // Self play says nothing about a policy's strength
+            if (pairings[p].policy1 == pairings[p].policy2) {
+                continue;
+            }
+            if (pairings[p].policy1 == policies[a]) {
+                played += r.matches;
+                won += r.wins1;
+                drawn += r.draws;
+            }
+            else if (pairings[p].policy2 == policies[a]) {
+                played += r.matches;
+                won += r.wins2;
+                drawn += r.draws;
+            }
+        }
+        if (played == 0) {
+            continue;
+        }
+        printf("%-10s %7.1f%% %7.1f%% %7.1f%%\n", POLICIES[policies[a]].name,
+            100.0 * won / played, 100.0 * drawn / played, 100.0 * (played - won - drawn) / played);
+    }
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "vecenv.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "sim.h"
+
+// Lockstep matches and the threads that step them
+// Each thread owns a fixed slice of the matches and the calling thread steps
+// the first one, so a step hands out no work and allocates nothing
+struct VecEnv
+{
+    std::vector<MatchState> matches;
+    std::vector<int> episodeFrames;
+    int control[2];
+    int teamSize;
+    uint64_t seed;
+    long long resets;
+    int maxEpisodeFrames;
+    int observationSize;
+
+    // Buffers of the step being run
+    const unsigned char* actions;
+    float* observations;
+    float* rewards;
+    unsigned char* dones;
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable stepReady;
+    std::condition_variable stepDone;
+    long long stepCount;
+    int finished;
+    bool stopping;
+};
+
+// Position scales, so the pitch spans 0..1 both ways
+const float X_SCALE = 1.0f / (RIGHT - LEFT);
+const float Y_SCALE = 1.0f / (BOTTOM - TOP);
+const float SPEED_SCALE = 1.0f / PLAYER_SPEED;
+
+static void writeObservation(const MatchState& state, float* out) {
+    const Bodies& bodies = state.bodies;
+    for (int i = 0; i < bodies.count; i++) {
+        out[0] = (bodies.x[i] - LEFT) * X_SCALE;
+        out[1] = (bodies.y[i] - TOP) * Y_SCALE;
+        out[2] = bodies.vx[i] * SPEED_SCALE;
+        out[3] = bodies.vy[i] * SPEED_SCALE;
+        out += 4;
+    }
+    out[0] = (float)state.selected[0];
+    out[1] = (float)state.selected[1];
+}
+
+// Matches stepped by one thread
+static void sliceRange(const VecEnv& env, int slice, int& begin, int& end) {
+    long long count = (long long)env.matches.size();
+    long long slices = (long long)env.threads.size() + 1;
+    begin = (int)(count * slice / slices);
+    end = (int)(count * (slice + 1) / slices);
+}
+
+static void stepSlice(VecEnv& env, int slice) {
+    int begin, end;
+    sliceRange(env, slice, begin, end);
+    for (int i = begin; i < end; i++) {
+        MatchState& match = env.matches[i];
+        Inputs inputs;
+        inputs.player[0].buttons = env.actions[2 * i];
+        inputs.player[1].buttons = env.actions[2 * i + 1];
+        step(match, inputs);
+
+        // A goal has already put the match back to kickoff
+        float reward = match.win1 ? 1.0f : (match.win2 ? -1.0f : 0.0f);
+        env.rewards[2 * i] = reward;
+        env.rewards[2 * i + 1] = -reward;
+        unsigned char done = 0;
+        if (match.win1 || match.win2) {
+            done = VECENV_GOAL;
+        }
+        else if (env.maxEpisodeFrames > 0 && env.episodeFrames[i] + 1 >= env.maxEpisodeFrames) {
+            reset(match);
+            done = VECENV_TIME_LIMIT;
+        }
+        env.episodeFrames[i] = done != 0 ? 0 : env.episodeFrames[i] + 1;
+        env.dones[i] = done;
+
+        writeObservation(match, env.observations + (size_t)i * env.observationSize);
+    }
+}
+
+static void runWorker(VecEnv* env, int slice) {
+    long long stepped = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(env->mutex);
+            env->stepReady.wait(lock, [&] { return env->stopping || env->stepCount != stepped; });
+            if (env->stopping) {
+                return;
+            }
+            stepped = env->stepCount;
+        }
+
+        stepSlice(*env, slice);
+
+        {
+            std::lock_guard<std::mutex> lock(env->mutex);
+            env->finished++;
+        }
+        env->stepDone.notify_one();
+    }
+}
+
+VecEnv* vecEnvCreate(int count, int teamSize, int control1, int control2, uint64_t seed, int maxEpisodeFrames, int threads) {
+    if (count < 1 || teamSize < 2 || control1 < CONTROL_HUMAN || control1 > CONTROL_PLANNED
+        || control2 < CONTROL_HUMAN || control2 > CONTROL_PLANNED || maxEpisodeFrames < 0) {
+        return NULL;
+    }
+
+    VecEnv* env = new VecEnv();
+    env->matches.resize(count);
+    env->episodeFrames.assign(count, 0);
+    env->control[0] = control1;
+    env->control[1] = control2;
+    env->teamSize = teamSize;
+    env->seed = seed;
+    env->resets = 0;
+    env->maxEpisodeFrames = maxEpisodeFrames;
+    env->actions = NULL;
+    env->observations = NULL;
+    env->rewards = NULL;
+    env->dones = NULL;
+    env->stepCount = 0;
+    env->finished = 0;
+    env->stopping = false;
+    for (int i = 0; i < count; i++) {
+        initMatch(env->matches[i], control1, control2, teamSize, mixSeed(seed ^ (uint64_t)i));
+    }
+    env->observationSize = 4 * env->matches[0].bodies.count + 2;
+
+    // No more threads than matches, the calling thread is one of them
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+    for (int i = 1; i < threads; i++) {
+        env->threads.push_back(std::thread(runWorker, env, i));
+    }
+    return env;
+}
+
+void vecEnvDestroy(VecEnv* env) {
+    if (env == NULL) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(env->mutex);
+        env->stopping = true;
+    }
+    env->stepReady.notify_all();
+    for (size_t i = 0; i < env->threads.size(); i++) {
+        env->threads[i].join();
+    }
+    delete env;
+}
+
+int vecEnvCount(const VecEnv* env) {
+    return (int)env->matches.size();
+}
+
+int vecEnvObservationSize(const VecEnv* env) {
+    return env->observationSize;
+}
+
+void vecEnvReset(VecEnv* env, float* observations) {
+    env->resets++;
+    uint64_t seed = mixSeed(env->seed ^ ((uint64_t)env->resets << 32));
+    for (size_t i = 0; i < env->matches.size(); i++) {
+        initMatch(env->matches[i], env->control[0], env->control[1], env->teamSize, mixSeed(seed ^ (uint64_t)i));
+        env->episodeFrames[i] = 0;
+        writeObservation(env->matches[i], observations + i * env->observationSize);
+    }
+}
+
+void vecEnvStep(VecEnv* env, const unsigned char* actions, float* observations, float* rewards, unsigned char* dones) {
+    env->actions = actions;
+    env->observations = observations;
+    env->rewards = rewards;
+    env->dones = dones;
+    if (env->threads.empty()) {
+        stepSlice(*env, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(env->mutex);
+        env->stepCount++;
+        env->finished = 0;
+    }
+    env->stepReady.notify_all();
+    stepSlice(*env, 0);
+
+    std::unique_lock<std::mutex> lock(env->mutex);
+    env->stepDone.wait(lock, [env] { return env->finished == (int)env->threads.size(); });
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Vectorized environment, a C interface for training computer players
+ *
+ * Steps many independent matches in lockstep, spread over worker threads.
+ * Every buffer belongs to the caller, holds the matches one after another and
+ * is read or written in place; stepping allocates nothing.
+ *
+ * Per match:
+ *   actions       2 bytes, the buttons each side holds (the INPUT_ bits of
+ *                 sim.h); a side under the computer ignores them and a
+ *                 planned side picks its tactic with them
+ *   observations  vecEnvObservationSize floats: x, y, vx and vy of every body
+ *                 in the simulation's order, positions scaled to 0..1 across
+ *                 the pitch and velocities to the player speed, then the body
+ *                 each side controls
+ *   rewards       2 floats, 1 to a side that scored in the step and -1 to a
+ *                 side that conceded
+ *   dones         1 byte, VECENV_GOAL or VECENV_TIME_LIMIT when the step
+ *                 ended an episode, otherwise 0
+ * An episode ends with a goal or after the frame limit. The match is then put
+ * back to kickoff by the simulation's reset, keeping the score, and its
+ * observation is of the new episode. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct VecEnv VecEnv;
+
+enum
+{
+    VECENV_GOAL = 1,
+    VECENV_TIME_LIMIT = 2
+};
+
+/* Creates count matches of teamSize a side, driven as control1 and control2
+ * (Control values of sim.h). Match seeds come from seed. Episodes last at
+ * most maxEpisodeFrames steps, no limit when 0. threads 0 uses one per core.
+ * Returns NULL when an argument is out of range. */
+VecEnv* vecEnvCreate(int count, int teamSize, int control1, int control2, uint64_t seed,
+    int maxEpisodeFrames, int threads);
+
+void vecEnvDestroy(VecEnv* env);
+
+/* Matches stepped at once */
+int vecEnvCount(const VecEnv* env);
+
+/* Floats in the observation of one match */
+int vecEnvObservationSize(const VecEnv* env);
+
+/* Starts every match again with scores at zero and writes the observations;
+ * each reset gives the matches new seeds, the same ones on every run */
+void vecEnvReset(VecEnv* env, float* observations);
+
+/* Steps every match once with its actions */
+void vecEnvStep(VecEnv* env, const unsigned char* actions, float* observations, float* rewards, unsigned char* dones);
+
+#ifdef __cplusplus
+}
+#endif